@@ -0,0 +1,307 @@
+#include "cullingpass.hpp"
+
+#include "utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+
+namespace testengine {
+
+    namespace {
+
+        uint32_t groupCount(uint32_t invocations, uint32_t groupSize) {
+            return (invocations + groupSize - 1) / groupSize;
+        }
+    }
+
+    void CullingPass::init(VkDevice device, GpuAllocator* allocator, UploadManager* uploadManager, VkPipelineCache pipelineCache,
+                           const DeviceCapabilities& capabilities, const Scene& scene, VkBuffer instanceBuffer, uint32_t framesInFlight) {
+        this->device = device;
+        this->allocator = allocator;
+        this->capabilities = capabilities;
+
+        instanceCount = scene.getInstanceCount();
+
+        //every level of every batch gets room for all of the batch's instances, so the visible instances of
+        //one draw stay contiguous whatever levels the instances pick
+        std::vector<uint32_t> batchOfInstance(instanceCount);
+        std::vector<GpuDrawBatch> gpuBatches;
+        uint32_t visibleCapacity = 0;
+        for (const DrawBatch& batch : scene.getBatches()) {
+            const SceneMesh& mesh = scene.getMeshes()[batch.mesh];
+            std::fill_n(batchOfInstance.begin() + batch.firstInstance, batch.instanceCount, static_cast<uint32_t>(gpuBatches.size()));
+
+            for (uint32_t lod = 0; lod < mesh.lodCount; lod++) {
+                GpuDrawBatch gpuBatch{};
+                gpuBatch.boundingSphere = mesh.boundingSphere;
+                gpuBatch.indexCount = mesh.lods[lod].indexCount;
+                gpuBatch.firstIndex = mesh.lods[lod].firstIndex;
+                gpuBatch.vertexOffset = mesh.vertexOffset;
+                gpuBatch.firstInstance = visibleCapacity;
+                gpuBatch.lodError = mesh.lods[lod].error;
+                gpuBatch.lodCount = mesh.lodCount;
+                gpuBatches.push_back(gpuBatch);
+                visibleCapacity += batch.instanceCount;
+            }
+        }
+        batchCount = static_cast<uint32_t>(gpuBatches.size());
+
+        //sizes are clamped to one element so empty scenes still get valid buffers
+        createBuffer(sizeof(uint32_t) * std::max(instanceCount, 1u), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     instanceBatches, instanceBatchesAllocation);
+        createBuffer(sizeof(GpuDrawBatch) * std::max(batchCount, 1u), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     batches, batchesAllocation);
+
+        if (instanceCount > 0) {
+            uploadManager->uploadBuffer(instanceBatches, batchOfInstance.data(), sizeof(uint32_t) * instanceCount,
+                                        VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            uploadManager->uploadBuffer(batches, gpuBatches.data(), sizeof(GpuDrawBatch) * batchCount,
+                                        VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        }
+
+        frames.resize(framesInFlight);
+        for (FrameResources& frame : frames) {
+            createBuffer(sizeof(InstanceData) * std::max(visibleCapacity, 1u), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         frame.visibleInstances, frame.visibleInstancesAllocation);
+            createBuffer(sizeof(uint32_t) * (batchCount + 1), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                         frame.counts, frame.countsAllocation);
+            createBuffer(sizeof(VkDrawIndexedIndirectCommand) * std::max(batchCount, 1u), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                         frame.commands, frame.commandsAllocation);
+        }
+
+        createDescriptorSets(instanceBuffer);
+        createPipeline(pipelineCache);
+    }
+
+    void CullingPass::destroy() {
+        vkDestroyPipeline(device, pipeline, nullptr);
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+        for (FrameResources& frame : frames) {
+            vkDestroyBuffer(device, frame.visibleInstances, nullptr);
+            allocator->free(frame.visibleInstancesAllocation);
+            vkDestroyBuffer(device, frame.counts, nullptr);
+            allocator->free(frame.countsAllocation);
+            vkDestroyBuffer(device, frame.commands, nullptr);
+            allocator->free(frame.commandsAllocation);
+        }
+        frames.clear();
+
+        vkDestroyBuffer(device, instanceBatches, nullptr);
+        allocator->free(instanceBatchesAllocation);
+        vkDestroyBuffer(device, batches, nullptr);
+        allocator->free(batchesAllocation);
+    }
+
+    void CullingPass::record(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4& clip, float lodScale) {
+        if (batchCount == 0) {
+            return;
+        }
+
+        FrameResources& resources = frames[frame];
+
+        vkCmdFillBuffer(commandBuffer, resources.counts, 0, VK_WHOLE_SIZE, 0);
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+
+        CullParameters parameters{};
+        extractFrustumPlanes(clip, parameters.frustumPlanes);
+        parameters.instanceCount = instanceCount;
+        parameters.batchCount = batchCount;
+        parameters.phase = 0;
+        parameters.compactDraws = capabilities.drawIndirectCount ? 1 : 0;
+        parameters.lodScale = lodScale;
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &resources.descriptorSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(parameters), &parameters);
+        if (instanceCount > 0) {
+            vkCmdDispatch(commandBuffer, groupCount(instanceCount, WORKGROUP_SIZE), 1, 1);
+        }
+
+        //the command pass reads the per batch counts the cull pass accumulated
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+
+        parameters.phase = 1;
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, offsetof(CullParameters, phase),
+                           sizeof(parameters.phase), &parameters.phase);
+        vkCmdDispatch(commandBuffer, groupCount(batchCount, WORKGROUP_SIZE), 1, 1);
+
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void CullingPass::draw(VkCommandBuffer commandBuffer, uint32_t frame) {
+        if (batchCount == 0) {
+            return;
+        }
+
+        FrameResources& resources = frames[frame];
+        const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 1, 1, &resources.visibleInstances, &offset);
+
+        if (capabilities.drawIndirectCount) {
+            vkCmdDrawIndexedIndirectCount(commandBuffer, resources.commands, 0, resources.counts, 0, batchCount, stride);
+        } else if (capabilities.multiDrawIndirect) {
+            vkCmdDrawIndexedIndirect(commandBuffer, resources.commands, 0, batchCount, stride);
+        } else {
+            //one command per batch, still independent of the number of instances
+            for (uint32_t i = 0; i < batchCount; i++) {
+                vkCmdDrawIndexedIndirect(commandBuffer, resources.commands, static_cast<VkDeviceSize>(i) * stride, 1, stride);
+            }
+        }
+    }
+
+    void CullingPass::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, GpuAllocation& allocation) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create culling buffer.");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+        allocation = allocator->allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+        vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+    }
+
+    void CullingPass::createDescriptorSets(VkBuffer instanceBuffer) {
+        std::array<VkDescriptorSetLayoutBinding, 6> bindings{};
+        for (uint32_t i = 0; i < bindings.size(); i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create culling descriptor set layout.");
+        }
+
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSize.descriptorCount = static_cast<uint32_t>(bindings.size() * frames.size());
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = static_cast<uint32_t>(frames.size());
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create culling descriptor pool.");
+        }
+
+        std::vector<VkDescriptorSetLayout> layouts(frames.size(), descriptorSetLayout);
+        std::vector<VkDescriptorSet> sets(frames.size());
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(frames.size());
+        allocInfo.pSetLayouts = layouts.data();
+
+        if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to allocate culling descriptor sets.");
+        }
+
+        for (size_t i = 0; i < frames.size(); i++) {
+            frames[i].descriptorSet = sets[i];
+
+            std::array<VkDescriptorBufferInfo, 6> bufferInfos = {{
+                {instanceBuffer, 0, VK_WHOLE_SIZE},
+                {instanceBatches, 0, VK_WHOLE_SIZE},
+                {batches, 0, VK_WHOLE_SIZE},
+                {frames[i].visibleInstances, 0, VK_WHOLE_SIZE},
+                {frames[i].counts, 0, VK_WHOLE_SIZE},
+                {frames[i].commands, 0, VK_WHOLE_SIZE}
+            }};
+
+            std::array<VkWriteDescriptorSet, 6> descriptorWrites{};
+            for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+                descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[binding].dstSet = sets[i];
+                descriptorWrites[binding].dstBinding = binding;
+                descriptorWrites[binding].dstArrayElement = 0;
+                descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                descriptorWrites[binding].descriptorCount = 1;
+                descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+            }
+
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        }
+    }
+
+    void CullingPass::createPipeline(VkPipelineCache pipelineCache) {
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(CullParameters);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create culling pipeline layout.");
+        }
+
+        std::vector<char> shaderCode = utils::readFile("shaders/compiled/cull.comp.spv");
+
+        VkShaderModuleCreateInfo moduleInfo{};
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.codeSize = shaderCode.size();
+        moduleInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+
+        VkShaderModule shaderModule;
+        if (vkCreateShaderModule(device, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create culling shader module.");
+        }
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = shaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = pipelineLayout;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+        pipelineInfo.basePipelineIndex = -1;
+
+        VkResult result = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+        vkDestroyShaderModule(device, shaderModule, nullptr);
+
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create culling pipeline.");
+        }
+    }
+}
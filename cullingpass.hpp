@@ -0,0 +1,95 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "devicecapabilities.hpp"
+#include "gpuallocator.hpp"
+#include "scene.hpp"
+#include "uploadmanager.hpp"
+
+namespace testengine {
+
+    //GPU driven drawing of a Scene. A compute pass tests every instance's bounding sphere against the frustum,
+    //compacts the visible instances per batch and writes one VkDrawIndexedIndirectCommand per batch, so
+    //recording a frame costs the same number of commands whatever the number of instances.
+    //With drawIndirectCount empty batches are dropped and the draw count is read from the GPU as well.
+    //Every level of detail of a batch is a draw of its own, the cull pass picks each instance's level from its
+    //distance and appends it to that level's draw.
+    class CullingPass {
+        public:
+            CullingPass() = default;
+            CullingPass(const CullingPass&) = delete;
+            CullingPass& operator=(const CullingPass&) = delete;
+
+            //the device needs drawIndirectFirstInstance, instanceBuffer needs STORAGE_BUFFER usage
+            void init(VkDevice device, GpuAllocator* allocator, UploadManager* uploadManager, VkPipelineCache pipelineCache,
+                      const DeviceCapabilities& capabilities, const Scene& scene, VkBuffer instanceBuffer, uint32_t framesInFlight);
+            void destroy();
+
+            //culls against the frustum of clip (projection * view * model), has to be recorded outside a render pass;
+            //lodScale converts a mesh error at unit distance to multiples of the allowed error in pixels
+            void record(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4& clip, float lodScale);
+            //binds the visible instances to vertex binding 1 and issues the indirect draws
+            void draw(VkCommandBuffer commandBuffer, uint32_t frame);
+
+        private:
+            static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+            //matches DrawBatch in cull.comp, one per level of detail of every batch
+            struct GpuDrawBatch {
+                glm::vec4 boundingSphere;
+                uint32_t indexCount;
+                uint32_t firstIndex;
+                int32_t vertexOffset;
+                uint32_t firstInstance;
+                float lodError;
+                uint32_t lodCount;
+                uint32_t padding[2];
+            };
+
+            //matches CullParameters in cull.comp
+            struct CullParameters {
+                glm::vec4 frustumPlanes[6];
+                uint32_t instanceCount;
+                uint32_t batchCount;
+                uint32_t phase;
+                uint32_t compactDraws;
+                float lodScale;
+            };
+
+            struct FrameResources {
+                VkBuffer visibleInstances = VK_NULL_HANDLE;
+                GpuAllocation visibleInstancesAllocation;
+                VkBuffer counts = VK_NULL_HANDLE;
+                GpuAllocation countsAllocation;
+                VkBuffer commands = VK_NULL_HANDLE;
+                GpuAllocation commandsAllocation;
+                VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+            };
+
+            VkDevice device = VK_NULL_HANDLE;
+            GpuAllocator* allocator = nullptr;
+            DeviceCapabilities capabilities;
+
+            uint32_t instanceCount = 0;
+            //draws written by the command phase, i.e. the levels of detail of all batches
+            uint32_t batchCount = 0;
+
+            VkBuffer instanceBatches = VK_NULL_HANDLE;
+            GpuAllocation instanceBatchesAllocation;
+            VkBuffer batches = VK_NULL_HANDLE;
+            GpuAllocation batchesAllocation;
+            std::vector<FrameResources> frames;
+
+            VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+            VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+            VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+            VkPipeline pipeline = VK_NULL_HANDLE;
+
+            void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, GpuAllocation& allocation);
+            void createDescriptorSets(VkBuffer instanceBuffer);
+            void createPipeline(VkPipelineCache pipelineCache);
+    };
+}
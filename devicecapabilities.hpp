@@ -0,0 +1,41 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+
+namespace testengine {
+
+    //optional device features the engine adapts to, queried once for the picked physical device
+    //and enabled on the logical device when supported
+    struct DeviceCapabilities {
+        uint32_t apiVersion = VK_API_VERSION_1_0;
+
+        //Vulkan 1.0 features
+        bool multiDrawIndirect = false;
+        bool drawIndirectFirstInstance = false;
+        bool textureCompressionBC = false;
+        bool fragmentStoresAndAtomics = false;
+        //pipeline statistics queries that stay active across secondary command buffers
+        bool pipelineStatisticsQuery = false;
+        //dynamic uniform buffer offsets must be multiples of it
+        VkDeviceSize minUniformBufferOffsetAlignment = 256;
+        //largest width and height of a 2D image, bounds the headroom of resizable attachments
+        uint32_t maxImageDimension2D = 4096;
+        //sample counts both color and depth attachments support
+        VkSampleCountFlags framebufferSampleCounts = VK_SAMPLE_COUNT_1_BIT;
+        //a memory type only committed when used, transient attachments in it may live in tile memory only
+        bool lazilyAllocatedMemory = false;
+
+        //Vulkan 1.2 features
+        bool drawIndirectCount = false;
+        bool timelineSemaphore = false;
+        //non uniform indexing into partially bound, update after bind arrays of sampled images
+        bool descriptorIndexing = false;
+        //sampled images one update after bind set may hold and a shader stage may access
+        uint32_t maxBindlessTextures = 0;
+
+        //extensions
+        //VK_KHR_present_id and VK_KHR_present_wait, only queried for devices that present to a window
+        bool presentWait = false;
+    };
+}
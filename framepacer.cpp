@@ -0,0 +1,224 @@
+#include "framepacer.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+namespace testengine {
+
+    namespace {
+
+        const double DEFAULT_REFRESH_RATE = 60.0;
+        //ms kept free before the refresh for estimation errors and scheduling jitter
+        const double PACING_MARGIN = 1.0;
+        //fraction a larger estimate moves towards a smaller sample per frame
+        const double ESTIMATE_DECAY = 0.05;
+        //fraction the refresh period moves towards every measured interval between presents
+        const double PERIOD_SMOOTHING = 0.05;
+        //sleeps are this many ms shorter than needed, the rest is spun because sleeps overshoot
+        const double SPIN_TIME = 1.0;
+        //ns a present is waited for, it never comes if the swapchain went out of date in between
+        const uint64_t PRESENT_WAIT_TIMEOUT = 100 * 1000 * 1000;
+
+        void updateEstimate(double& estimate, double sample) {
+            estimate = std::max(sample, estimate + (sample - estimate) * ESTIMATE_DECAY);
+        }
+    }
+
+    void FramePacer::init(VkDevice device, FramePacing pacing, double refreshRate, bool presentWait, bool simulated) {
+        this->device = device;
+        this->pacing = pacing;
+        this->simulated = simulated;
+
+        waitForPresent = nullptr;
+        if (presentWait && !simulated) {
+            waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(device, "vkWaitForPresentKHR"));
+        }
+        this->presentWait = waitForPresent != nullptr;
+
+        refreshPeriod = 1000.0 / (refreshRate > 0.0 ? refreshRate : DEFAULT_REFRESH_RATE);
+        cpuEstimate = gpuEstimate = 0.0;
+        lastPresentedFrame = UINT64_MAX;
+        lastDisplayed = -1.0;
+        origin = std::chrono::steady_clock::now();
+        timings.fill(FrameTiming{});
+        latencies.clear();
+        totalSleep = 0.0;
+        pacedFrames = 0;
+    }
+
+    void FramePacer::setSwapchain(VkSwapchainKHR swapChain) {
+        this->swapChain = swapChain;
+        lastPresentedFrame = UINT64_MAX;
+        lastDisplayed = -1.0;
+    }
+
+    void FramePacer::pace(uint64_t frameNumber) {
+        if (!isPacing() || frameNumber == 0) {
+            return;
+        }
+
+        //when the previous frame reaches the screen, the refresh after it is the one this frame aims for
+        const FrameTiming* previous = findTiming(frameNumber - 1);
+        double displayed = -1.0;
+        if (simulated) {
+            displayed = previous != nullptr ? previous->present : -1.0;
+        } else if (presentWait) {
+            if (lastPresentedFrame == frameNumber - 1) {
+                TE_TRACE_SCOPE("vkWaitForPresentKHR");
+                if (waitForPresent(device, swapChain, getPresentId(frameNumber - 1), PRESENT_WAIT_TIMEOUT) == VK_SUCCESS) {
+                    displayed = now();
+                    presented(getTiming(frameNumber - 1), displayed);
+                }
+            }
+        } else {
+            displayed = previous != nullptr ? previous->completion : -1.0;
+        }
+
+        //nothing to align to, e.g. right after the swapchain was recreated
+        if (displayed < 0.0) {
+            return;
+        }
+
+        double frameTime = cpuEstimate + gpuEstimate + PACING_MARGIN;
+        totalSleep += sleepUntil(displayed + std::max(0.0, refreshPeriod - frameTime));
+        pacedFrames++;
+    }
+
+    void FramePacer::beginFrame(uint64_t frameNumber) {
+        getTiming(frameNumber).sample = now();
+    }
+
+    void FramePacer::frameSubmitted(uint64_t frameNumber) {
+        FrameTiming& timing = getTiming(frameNumber);
+        timing.submit = now();
+        if (timing.sample >= 0.0) {
+            updateEstimate(cpuEstimate, timing.submit - timing.sample);
+        }
+    }
+
+    void FramePacer::framePresented(uint64_t frameNumber) {
+        lastPresentedFrame = frameNumber;
+    }
+
+    void FramePacer::frameCompleted(uint64_t frameNumber, double gpuTime) {
+        FrameTiming& timing = getTiming(frameNumber);
+        const FrameTiming* previous = frameNumber > 0 ? findTiming(frameNumber - 1) : nullptr;
+        double observed = now();
+
+        //the queue runs frames one after another, timestamps place the completion within the time it was observed by
+        if (gpuTime >= 0.0 && timing.submit >= 0.0) {
+            double start = std::max(timing.submit, previous != nullptr ? previous->completion : 0.0);
+            timing.completion = std::min(start + gpuTime, observed);
+            updateEstimate(gpuEstimate, gpuTime);
+        } else {
+            timing.completion = observed;
+            if (timing.submit >= 0.0) {
+                updateEstimate(gpuEstimate, observed - timing.submit);
+            }
+        }
+
+        if (simulated) {
+            //FIFO: shown at the first refresh after completion, at most one frame per refresh
+            double refresh = std::ceil(timing.completion / refreshPeriod) * refreshPeriod;
+            if (previous != nullptr && previous->present >= 0.0) {
+                refresh = std::max(refresh, previous->present + refreshPeriod);
+            }
+            presented(timing, refresh);
+        }
+    }
+
+    void FramePacer::simulateAcquire(uint64_t frameNumber, uint32_t imageCount) {
+        if (!simulated || frameNumber + 1 < imageCount) {
+            return;
+        }
+
+        //the image of frame n - imageCount is released once the frame after it is shown
+        const FrameTiming* released = findTiming(frameNumber + 1 - imageCount);
+        if (released != nullptr && released->present >= 0.0) {
+            sleepUntil(released->present);
+        }
+    }
+
+    void FramePacer::printSummary() const {
+        if (!isPacing() && !simulated) {
+            return;
+        }
+
+        std::cout << "Frame pacing: " << (isPacing() ? "low latency" : "throughput") << " at " << 1000.0 / refreshPeriod << " Hz, "
+                  << (simulated ? "simulated display" : presentWait ? "present wait" : "GPU completion");
+        if (pacedFrames > 0) {
+            std::cout << ", slept " << totalSleep / pacedFrames << " ms per frame";
+        }
+        std::cout << '\n';
+
+        if (latencies.empty()) {
+            std::cout << "Input to present latency: n/a\n";
+            return;
+        }
+
+        std::vector<double> sorted = latencies;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for (double latency : sorted) {
+            total += latency;
+        }
+
+        std::cout << "Input to present latency (ms): avg " << total / sorted.size()
+                  << ", p50 " << sorted[sorted.size() / 2]
+                  << ", p95 " << sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)]
+                  << ", max " << sorted.back() << '\n';
+    }
+
+    double FramePacer::now() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    FramePacer::FrameTiming& FramePacer::getTiming(uint64_t frameNumber) {
+        FrameTiming& timing = timings[frameNumber % HISTORY];
+        if (timing.frameNumber != frameNumber) {
+            timing = FrameTiming{};
+            timing.frameNumber = frameNumber;
+        }
+        return timing;
+    }
+
+    const FramePacer::FrameTiming* FramePacer::findTiming(uint64_t frameNumber) const {
+        const FrameTiming& timing = timings[frameNumber % HISTORY];
+        return timing.frameNumber == frameNumber ? &timing : nullptr;
+    }
+
+    double FramePacer::sleepUntil(double time) {
+        double start = now();
+        if (time <= start) {
+            return 0.0;
+        }
+
+        TE_TRACE_SCOPE("FramePacer::sleep");
+        if (time - start > SPIN_TIME) {
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(time - start - SPIN_TIME));
+        }
+        while (now() < time) {
+            std::this_thread::yield();
+        }
+        return time - start;
+    }
+
+    void FramePacer::presented(FrameTiming& timing, double time) {
+        timing.present = time;
+        if (timing.sample >= 0.0) {
+            latencies.push_back(time - timing.sample);
+        }
+
+        //presents one refresh apart refine the refresh period, missed refreshes are skipped
+        if (!simulated && lastDisplayed >= 0.0) {
+            double interval = time - lastDisplayed;
+            if (interval > 0.5 * refreshPeriod && interval < 1.5 * refreshPeriod) {
+                refreshPeriod += (interval - refreshPeriod) * PERIOD_SMOOTHING;
+            }
+        }
+        lastDisplayed = time;
+    }
+}
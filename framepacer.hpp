@@ -0,0 +1,95 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace testengine {
+
+    enum FramePacing {
+        //frames start as soon as their slot is free, the present mode throttles them
+        FRAME_PACING_THROUGHPUT,
+        //frames start as late as the estimated frame time allows before the next refresh, presented with FIFO
+        FRAME_PACING_LOW_LATENCY
+    };
+
+    //Delays the start of every frame so input is sampled and the uniforms are written as late as possible while the
+    //frame still makes the refresh after the previous one. When the previous frame reached the screen is taken from
+    //VK_KHR_present_wait where available; otherwise the previous frame is waited for on the GPU and its completion
+    //stands in for the present, with the frame's CPU and GPU time estimated from the last frames. Headless runs present
+    //to a simulated FIFO display at the refresh rate instead, so the latency from input sampling to present can be
+    //compared between the pacing modes in benchmarks.
+    class FramePacer {
+        public:
+            FramePacer() = default;
+            FramePacer(const FramePacer&) = delete;
+            FramePacer& operator=(const FramePacer&) = delete;
+
+            //refreshRate in Hz, the estimate presentWait refines; simulated presents to a virtual display instead of a swapchain
+            void init(VkDevice device, FramePacing pacing, double refreshRate, bool presentWait, bool simulated);
+
+            //present ids are waited for on this swapchain, frames presented to the previous one are not
+            void setSwapchain(VkSwapchainKHR swapChain);
+
+            //blocks until frame should sample its input; without present wait or simulation the caller has to have
+            //waited for every frame submitted before, see needsPreviousFrame()
+            void pace(uint64_t frameNumber);
+            //frame samples its input and writes its uniforms now
+            void beginFrame(uint64_t frameNumber);
+            void frameSubmitted(uint64_t frameNumber);
+            //frame was queued for present with id getPresentId(frameNumber)
+            void framePresented(uint64_t frameNumber);
+            //frame finished on the GPU, gpuTime in ms or negative if unknown; frames have to complete in order
+            void frameCompleted(uint64_t frameNumber, double gpuTime);
+            //headless only, blocks like acquiring an image of a FIFO swapchain with imageCount images
+            void simulateAcquire(uint64_t frameNumber, uint32_t imageCount);
+
+            bool isPacing() const { return pacing == FRAME_PACING_LOW_LATENCY; }
+            //pace() aligns to the completion of the previous frame, which has to be collected before
+            bool needsPreviousFrame() const { return isPacing() && !presentWait; }
+            uint64_t getPresentId(uint64_t frameNumber) const { return frameNumber + 1; }
+            void printSummary() const;
+
+        private:
+            //frames whose timings are kept, more than any frame is behind the one being recorded
+            static constexpr size_t HISTORY = 64;
+
+            //ms since init, negative until known
+            struct FrameTiming {
+                uint64_t frameNumber = UINT64_MAX;
+                double sample = -1.0;
+                double submit = -1.0;
+                double completion = -1.0;
+                double present = -1.0;
+            };
+
+            VkDevice device = VK_NULL_HANDLE;
+            VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+            PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+            FramePacing pacing = FRAME_PACING_THROUGHPUT;
+            bool presentWait = false;
+            bool simulated = false;
+
+            double refreshPeriod = 1000.0 / 60.0;
+            //conservative estimates in ms: they rise to every larger sample at once and decay slowly
+            double cpuEstimate = 0.0;
+            double gpuEstimate = 0.0;
+            uint64_t lastPresentedFrame = UINT64_MAX;
+            double lastDisplayed = -1.0;
+
+            std::chrono::steady_clock::time_point origin;
+            std::array<FrameTiming, HISTORY> timings;
+            std::vector<double> latencies;
+            double totalSleep = 0.0;
+            uint64_t pacedFrames = 0;
+
+            double now() const;
+            FrameTiming& getTiming(uint64_t frameNumber);
+            const FrameTiming* findTiming(uint64_t frameNumber) const;
+            //returns the ms slept
+            double sleepUntil(double time);
+            void presented(FrameTiming& timing, double time);
+    };
+}
@@ -0,0 +1,156 @@
+#include "framescheduler.hpp"
+#include "trace.hpp"
+
+#include <stdexcept>
+
+namespace testengine {
+
+    void FrameScheduler::init(VkDevice device, uint32_t framesInFlight, bool timeline) {
+        this->device = device;
+        this->framesInFlight = framesInFlight;
+        this->timeline = timeline;
+
+        if (timeline) {
+            VkSemaphoreTypeCreateInfo typeInfo{};
+            typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+            typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+            typeInfo.initialValue = 0;
+
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            semaphoreInfo.pNext = &typeInfo;
+
+            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+                throw std::runtime_error("Runtime error: failed to create frame timeline semaphore.");
+            }
+            return;
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        fences.resize(framesInFlight);
+        fenceValues.assign(framesInFlight, 0);
+        for (VkFence& fence : fences) {
+            if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+                throw std::runtime_error("Runtime error: failed to create frame fence.");
+            }
+        }
+    }
+
+    void FrameScheduler::destroy() {
+        completedValue = submittedValue;
+        runDeletions();
+
+        if (semaphore != VK_NULL_HANDLE) {
+            vkDestroySemaphore(device, semaphore, nullptr);
+            semaphore = VK_NULL_HANDLE;
+        }
+        for (VkFence fence : fences) {
+            vkDestroyFence(device, fence, nullptr);
+        }
+        fences.clear();
+        fenceValues.clear();
+        submittedValue = completedValue = 0;
+    }
+
+    uint32_t FrameScheduler::beginFrame() {
+        uint64_t next = submittedValue + 1;
+        if (next > framesInFlight) {
+            wait(next - framesInFlight);
+        }
+        getCompletedValue();
+        runDeletions();
+        return getFrameIndex();
+    }
+
+    VkResult FrameScheduler::submit(VkQueue queue, const VkSubmitInfo& submitInfo) {
+        TE_TRACE_SCOPE("FrameScheduler::submit");
+        uint64_t value = submittedValue + 1;
+        uint32_t slot = getFrameIndex();
+
+        VkSubmitInfo frameSubmit = submitInfo;
+        VkResult result;
+        if (timeline) {
+            //the binary semaphores of the caller ignore their values, the timeline signal goes last
+            std::vector<VkSemaphore> signalSemaphores(submitInfo.pSignalSemaphores, submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+            std::vector<uint64_t> signalValues(submitInfo.signalSemaphoreCount, 0);
+            signalSemaphores.push_back(semaphore);
+            signalValues.push_back(value);
+
+            VkTimelineSemaphoreSubmitInfo timelineInfo{};
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timelineInfo.pNext = submitInfo.pNext;
+            timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+            timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+            frameSubmit.pNext = &timelineInfo;
+            frameSubmit.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+            frameSubmit.pSignalSemaphores = signalSemaphores.data();
+            result = vkQueueSubmit(queue, 1, &frameSubmit, VK_NULL_HANDLE);
+        } else {
+            //beginFrame() waited for the previous use of the slot
+            vkResetFences(device, 1, &fences[slot]);
+            result = vkQueueSubmit(queue, 1, &frameSubmit, fences[slot]);
+            fenceValues[slot] = value;
+        }
+
+        if (result == VK_SUCCESS) {
+            submittedValue = value;
+        }
+        return result;
+    }
+
+    void FrameScheduler::defer(std::function<void()> destroy) {
+        deletions.push_back({submittedValue, std::move(destroy)});
+    }
+
+    void FrameScheduler::waitForSubmitted() {
+        wait(submittedValue);
+        runDeletions();
+    }
+
+    uint64_t FrameScheduler::getCompletedValue() {
+        if (timeline) {
+            vkGetSemaphoreCounterValue(device, semaphore, &completedValue);
+            return completedValue;
+        }
+
+        //frames finish in submission order, the first unfinished one bounds the completed value
+        for (uint64_t value = completedValue + 1; value <= submittedValue; value++) {
+            if (vkGetFenceStatus(device, fences[(value - 1) % framesInFlight]) != VK_SUCCESS) {
+                break;
+            }
+            completedValue = value;
+        }
+        return completedValue;
+    }
+
+    void FrameScheduler::wait(uint64_t value) {
+        if (value <= completedValue) {
+            return;
+        }
+
+        TE_TRACE_SCOPE("FrameScheduler::wait");
+        if (timeline) {
+            VkSemaphoreWaitInfo waitInfo{};
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &semaphore;
+            waitInfo.pValues = &value;
+            vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+        } else {
+            vkWaitForFences(device, 1, &fences[(value - 1) % framesInFlight], VK_TRUE, UINT64_MAX);
+        }
+        completedValue = value;
+    }
+
+    void FrameScheduler::runDeletions() {
+        while (!deletions.empty() && deletions.front().value <= completedValue) {
+            //moved out first, a deletion may defer further work
+            std::function<void()> destroy = std::move(deletions.front().destroy);
+            deletions.pop_front();
+            destroy();
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace testengine {
+
+    //Paces the frames in flight on one timeline semaphore: frame n signals value n when its submission finished,
+    //so frame slot n % framesInFlight may be reused once value n - framesInFlight was reached. Objects the GPU
+    //may still use are handed to defer() and destroyed once every frame submitted before was reached, without
+    //draining the device. Devices without timeline semaphores get one fence per slot instead.
+    class FrameScheduler {
+        public:
+            FrameScheduler() = default;
+            FrameScheduler(const FrameScheduler&) = delete;
+            FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+            void init(VkDevice device, uint32_t framesInFlight, bool timeline);
+            //runs every pending deletion, the device has to be idle
+            void destroy();
+
+            //blocks until the slot of the next frame is free and runs the deletions that became safe, returns the slot
+            uint32_t beginFrame();
+            //submits the next frame with the semaphores in submitInfo plus the scheduler's own signal
+            VkResult submit(VkQueue queue, const VkSubmitInfo& submitInfo);
+
+            //destroy runs once every frame submitted so far finished on the GPU
+            void defer(std::function<void()> destroy);
+            //blocks until every submitted frame finished
+            void waitForSubmitted();
+
+            uint32_t getFramesInFlight() const { return framesInFlight; }
+            uint32_t getFrameIndex() const { return static_cast<uint32_t>(submittedValue % framesInFlight); }
+            uint64_t getSubmittedValue() const { return submittedValue; }
+            uint64_t getCompletedValue();
+
+        private:
+            struct Deletion {
+                uint64_t value;
+                std::function<void()> destroy;
+            };
+
+            VkDevice device = VK_NULL_HANDLE;
+            uint32_t framesInFlight = 0;
+            bool timeline = false;
+
+            VkSemaphore semaphore = VK_NULL_HANDLE;
+            //fallback: the fence of every slot and the value of the frame last submitted with it
+            std::vector<VkFence> fences;
+            std::vector<uint64_t> fenceValues;
+
+            uint64_t submittedValue = 0;
+            uint64_t completedValue = 0;
+            std::deque<Deletion> deletions;
+
+            void wait(uint64_t value);
+            void runDeletions();
+    };
+}
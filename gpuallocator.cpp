@@ -0,0 +1,344 @@
+#include "gpuallocator.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace testengine {
+
+    namespace {
+
+        VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+            return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+        }
+
+        double toMiB(VkDeviceSize bytes) {
+            return static_cast<double>(bytes) / (1024.0 * 1024.0);
+        }
+    }
+
+    void GpuAllocator::init(VkPhysicalDevice physicalDevice, VkDevice device) {
+        this->device = device;
+
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        maxAllocationCount = properties.limits.maxMemoryAllocationCount;
+    }
+
+    void GpuAllocator::destroy() {
+        for (auto& block : blocks) {
+            vkFreeMemory(device, block->memory, nullptr);
+        }
+        blocks.clear();
+        memoryTypeCache.clear();
+
+        uint32_t leaked = 0;
+        for (uint32_t count : dedicatedCounts) {
+            leaked += count;
+        }
+        if (leaked > 0) {
+            std::cerr << "Warning: " << leaked << " dedicated GPU allocations were not freed\n";
+        }
+    }
+
+    uint32_t GpuAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+        uint64_t key = (static_cast<uint64_t>(typeFilter) << 32) | properties;
+        auto cached = memoryTypeCache.find(key);
+        if (cached != memoryTypeCache.end()) {
+            return cached->second;
+        }
+
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            if (typeFilter & (1 << i) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                memoryTypeCache.emplace(key, i);
+                return i;
+            }
+        }
+
+        throw std::runtime_error("Runtime error: failed to find suitable memory type.");
+    }
+
+    bool GpuAllocator::hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            if (typeFilter & (1 << i) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    GpuAllocation GpuAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                                         bool optimalImage, GpuAllocationStrategy strategy) {
+        GpuAllocation allocation;
+        allocation.memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+
+        bool lazilyAllocated = getMemoryTypeFlags(allocation.memoryType) & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+        if (requirements.size > blockSizeFor(allocation.memoryType) / 2 || lazilyAllocated) {
+            allocation.memory = allocateDeviceMemory(requirements.size, allocation.memoryType, &allocation.mapped);
+            allocation.size = requirements.size;
+            dedicatedCounts[allocation.memoryType]++;
+            dedicatedBytes[allocation.memoryType] += requirements.size;
+            return allocation;
+        }
+
+        for (auto& block : blocks) {
+            if (block->memoryType == allocation.memoryType && block->strategy == strategy && block->optimalImage == optimalImage &&
+                allocateFromBlock(*block, requirements, allocation)) {
+                return allocation;
+            }
+        }
+
+        GpuMemoryBlock* block = createBlock(allocation.memoryType, strategy, optimalImage);
+        if (!allocateFromBlock(*block, requirements, allocation)) {
+            throw std::runtime_error("Runtime error: failed to sub-allocate GPU memory.");
+        }
+        return allocation;
+    }
+
+    void GpuAllocator::free(GpuAllocation& allocation) {
+        if (allocation.memory == VK_NULL_HANDLE) {
+            return;
+        }
+
+        GpuMemoryBlock* block = allocation.block;
+        if (block == nullptr) {
+            vkFreeMemory(device, allocation.memory, nullptr);
+            deviceAllocationCount--;
+            dedicatedCounts[allocation.memoryType]--;
+            dedicatedBytes[allocation.memoryType] -= allocation.size;
+            allocation = {};
+            return;
+        }
+
+        block->usedBytes -= allocation.size;
+        block->allocationCount--;
+
+        if (block->strategy == GPU_ALLOCATION_LINEAR) {
+            if (block->allocationCount == 0) {
+                block->head = 0;
+            }
+        } else {
+            auto range = block->freeRanges.emplace(allocation.offset, allocation.size).first;
+
+            auto next = std::next(range);
+            if (next != block->freeRanges.end() && range->first + range->second == next->first) {
+                range->second += next->second;
+                block->freeRanges.erase(next);
+            }
+            if (range != block->freeRanges.begin()) {
+                auto previous = std::prev(range);
+                if (previous->first + previous->second == range->first) {
+                    previous->second += range->second;
+                    block->freeRanges.erase(range);
+                }
+            }
+        }
+
+        allocation = {};
+
+        if (block->allocationCount == 0) {
+            releaseEmptyBlock(block);
+        }
+    }
+
+    GpuAllocatorStats GpuAllocator::getStats(uint32_t memoryType) const {
+        GpuAllocatorStats stats;
+        stats.deviceAllocationCount = deviceAllocationCount;
+
+        for (const auto& block : blocks) {
+            if (memoryType != UINT32_MAX && block->memoryType != memoryType) {
+                continue;
+            }
+
+            stats.blockCount++;
+            stats.blockBytes += block->size;
+            stats.usedBytes += block->usedBytes;
+            stats.allocationCount += block->allocationCount;
+
+            VkDeviceSize blockLargest = 0;
+            if (block->strategy == GPU_ALLOCATION_LINEAR) {
+                VkDeviceSize tail = block->size - block->head;
+                stats.freeRangeCount += tail > 0 ? 1 : 0;
+                stats.freeBytes += tail;
+                blockLargest = tail;
+            } else {
+                for (const auto& range : block->freeRanges) {
+                    stats.freeRangeCount++;
+                    stats.freeBytes += range.second;
+                    blockLargest = std::max(blockLargest, range.second);
+                }
+            }
+            stats.contiguousFreeBytes += blockLargest;
+            stats.largestFreeRange = std::max(stats.largestFreeRange, blockLargest);
+        }
+
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            if (memoryType == UINT32_MAX || memoryType == i) {
+                stats.dedicatedCount += dedicatedCounts[i];
+                stats.dedicatedBytes += dedicatedBytes[i];
+            }
+        }
+        stats.allocationCount += stats.dedicatedCount;
+        stats.usedBytes += stats.dedicatedBytes;
+
+        return stats;
+    }
+
+    void GpuAllocator::printStats() const {
+        GpuAllocatorStats total = getStats();
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << "GPU memory: " << total.allocationCount << " allocations in " << total.deviceAllocationCount
+                  << " device allocations (limit " << maxAllocationCount << "), "
+                  << toMiB(total.usedBytes) << " MiB used of " << toMiB(total.blockBytes + total.dedicatedBytes) << " MiB\n";
+
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            GpuAllocatorStats stats = getStats(i);
+            if (stats.blockCount == 0 && stats.dedicatedCount == 0) {
+                continue;
+            }
+
+            VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[i].propertyFlags;
+            std::string kind = (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ? "device local" : "";
+            if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+                kind += kind.empty() ? "host visible" : ", host visible";
+            }
+            if (flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+                kind += kind.empty() ? "lazily allocated" : ", lazily allocated";
+            }
+
+            std::cout << "  type " << i << " (" << kind << "): " << stats.blockCount << " blocks " << toMiB(stats.blockBytes) << " MiB, "
+                      << stats.dedicatedCount << " dedicated " << toMiB(stats.dedicatedBytes) << " MiB, "
+                      << stats.allocationCount << " allocations " << toMiB(stats.usedBytes) << " MiB used, "
+                      << stats.freeRangeCount << " free ranges, fragmentation " << stats.fragmentation() * 100.0f << "%\n";
+        }
+    }
+
+    VkDeviceSize GpuAllocator::blockSizeFor(uint32_t memoryType) const {
+        //small heaps (e.g. the 256 MiB host visible device local heap) get proportionally smaller blocks
+        VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+        return std::min(DEFAULT_BLOCK_SIZE, std::max<VkDeviceSize>(heapSize / 8, 1024 * 1024));
+    }
+
+    VkDeviceMemory GpuAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void** mapped) {
+        if (maxAllocationCount > 0 && deviceAllocationCount >= maxAllocationCount) {
+            throw std::runtime_error("Runtime error: maxMemoryAllocationCount exceeded.");
+        }
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryType;
+
+        VkDeviceMemory memory;
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to allocate GPU memory.");
+        }
+        deviceAllocationCount++;
+
+        *mapped = nullptr;
+        if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+                vkFreeMemory(device, memory, nullptr);
+                deviceAllocationCount--;
+                throw std::runtime_error("Runtime error: failed to map GPU memory.");
+            }
+        }
+
+        return memory;
+    }
+
+    GpuMemoryBlock* GpuAllocator::createBlock(uint32_t memoryType, GpuAllocationStrategy strategy, bool optimalImage) {
+        auto block = std::make_unique<GpuMemoryBlock>();
+        block->size = blockSizeFor(memoryType);
+        block->memory = allocateDeviceMemory(block->size, memoryType, &block->mapped);
+        block->memoryType = memoryType;
+        block->strategy = strategy;
+        block->optimalImage = optimalImage;
+        if (strategy == GPU_ALLOCATION_FREE_LIST) {
+            block->freeRanges.emplace(0, block->size);
+        }
+
+        blocks.push_back(std::move(block));
+        return blocks.back().get();
+    }
+
+    bool GpuAllocator::allocateFromBlock(GpuMemoryBlock& block, const VkMemoryRequirements& requirements, GpuAllocation& allocation) {
+        VkDeviceSize offset;
+
+        if (block.strategy == GPU_ALLOCATION_LINEAR) {
+            offset = alignUp(block.head, requirements.alignment);
+            if (offset + requirements.size > block.size) {
+                return false;
+            }
+            block.head = offset + requirements.size;
+        } else {
+            //best fit: the range that leaves the least space behind once aligned
+            auto best = block.freeRanges.end();
+            VkDeviceSize bestRemainder = 0;
+            for (auto range = block.freeRanges.begin(); range != block.freeRanges.end(); ++range) {
+                VkDeviceSize aligned = alignUp(range->first, requirements.alignment);
+                VkDeviceSize end = range->first + range->second;
+                if (aligned + requirements.size > end) {
+                    continue;
+                }
+
+                VkDeviceSize remainder = end - aligned - requirements.size;
+                if (best == block.freeRanges.end() || remainder < bestRemainder) {
+                    best = range;
+                    bestRemainder = remainder;
+                    if (remainder == 0) {
+                        break;
+                    }
+                }
+            }
+
+            if (best == block.freeRanges.end()) {
+                return false;
+            }
+
+            VkDeviceSize rangeOffset = best->first;
+            VkDeviceSize rangeEnd = best->first + best->second;
+            offset = alignUp(rangeOffset, requirements.alignment);
+            block.freeRanges.erase(best);
+
+            //alignment padding in front stays on the free list
+            if (offset > rangeOffset) {
+                block.freeRanges.emplace(rangeOffset, offset - rangeOffset);
+            }
+            if (offset + requirements.size < rangeEnd) {
+                block.freeRanges.emplace(offset + requirements.size, rangeEnd - offset - requirements.size);
+            }
+        }
+
+        block.usedBytes += requirements.size;
+        block.allocationCount++;
+
+        allocation.memory = block.memory;
+        allocation.offset = offset;
+        allocation.size = requirements.size;
+        allocation.mapped = block.mapped != nullptr ? static_cast<uint8_t*>(block.mapped) + offset : nullptr;
+        allocation.block = &block;
+        return true;
+    }
+
+    void GpuAllocator::releaseEmptyBlock(GpuMemoryBlock* block) {
+        //keep one empty block per kind around so that create/destroy cycles (staging, swap chain recreation)
+        //do not hit vkAllocateMemory every time
+        for (const auto& other : blocks) {
+            if (other.get() != block && other->allocationCount == 0 && other->memoryType == block->memoryType &&
+                other->strategy == block->strategy && other->optimalImage == block->optimalImage) {
+
+                auto found = std::find_if(blocks.begin(), blocks.end(), [&](const auto& entry) { return entry.get() == block; });
+                vkFreeMemory(device, block->memory, nullptr);
+                deviceAllocationCount--;
+                blocks.erase(found);
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace testengine {
+
+    enum GpuAllocationStrategy {
+        //best fit over a sorted free list, for long lived resources that are freed in any order
+        GPU_ALLOCATION_FREE_LIST,
+        //bump allocation that rewinds once every allocation in the block is freed, for short lived staging data
+        GPU_ALLOCATION_LINEAR
+    };
+
+    struct GpuMemoryBlock;
+
+    struct GpuAllocation {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        //host pointer to offset for host visible memory, blocks stay mapped for their whole lifetime
+        void* mapped = nullptr;
+        uint32_t memoryType = 0;
+        //nullptr for dedicated allocations
+        GpuMemoryBlock* block = nullptr;
+    };
+
+    struct GpuAllocatorStats {
+        uint32_t deviceAllocationCount = 0;
+        uint32_t blockCount = 0;
+        uint32_t dedicatedCount = 0;
+        uint32_t allocationCount = 0;
+        uint32_t freeRangeCount = 0;
+        VkDeviceSize blockBytes = 0;
+        VkDeviceSize dedicatedBytes = 0;
+        VkDeviceSize usedBytes = 0;
+        VkDeviceSize freeBytes = 0;
+        VkDeviceSize largestFreeRange = 0;
+        //sum of the largest free range of every block
+        VkDeviceSize contiguousFreeBytes = 0;
+
+        //share of free block memory that is not part of its block's largest free range,
+        //0 means the free space in every block is contiguous
+        float fragmentation() const {
+            return freeBytes > 0 ? 1.0f - static_cast<float>(contiguousFreeBytes) / static_cast<float>(freeBytes) : 0.0f;
+        }
+    };
+
+    struct GpuMemoryBlock {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        void* mapped = nullptr;
+        uint32_t memoryType = 0;
+        GpuAllocationStrategy strategy = GPU_ALLOCATION_FREE_LIST;
+        bool optimalImage = false;
+
+        VkDeviceSize usedBytes = 0;
+        uint32_t allocationCount = 0;
+
+        //free list: offset -> size, adjacent ranges are always merged
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+        //linear: next free offset
+        VkDeviceSize head = 0;
+    };
+
+    //Sub-allocates buffers and images from large VkDeviceMemory blocks instead of one vkAllocateMemory per
+    //resource. Blocks are kept per memory type, strategy and resource kind; buffers and optimal tiling images
+    //never share a block, so bufferImageGranularity never has to be considered inside a block.
+    //Resources larger than half a block and lazily allocated memory, whose commitment is tracked per
+    //VkDeviceMemory, get a dedicated allocation.
+    class GpuAllocator {
+        public:
+            GpuAllocator() = default;
+            GpuAllocator(const GpuAllocator&) = delete;
+            GpuAllocator& operator=(const GpuAllocator&) = delete;
+
+            void init(VkPhysicalDevice physicalDevice, VkDevice device);
+            void destroy();
+
+            //cached per type filter/property combination, memory properties are queried once in init()
+            uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+            bool hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+            VkMemoryPropertyFlags getMemoryTypeFlags(uint32_t memoryType) const { return memoryProperties.memoryTypes[memoryType].propertyFlags; }
+
+            GpuAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                                   bool optimalImage, GpuAllocationStrategy strategy = GPU_ALLOCATION_FREE_LIST);
+            void free(GpuAllocation& allocation);
+
+            //UINT32_MAX sums over all memory types
+            GpuAllocatorStats getStats(uint32_t memoryType = UINT32_MAX) const;
+            void printStats() const;
+
+        private:
+            static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+            VkDevice device = VK_NULL_HANDLE;
+            VkPhysicalDeviceMemoryProperties memoryProperties{};
+            uint32_t maxAllocationCount = 0;
+
+            std::vector<std::unique_ptr<GpuMemoryBlock>> blocks;
+            std::unordered_map<uint64_t, uint32_t> memoryTypeCache;
+
+            uint32_t deviceAllocationCount = 0;
+            std::array<uint32_t, VK_MAX_MEMORY_TYPES> dedicatedCounts{};
+            std::array<VkDeviceSize, VK_MAX_MEMORY_TYPES> dedicatedBytes{};
+
+            VkDeviceSize blockSizeFor(uint32_t memoryType) const;
+            VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void** mapped);
+            GpuMemoryBlock* createBlock(uint32_t memoryType, GpuAllocationStrategy strategy, bool optimalImage);
+            static bool allocateFromBlock(GpuMemoryBlock& block, const VkMemoryRequirements& requirements, GpuAllocation& allocation);
+            void releaseEmptyBlock(GpuMemoryBlock* block);
+    };
+}
@@ -0,0 +1,294 @@
+#include "gpuprofiler.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace testengine {
+
+    namespace {
+
+        const char* const STATISTIC_NAMES[] = {"input primitives", "vertex invocations", "clipped primitives", "fragment invocations",
+                                               "compute invocations"};
+    }
+
+    void GpuProfiler::init(VkDevice device, uint32_t framesInFlight, uint32_t timestampValidBits, float timestampPeriod, bool pipelineStatistics) {
+        this->device = device;
+        this->framesInFlight = framesInFlight;
+        this->timestampPeriod = timestampPeriod;
+        timestampMask = timestampValidBits >= 64 ? ~0ULL : (1ULL << timestampValidBits) - 1;
+        origin = std::chrono::steady_clock::now();
+        frames.assign(framesInFlight, FrameQueries{});
+
+        if (timestampValidBits > 0) {
+            //a begin and an end timestamp per scope and frame in flight
+            VkQueryPoolCreateInfo queryPoolInfo{};
+            queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryPoolInfo.queryCount = framesInFlight * MAX_SCOPES * 2;
+
+            if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestampPool) != VK_SUCCESS) {
+                throw std::runtime_error("Runtime error: failed to create timestamp query pool.");
+            }
+        }
+
+        if (pipelineStatistics) {
+            VkQueryPoolCreateInfo queryPoolInfo{};
+            queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            queryPoolInfo.queryCount = framesInFlight * MAX_STATISTICS_SCOPES;
+            queryPoolInfo.pipelineStatistics = STATISTICS;
+
+            if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &statisticsPool) != VK_SUCCESS) {
+                throw std::runtime_error("Runtime error: failed to create pipeline statistics query pool.");
+            }
+        }
+    }
+
+    void GpuProfiler::destroy() {
+        if (timestampPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device, timestampPool, nullptr);
+            timestampPool = VK_NULL_HANDLE;
+        }
+        if (statisticsPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device, statisticsPool, nullptr);
+            statisticsPool = VK_NULL_HANDLE;
+        }
+        frames.clear();
+    }
+
+    double GpuProfiler::collect(uint32_t frame, uint64_t frameNumber) {
+        FrameQueries& queries = frames[frame];
+        if (queries.scopes.empty()) {
+            return -1.0;
+        }
+
+        uint32_t scopeCount = static_cast<uint32_t>(queries.scopes.size());
+        double frameTime = -1.0;
+
+        if (timestampPool != VK_NULL_HANDLE) {
+            std::vector<uint64_t> timestamps(scopeCount * 2);
+            VkResult result = vkGetQueryPoolResults(device, timestampPool, frame * MAX_SCOPES * 2, scopeCount * 2, sizeof(uint64_t) * timestamps.size(),
+                                                    timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+            if (result == VK_SUCCESS) {
+                //frames are collected in submission order, so the distance to the previous frame is never negative
+                uint64_t first = timestamps[0];
+                if (hasGpuClock) {
+                    gpuClock += static_cast<double>((first - lastTimestamp) & timestampMask) * timestampPeriod / 1e6;
+                }
+                lastTimestamp = first;
+
+                //the GPU cannot start a frame before it was submitted, the largest distance is the closest alignment
+                double offset = queries.submitTime - gpuClock;
+                gpuClockOffset = hasGpuClock ? std::max(gpuClockOffset, offset) : offset;
+                hasGpuClock = true;
+
+                for (uint32_t i = 0; i < scopeCount; i++) {
+                    double start = gpuClock + static_cast<double>((timestamps[i * 2] - first) & timestampMask) * timestampPeriod / 1e6;
+                    double duration = static_cast<double>((timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask) * timestampPeriod / 1e6;
+
+                    Series& scopeSeries = getSeries(queries.scopes[i].name, true);
+                    scopeSeries.samples.push_back(duration);
+                    if (scopeSeries.samples.size() > ROLLING_WINDOW) {
+                        scopeSeries.samples.pop_front();
+                    }
+                    addEvent(queries.scopes[i].name, true, frameNumber, start, duration);
+                }
+                frameTime = static_cast<double>((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriod / 1e6;
+            }
+        }
+
+        if (statisticsPool != VK_NULL_HANDLE && queries.statisticsCount > 0) {
+            std::vector<uint64_t> statistics(queries.statisticsCount * STATISTICS_COUNT);
+            VkResult result = vkGetQueryPoolResults(device, statisticsPool, frame * MAX_STATISTICS_SCOPES, queries.statisticsCount,
+                                                    sizeof(uint64_t) * statistics.size(), statistics.data(), sizeof(uint64_t) * STATISTICS_COUNT,
+                                                    VK_QUERY_RESULT_64_BIT);
+
+            if (result == VK_SUCCESS) {
+                for (const Scope& scope : queries.scopes) {
+                    if (scope.statisticsQuery < 0) {
+                        continue;
+                    }
+
+                    Series& scopeSeries = getSeries(scope.name, true);
+                    scopeSeries.statistics.resize(STATISTICS_COUNT, 0);
+                    uint32_t local = static_cast<uint32_t>(scope.statisticsQuery) - frame * MAX_STATISTICS_SCOPES;
+                    for (uint32_t i = 0; i < STATISTICS_COUNT; i++) {
+                        scopeSeries.statistics[i] += statistics[local * STATISTICS_COUNT + i];
+                    }
+                    scopeSeries.statisticsFrames++;
+                }
+            }
+        }
+
+        queries.scopes.clear();
+        queries.statisticsCount = 0;
+        return frameTime;
+    }
+
+    void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frame) {
+        recordingFrame = frame;
+        frames[frame].scopes.clear();
+        frames[frame].statisticsCount = 0;
+
+        if (timestampPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(commandBuffer, timestampPool, frame * MAX_SCOPES * 2, MAX_SCOPES * 2);
+        }
+        if (statisticsPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(commandBuffer, statisticsPool, frame * MAX_STATISTICS_SCOPES, MAX_STATISTICS_SCOPES);
+        }
+    }
+
+    uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name, bool statistics) {
+        FrameQueries& queries = frames[recordingFrame];
+        if (timestampPool == VK_NULL_HANDLE && statisticsPool == VK_NULL_HANDLE) {
+            return 0;
+        }
+        if (queries.scopes.size() >= MAX_SCOPES) {
+            throw std::runtime_error("Runtime error: too many profiler scopes in one frame.");
+        }
+
+        uint32_t scope = static_cast<uint32_t>(queries.scopes.size());
+        Scope newScope{name, -1};
+
+        //scopes beyond MAX_STATISTICS_SCOPES are still timed
+        if (statistics && statisticsPool != VK_NULL_HANDLE && queries.statisticsCount < MAX_STATISTICS_SCOPES) {
+            newScope.statisticsQuery = static_cast<int32_t>(recordingFrame * MAX_STATISTICS_SCOPES + queries.statisticsCount++);
+            vkCmdBeginQuery(commandBuffer, statisticsPool, static_cast<uint32_t>(newScope.statisticsQuery), 0);
+            activeStatistics++;
+        }
+        if (timestampPool != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, (recordingFrame * MAX_SCOPES + scope) * 2);
+        }
+
+        queries.scopes.push_back(newScope);
+        return scope;
+    }
+
+    void GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scope) {
+        FrameQueries& queries = frames[recordingFrame];
+        if (scope >= queries.scopes.size()) {
+            return;
+        }
+
+        if (timestampPool != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, (recordingFrame * MAX_SCOPES + scope) * 2 + 1);
+        }
+        if (queries.scopes[scope].statisticsQuery >= 0) {
+            vkCmdEndQuery(commandBuffer, statisticsPool, static_cast<uint32_t>(queries.scopes[scope].statisticsQuery));
+            activeStatistics--;
+        }
+    }
+
+    void GpuProfiler::frameSubmitted(uint32_t frame) {
+        frames[frame].submitTime = now();
+    }
+
+    void GpuProfiler::beginCpuScope(const char* name) {
+        openCpuScopes.push_back({name, now()});
+    }
+
+    void GpuProfiler::endCpuScope() {
+        OpenCpuScope scope = openCpuScopes.back();
+        openCpuScopes.pop_back();
+        double duration = now() - scope.start;
+
+        Series& scopeSeries = getSeries(scope.name, false);
+        scopeSeries.samples.push_back(duration);
+        if (scopeSeries.samples.size() > ROLLING_WINDOW) {
+            scopeSeries.samples.pop_front();
+        }
+        addEvent(scope.name, false, 0, scope.start, duration);
+    }
+
+    void GpuProfiler::printSummary() const {
+        if (series.empty()) {
+            return;
+        }
+
+        std::cout << "\nProfile over the last " << ROLLING_WINDOW << " samples of every scope:\n";
+        for (const Series& scopeSeries : series) {
+            if (scopeSeries.samples.empty()) {
+                continue;
+            }
+
+            std::vector<double> times(scopeSeries.samples.begin(), scopeSeries.samples.end());
+            std::sort(times.begin(), times.end());
+            double total = 0.0;
+            for (double time : times) {
+                total += time;
+            }
+
+            std::cout << (scopeSeries.gpu ? "  gpu " : "  cpu ") << scopeSeries.name << " (ms): avg " << total / times.size()
+                      << ", p50 " << times[times.size() / 2]
+                      << ", p95 " << times[std::min(times.size() - 1, times.size() * 95 / 100)]
+                      << ", p99 " << times[std::min(times.size() - 1, times.size() * 99 / 100)]
+                      << ", max " << times.back() << '\n';
+        }
+
+        for (const Series& scopeSeries : series) {
+            if (scopeSeries.statisticsFrames == 0) {
+                continue;
+            }
+
+            std::cout << "  " << scopeSeries.name << " per frame:";
+            for (uint32_t i = 0; i < STATISTICS_COUNT; i++) {
+                std::cout << (i > 0 ? ", " : " ") << STATISTIC_NAMES[i] << ' ' << scopeSeries.statistics[i] / scopeSeries.statisticsFrames;
+            }
+            std::cout << '\n';
+        }
+    }
+
+    void GpuProfiler::writeChromeTrace(const std::string& path) const {
+        std::ofstream file(path, std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error("Runtime error: failed to open " + path + " for writing.");
+        }
+
+        //scope names are string literals without characters that need escaping
+        file << std::fixed << std::setprecision(3);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+             << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n"
+             << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+
+        for (const TraceEvent& event : trace) {
+            double start = event.gpu ? event.start + gpuClockOffset : event.start;
+            file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << (event.gpu ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+                 << (event.gpu ? 1 : 0) << ",\"ts\":" << start * 1000.0 << ",\"dur\":" << event.duration * 1000.0;
+            if (event.gpu) {
+                file << ",\"args\":{\"frame\":" << event.frameNumber << '}';
+            }
+            file << '}';
+        }
+        file << "\n]}\n";
+
+        if (!file) {
+            throw std::runtime_error("Runtime error: failed to write " + path + ".");
+        }
+        std::cout << "Profile trace with " << trace.size() << " events written to " << path << '\n';
+    }
+
+    double GpuProfiler::now() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    GpuProfiler::Series& GpuProfiler::getSeries(const char* name, bool gpu) {
+        for (Series& scopeSeries : series) {
+            if (scopeSeries.gpu == gpu && scopeSeries.name == name) {
+                return scopeSeries;
+            }
+        }
+        series.push_back({name, gpu, {}, {}, 0});
+        return series.back();
+    }
+
+    void GpuProfiler::addEvent(const char* name, bool gpu, uint64_t frameNumber, double start, double duration) {
+        trace.push_back({name, gpu, frameNumber, start, duration});
+        if (trace.size() > MAX_TRACE_EVENTS) {
+            trace.pop_front();
+        }
+    }
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "trace.hpp"
+
+namespace testengine {
+
+    //Times named scopes of the frame on the GPU with timestamp queries, optionally with pipeline statistics, and
+    //on the CPU with the steady clock. Every frame in flight has its own range of queries, which is read once the
+    //frame finished on the GPU, so results are framesInFlight frames old and reading them never stalls.
+    //Keeps a rolling window of every scope for the percentile summary and the recent events for a trace in the
+    //Chrome trace event format (chrome://tracing, Perfetto), GPU events aligned to the CPU clock at submission.
+    class GpuProfiler {
+        public:
+            GpuProfiler() = default;
+            GpuProfiler(const GpuProfiler&) = delete;
+            GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+            //GPU scopes a frame may open, nested ones included
+            static constexpr uint32_t MAX_SCOPES = 16;
+            static constexpr uint32_t MAX_STATISTICS_SCOPES = 4;
+
+            //timestampValidBits 0 disables GPU timing, CPU scopes always work
+            void init(VkDevice device, uint32_t framesInFlight, uint32_t timestampValidBits, float timestampPeriod, bool pipelineStatistics);
+            void destroy();
+
+            //reads the scopes of frame, whose previous submission has to have finished; returns the GPU time of the
+            //frame's first scope in ms, negative if there were no results
+            double collect(uint32_t frame, uint64_t frameNumber);
+
+            //records the query reset of frame, outside of a render pass and before its first scope
+            void beginFrame(VkCommandBuffer commandBuffer, uint32_t frame);
+            //statistics scopes may not begin inside a render pass and end outside of it
+            uint32_t beginScope(VkCommandBuffer commandBuffer, const char* name, bool statistics = false);
+            void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+            //aligns the GPU clock to the CPU clock in the trace, call right after the frame was submitted
+            void frameSubmitted(uint32_t frame);
+            //secondary command buffers executed while a statistics scope is open have to inherit these
+            VkQueryPipelineStatisticFlags getActiveStatistics() const { return activeStatistics > 0 ? STATISTICS : 0; }
+
+            //scopes of the thread recording the frames, they nest but may not overlap; CpuProfileScope pairs them
+            void beginCpuScope(const char* name);
+            void endCpuScope();
+
+            bool hasTimestamps() const { return timestampPool != VK_NULL_HANDLE; }
+            void printSummary() const;
+            void writeChromeTrace(const std::string& path) const;
+
+        private:
+            static constexpr VkQueryPipelineStatisticFlags STATISTICS = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+                                                                         VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                                                         VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                                                                         VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+                                                                         VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+            static constexpr uint32_t STATISTICS_COUNT = 5;
+            //samples per scope the percentiles are taken over
+            static constexpr size_t ROLLING_WINDOW = 512;
+            //the trace keeps only the most recent events
+            static constexpr size_t MAX_TRACE_EVENTS = 100000;
+
+            struct Scope {
+                const char* name;
+                int32_t statisticsQuery;
+            };
+
+            struct FrameQueries {
+                std::vector<Scope> scopes;
+                uint32_t statisticsCount = 0;
+                double submitTime = 0.0;
+            };
+
+            struct Series {
+                std::string name;
+                bool gpu;
+                std::deque<double> samples;
+                //statistics scopes only: sums and number of frames over the whole run
+                std::vector<uint64_t> statistics;
+                uint64_t statisticsFrames = 0;
+            };
+
+            struct TraceEvent {
+                const char* name;
+                bool gpu;
+                //GPU events only
+                uint64_t frameNumber;
+                //ms, CPU events since init, GPU events on the unwrapped GPU clock
+                double start;
+                double duration;
+            };
+
+            VkDevice device = VK_NULL_HANDLE;
+            uint32_t framesInFlight = 0;
+            VkQueryPool timestampPool = VK_NULL_HANDLE;
+            VkQueryPool statisticsPool = VK_NULL_HANDLE;
+            double timestampPeriod = 1.0;
+            uint64_t timestampMask = ~0ULL;
+
+            std::vector<FrameQueries> frames;
+            uint32_t recordingFrame = 0;
+            uint32_t activeStatistics = 0;
+
+            //GPU timestamps wrap after timestampValidBits, the clock is continued across collected frames
+            bool hasGpuClock = false;
+            uint64_t lastTimestamp = 0;
+            double gpuClock = 0.0;
+            //added to GPU event times in the trace, the largest CPU submit time minus GPU start so far
+            double gpuClockOffset = 0.0;
+
+            std::chrono::steady_clock::time_point origin;
+            struct OpenCpuScope {
+                const char* name;
+                double start;
+            };
+            std::vector<OpenCpuScope> openCpuScopes;
+
+            std::vector<Series> series;
+            std::deque<TraceEvent> trace;
+
+            double now() const;
+            Series& getSeries(const char* name, bool gpu);
+            void addEvent(const char* name, bool gpu, uint64_t frameNumber, double start, double duration);
+    };
+
+    //Times the rest of the enclosing block as a CPU scope of profiler and, while a trace runs, as a trace event
+    //of the same name, so hot calls are measured once for both the percentile summary and the trace.
+    class CpuProfileScope {
+        public:
+            //name has to outlive the trace, string literals do
+            CpuProfileScope(GpuProfiler& profiler, const char* name) : profiler(profiler)
+#if TE_TRACE_ENABLED
+                , trace(name)
+#endif
+            {
+                profiler.beginCpuScope(name);
+            }
+            ~CpuProfileScope() {
+                profiler.endCpuScope();
+            }
+
+            CpuProfileScope(const CpuProfileScope&) = delete;
+            CpuProfileScope& operator=(const CpuProfileScope&) = delete;
+
+        private:
+            GpuProfiler& profiler;
+#if TE_TRACE_ENABLED
+            TraceScope trace;
+#endif
+    };
+}
@@ -0,0 +1,100 @@
+#include "jobsystem.hpp"
+
+#include <algorithm>
+
+namespace testengine {
+
+    JobSystem::JobSystem(uint32_t threadCount) {
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        workers.reserve(threadCount - 1);
+        for (uint32_t i = 1; i < threadCount; i++) {
+            workers.emplace_back(&JobSystem::workerLoop, this);
+        }
+    }
+
+    JobSystem::~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeWorkers.notify_all();
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void JobSystem::parallelFor(uint32_t count, const std::function<void(uint32_t)>& function) {
+        if (count == 0) {
+            return;
+        }
+
+        if (count == 1 || workers.empty()) {
+            for (uint32_t i = 0; i < count; i++) {
+                function(i);
+            }
+            return;
+        }
+
+        errors.assign(count, nullptr);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &function;
+            taskCount = count;
+            nextTask.store(0, std::memory_order_relaxed);
+            busyWorkers = static_cast<uint32_t>(workers.size());
+            generation++;
+        }
+        wakeWorkers.notify_all();
+
+        runTasks();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobFinished.wait(lock, [this] { return busyWorkers == 0; });
+            job = nullptr;
+        }
+
+        for (const auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    void JobSystem::workerLoop() {
+        uint64_t seenGeneration = 0;
+
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeWorkers.wait(lock, [&] { return stopping || generation != seenGeneration; });
+                if (stopping) {
+                    return;
+                }
+                seenGeneration = generation;
+            }
+
+            runTasks();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busyWorkers == 0) {
+                jobFinished.notify_one();
+            }
+        }
+    }
+
+    void JobSystem::runTasks() {
+        uint32_t task;
+        while ((task = nextTask.fetch_add(1, std::memory_order_relaxed)) < taskCount) {
+            try {
+                (*job)(task);
+            } catch (...) {
+                errors[task] = std::current_exception();
+            }
+        }
+    }
+}
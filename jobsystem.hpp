@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace testengine {
+
+    //Fixed set of worker threads that stay alive for the lifetime of the engine, so work can be fanned out
+    //every frame without paying for thread creation. parallelFor() hands out task indices to the workers and
+    //the calling thread until all are taken, and returns once every task finished.
+    class JobSystem {
+        public:
+            //total number of threads including the calling one, 0 uses one per hardware thread
+            explicit JobSystem(uint32_t threadCount = 0);
+            ~JobSystem();
+
+            JobSystem(const JobSystem&) = delete;
+            JobSystem& operator=(const JobSystem&) = delete;
+
+            //runs function(0..count-1), the first exception thrown by a task is rethrown after all tasks finished
+            void parallelFor(uint32_t count, const std::function<void(uint32_t)>& function);
+
+            uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+        private:
+            std::vector<std::thread> workers;
+
+            std::mutex mutex;
+            std::condition_variable wakeWorkers;
+            std::condition_variable jobFinished;
+            uint64_t generation = 0;
+            uint32_t busyWorkers = 0;
+            bool stopping = false;
+
+            const std::function<void(uint32_t)>* job = nullptr;
+            uint32_t taskCount = 0;
+            std::atomic<uint32_t> nextTask{0};
+            std::vector<std::exception_ptr> errors;
+
+            void workerLoop();
+            void runTasks();
+    };
+}
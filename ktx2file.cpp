@@ -0,0 +1,308 @@
+#include "ktx2file.hpp"
+
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace testengine {
+
+    namespace {
+
+        const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+        const char* const SOURCE_KEY = "TestEngineSource";
+        const char* const WRITER_KEY = "KTXwriter";
+        const char* const WRITER_VALUE = "TestEngine";
+
+        //Khronos data format descriptor values (khr_df.h)
+        const uint32_t DF_MODEL_RGBSDA = 1;
+        const uint32_t DF_MODEL_BC7 = 134;
+        const uint32_t DF_MODEL_ASTC = 162;
+        const uint32_t DF_PRIMARIES_BT709 = 1;
+        const uint32_t DF_TRANSFER_LINEAR = 1;
+        const uint32_t DF_TRANSFER_SRGB = 2;
+        const uint32_t DF_CHANNEL_ALPHA = 15;
+        const uint32_t DF_SAMPLE_LINEAR = 0x10;
+
+        struct Header {
+            uint8_t identifier[12];
+            uint32_t vkFormat;
+            uint32_t typeSize;
+            uint32_t pixelWidth;
+            uint32_t pixelHeight;
+            uint32_t pixelDepth;
+            uint32_t layerCount;
+            uint32_t faceCount;
+            uint32_t levelCount;
+            uint32_t supercompressionScheme;
+            uint32_t dfdByteOffset;
+            uint32_t dfdByteLength;
+            uint32_t kvdByteOffset;
+            uint32_t kvdByteLength;
+            uint64_t sgdByteOffset;
+            uint64_t sgdByteLength;
+        };
+
+        struct LevelIndex {
+            uint64_t byteOffset;
+            uint64_t byteLength;
+            uint64_t uncompressedByteLength;
+        };
+
+        uint64_t alignUp(uint64_t value, uint64_t alignment) {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        bool isSrgb(VkFormat format) {
+            return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC7_SRGB_BLOCK || format == VK_FORMAT_ASTC_4x4_SRGB_BLOCK;
+        }
+
+        uint32_t dataFormatModel(VkFormat format) {
+            switch (format) {
+                case VK_FORMAT_BC7_UNORM_BLOCK:
+                case VK_FORMAT_BC7_SRGB_BLOCK:
+                    return DF_MODEL_BC7;
+                case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+                case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+                    return DF_MODEL_ASTC;
+                default:
+                    return DF_MODEL_RGBSDA;
+            }
+        }
+
+        void appendSample(std::vector<uint32_t>& words, uint32_t bitOffset, uint32_t bitLength, uint32_t channel, uint32_t upper) {
+            words.push_back(bitOffset | ((bitLength - 1) << 16) | (channel << 24));
+            words.push_back(0);
+            words.push_back(0);
+            words.push_back(upper);
+        }
+
+        //basic descriptor block, one sample per channel for RGBA8 and one for the whole block otherwise
+        std::vector<uint32_t> buildDataFormatDescriptor(VkFormat format) {
+            uint32_t blockWidth, blockHeight, blockBytes;
+            getFormatBlock(format, blockWidth, blockHeight, blockBytes);
+
+            std::vector<uint32_t> samples;
+            uint32_t model = dataFormatModel(format);
+            if (model == DF_MODEL_RGBSDA) {
+                for (uint32_t channel = 0; channel < 3; channel++) {
+                    appendSample(samples, channel * 8, 8, channel, 255);
+                }
+                //alpha is never sRGB encoded
+                appendSample(samples, 24, 8, DF_CHANNEL_ALPHA | (isSrgb(format) ? DF_SAMPLE_LINEAR : 0), 255);
+            } else {
+                appendSample(samples, 0, blockBytes * 8, 0, 0xFFFFFFFF);
+            }
+
+            uint32_t blockSize = 24 + static_cast<uint32_t>(samples.size()) * 4;
+            std::vector<uint32_t> words;
+            words.push_back(4 + blockSize);
+            words.push_back(0);
+            words.push_back(2 | (blockSize << 16));
+            words.push_back(model | (DF_PRIMARIES_BT709 << 8) | ((isSrgb(format) ? DF_TRANSFER_SRGB : DF_TRANSFER_LINEAR) << 16));
+            words.push_back((blockWidth - 1) | ((blockHeight - 1) << 8));
+            words.push_back(blockBytes);
+            words.push_back(0);
+            words.insert(words.end(), samples.begin(), samples.end());
+            return words;
+        }
+
+        void appendKeyValue(std::vector<uint8_t>& data, const std::string& key, const std::string& value) {
+            uint32_t length = static_cast<uint32_t>(key.size() + 1 + value.size() + 1);
+            const uint8_t* lengthBytes = reinterpret_cast<const uint8_t*>(&length);
+            data.insert(data.end(), lengthBytes, lengthBytes + sizeof(length));
+            data.insert(data.end(), key.begin(), key.end());
+            data.push_back(0);
+            data.insert(data.end(), value.begin(), value.end());
+            data.push_back(0);
+            data.resize(alignUp(data.size(), 4), 0);
+        }
+
+        //returns the value of key, without its terminating zero
+        std::string findKeyValue(const uint8_t* data, uint64_t size, const std::string& key) {
+            uint64_t position = 0;
+            while (position + sizeof(uint32_t) <= size) {
+                uint32_t length;
+                memcpy(&length, data + position, sizeof(length));
+                position += sizeof(length);
+                if (length > size - position) {
+                    break;
+                }
+
+                const char* entry = reinterpret_cast<const char*>(data + position);
+                size_t keyLength = strnlen(entry, length);
+                if (keyLength < length && key.compare(0, std::string::npos, entry, keyLength) == 0) {
+                    std::string value(entry + keyLength + 1, length - keyLength - 1);
+                    if (!value.empty() && value.back() == '\0') {
+                        value.pop_back();
+                    }
+                    return value;
+                }
+                position = alignUp(position + length, 4);
+            }
+            return std::string();
+        }
+    }
+
+    bool getFormatBlock(VkFormat format, uint32_t& blockWidth, uint32_t& blockHeight, uint32_t& blockBytes) {
+        switch (format) {
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_R8G8B8A8_SRGB:
+                blockWidth = 1;
+                blockHeight = 1;
+                blockBytes = 4;
+                return true;
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+            case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+            case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+                blockWidth = 4;
+                blockHeight = 4;
+                blockBytes = 16;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool writeKtx2(const std::string& path, const TextureData& texture) {
+        uint32_t blockWidth, blockHeight, blockBytes;
+        if (!getFormatBlock(texture.format, blockWidth, blockHeight, blockBytes)) {
+            return false;
+        }
+
+        std::vector<uint32_t> descriptor = buildDataFormatDescriptor(texture.format);
+
+        //keys have to be sorted
+        std::vector<uint8_t> keyValues;
+        appendKeyValue(keyValues, WRITER_KEY, WRITER_VALUE);
+        if (!texture.source.empty()) {
+            appendKeyValue(keyValues, SOURCE_KEY, texture.source);
+        }
+
+        uint32_t levelCount = static_cast<uint32_t>(texture.levels.size());
+
+        Header header{};
+        memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+        header.vkFormat = static_cast<uint32_t>(texture.format);
+        //1 for byte formats and for every block compressed format
+        header.typeSize = 1;
+        header.pixelWidth = texture.width;
+        header.pixelHeight = texture.height;
+        header.faceCount = 1;
+        header.levelCount = levelCount;
+        header.dfdByteOffset = static_cast<uint32_t>(sizeof(Header) + levelCount * sizeof(LevelIndex));
+        header.dfdByteLength = static_cast<uint32_t>(descriptor.size() * sizeof(uint32_t));
+        header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+        header.kvdByteLength = static_cast<uint32_t>(keyValues.size());
+
+        //level data is aligned to the least common multiple of the block size and 4
+        uint64_t alignment = blockBytes % 4 == 0 ? blockBytes : blockBytes * 4;
+        std::vector<LevelIndex> levelIndex(levelCount);
+        uint64_t offset = header.kvdByteOffset + header.kvdByteLength;
+        for (uint32_t i = levelCount; i-- > 0;) {
+            offset = alignUp(offset, alignment);
+            levelIndex[i] = {offset, texture.levels[i].size, texture.levels[i].size};
+            offset += texture.levels[i].size;
+        }
+
+        std::error_code error;
+        std::filesystem::path parent = std::filesystem::path(path).parent_path();
+        if (!parent.empty()) {
+            std::filesystem::create_directories(parent, error);
+        }
+
+        //write to a temporary file and rename it, so a crash never leaves a torn texture behind
+        std::string temporaryPath = path + ".tmp";
+        {
+            std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                return false;
+            }
+
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(levelIndex.data()), levelIndex.size() * sizeof(LevelIndex));
+            out.write(reinterpret_cast<const char*>(descriptor.data()), descriptor.size() * sizeof(uint32_t));
+            out.write(reinterpret_cast<const char*>(keyValues.data()), keyValues.size());
+
+            const char padding[64] = {};
+            for (uint32_t i = levelCount; i-- > 0;) {
+                out.write(padding, static_cast<std::streamsize>(levelIndex[i].byteOffset - static_cast<uint64_t>(out.tellp())));
+                out.write(reinterpret_cast<const char*>(texture.data.data() + texture.levels[i].offset),
+                          static_cast<std::streamsize>(texture.levels[i].size));
+            }
+
+            if (!out) {
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temporaryPath, path, error);
+        return !error;
+    }
+
+    bool readKtx2(const std::string& path, TextureData& texture) {
+        utils::MappedFile file;
+        if (!file.open(path) || file.size() < sizeof(Header)) {
+            return false;
+        }
+
+        Header header;
+        memcpy(&header, file.data(), sizeof(Header));
+
+        VkFormat format = static_cast<VkFormat>(header.vkFormat);
+        uint32_t blockWidth, blockHeight, blockBytes;
+        if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0 ||
+            !getFormatBlock(format, blockWidth, blockHeight, blockBytes) || header.supercompressionScheme != 0 ||
+            header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 || header.layerCount > 1 ||
+            header.faceCount != 1 || header.levelCount == 0) {
+            return false;
+        }
+
+        //a longer chain repeats 1x1 levels and shifts the size by 32 or more bits below
+        uint32_t maxLevelCount = static_cast<uint32_t>(std::floor(std::log2(std::max(header.pixelWidth, header.pixelHeight)))) + 1;
+        if (header.levelCount > maxLevelCount) {
+            return false;
+        }
+
+        uint64_t indexEnd = sizeof(Header) + uint64_t(header.levelCount) * sizeof(LevelIndex);
+        if (indexEnd > file.size() || uint64_t(header.kvdByteOffset) + header.kvdByteLength > file.size()) {
+            return false;
+        }
+
+        texture.format = format;
+        texture.width = header.pixelWidth;
+        texture.height = header.pixelHeight;
+        texture.levels.clear();
+        texture.data.clear();
+        texture.source = findKeyValue(file.data() + header.kvdByteOffset, header.kvdByteLength, SOURCE_KEY);
+
+        uint64_t dataSize = 0;
+        for (uint32_t i = 0; i < header.levelCount; i++) {
+            LevelIndex entry;
+            memcpy(&entry, file.data() + sizeof(Header) + i * sizeof(LevelIndex), sizeof(LevelIndex));
+
+            uint32_t width = std::max(1u, header.pixelWidth >> i);
+            uint32_t height = std::max(1u, header.pixelHeight >> i);
+            uint64_t expectedSize = uint64_t((width + blockWidth - 1) / blockWidth) * ((height + blockHeight - 1) / blockHeight) * blockBytes;
+            if (entry.byteLength != expectedSize || entry.byteOffset > file.size() || entry.byteLength > file.size() - entry.byteOffset) {
+                return false;
+            }
+
+            texture.levels.push_back({width, height, dataSize, entry.byteLength});
+            dataSize += entry.byteLength;
+        }
+
+        texture.data.resize(dataSize);
+        for (uint32_t i = 0; i < header.levelCount; i++) {
+            LevelIndex entry;
+            memcpy(&entry, file.data() + sizeof(Header) + i * sizeof(LevelIndex), sizeof(LevelIndex));
+            memcpy(texture.data.data() + texture.levels[i].offset, file.data() + entry.byteOffset, entry.byteLength);
+        }
+        return true;
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace testengine {
+
+    //one mip level, data is tightly packed rows of texels or of blocks for block compressed formats
+    struct TextureLevel {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    //a 2D texture with all of its mip levels, level 0 being the largest
+    struct TextureData {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<TextureLevel> levels;
+        std::vector<uint8_t> data;
+        //identifies the source image the texture was imported from, stored as key/value data
+        std::string source;
+    };
+
+    //texel block size of the formats the engine reads and writes, false for any other format
+    bool getFormatBlock(VkFormat format, uint32_t& blockWidth, uint32_t& blockHeight, uint32_t& blockBytes);
+
+    //Khronos KTX 2.0 container with the data format descriptor of the format, no supercompression.
+    //Levels are stored smallest first as the specification requires, so a reader can start with the coarse mips.
+    //Writes through a temporary file, returns false if path could not be written.
+    bool writeKtx2(const std::string& path, const TextureData& texture);
+    //reads single layer, single face 2D textures of a format known to getFormatBlock; returns false if the
+    //file is missing or not such a texture
+    bool readKtx2(const std::string& path, TextureData& texture);
+}
@@ -1,16 +1,224 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
+#include "meshlets.hpp"
+#include "meshoptimizer.hpp"
+#include "meshsimplifier.hpp"
+#include "objimporter.hpp"
 #include "testengine.hpp"
+#include "textureimporter.hpp"
 
-int main()
+static void printUsage(const char* program)
+{
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --headless          render offscreen without a window or surface\n"
+              << "  --frames <n>        stop after n frames (headless default: 300)\n"
+              << "  --frames-in-flight <n> frames recorded ahead of the GPU, lower for latency, higher for throughput (default: 2)\n"
+              << "  --msaa <samples>    MSAA sample count, a power of two lowered to what the device supports, 1 disables it\n"
+              << "                      (default: the most the attachment budgets allow at the initial size, up to 8)\n"
+              << "  --attachment-budget <MiB> memory MSAA attachments may take unless lazily allocated, checked at the\n"
+              << "                      initial size only, resizes keep the sample count (default: 256)\n"
+              << "  --attachment-bandwidth <GB/s> bandwidth MSAA attachments may take unless kept in tile memory, checked\n"
+              << "                      at the initial size only (default: 20)\n"
+              << "  --pacing <mode>     throughput, or low-latency to sample input as late as the next refresh allows (default: throughput)\n"
+              << "  --refresh-rate <hz> display rate frames are paced to, headless runs present to a simulated display at it (default: monitor)\n"
+              << "  --width <pixels>    render target width\n"
+              << "  --height <pixels>   render target height\n"
+              << "  --import-threads <n> threads used to import models (default: all)\n"
+              << "  --no-mesh-optimize  keep imported models in file order instead of optimizing them\n"
+              << "  --no-packed-vertices use 32 byte float vertices instead of 12 byte quantized ones\n"
+              << "  --no-texture-compression upload RGBA8 textures instead of BC7\n"
+              << "  --no-bindless       bind the single texture directly instead of indexing a descriptor table\n"
+              << "  --texture-budget <MiB> device memory for streamed texture levels (default: 256)\n"
+              << "  --lod-levels <n>    levels of detail generated for imported models, 1 disables LOD (default: 4)\n"
+              << "  --lod-error <pixels> screen space error allowed before a coarser level is drawn (default: 1)\n"
+              << "  --instances <n>     number of model instances placed on a grid (default: 1)\n"
+              << "  --no-instancing     draw every instance with its own draw call\n"
+              << "  --no-gpu-culling    record the draws on the CPU instead of culling in a compute pass\n"
+              << "  --meshlet-culling   cull the meshlets of every instance on the GPU, draws full resolution only\n"
+              << "  --record-threads <n> threads recording CPU draws into secondary command buffers (default: all)\n"
+              << "  --profile-trace <json> write a Chrome trace of the last profiled CPU and GPU scopes on exit\n"
+              << "  --cpu-trace <json>  stream every traced CPU scope of every thread to a Chrome trace while running\n"
+              << "  --bench-import <obj> time OBJ import on 1..n threads against tinyobjloader and exit\n"
+              << "  --bench-trace <json> <scopes>\n"
+              << "                      time nested TE_TRACE_SCOPEs without and with a trace written to json and exit\n"
+              << "  --mesh-report <obj> print vertex cache and fetch statistics after each optimization stage and exit\n"
+              << "  --lod-report <obj>  print the triangle count and error of every generated level of detail and exit\n"
+              << "  --meshlet-report <obj> print meshlet fill rates and the triangles culled from a ring of views and exit\n"
+              << "  --texture-report <image> print BC7 size, encode time and PSNR of every mip level and exit\n"
+              << "  --bake-texture <image> <ktx2>\n"
+              << "                      write the image with its mips as BC7 (RGBA8 with --no-texture-compression) and exit\n"
+              << "  --generate-obj <obj> <triangles>\n"
+              << "                      write a grid mesh for --bench-import and exit\n";
+}
+
+struct Options {
+    testengine::EngineConfig config;
+    std::string benchImportPath;
+    std::string benchTracePath;
+    uint64_t benchTraceScopes = 0;
+    std::string meshReportPath;
+    std::string lodReportPath;
+    std::string meshletReportPath;
+    std::string textureReportPath;
+    std::string bakeTexturePath;
+    std::string bakeTextureOutput;
+    std::string generateObjPath;
+    uint64_t generateTriangles = 0;
+};
+
+static Options parseArguments(int argc, char** argv)
+{
+    Options options;
+    testengine::EngineConfig& config = options.config;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        auto nextString = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Invalid argument: missing value for " + arg + ".");
+            }
+            return argv[++i];
+        };
+        auto nextValue = [&]() -> uint32_t {
+            return static_cast<uint32_t>(std::stoul(nextString()));
+        };
+
+        if (arg == "--headless") {
+            config.headless = true;
+        } else if (arg == "--frames") {
+            config.frameCount = nextValue();
+        } else if (arg == "--frames-in-flight") {
+            config.framesInFlight = std::max(nextValue(), 1u);
+        } else if (arg == "--msaa") {
+            config.msaaSamples = nextValue();
+            if (config.msaaSamples == 0 || config.msaaSamples > 64 || (config.msaaSamples & (config.msaaSamples - 1)) != 0) {
+                throw std::invalid_argument("Invalid argument: MSAA sample count " + std::to_string(config.msaaSamples) + " is not a power of two up to 64.");
+            }
+        } else if (arg == "--attachment-budget") {
+            config.attachmentMemoryBudget = VkDeviceSize(nextValue()) * 1024 * 1024;
+        } else if (arg == "--attachment-bandwidth") {
+            config.attachmentBandwidthBudget = std::stof(nextString());
+        } else if (arg == "--pacing") {
+            std::string mode = nextString();
+            if (mode == "throughput") {
+                config.framePacing = testengine::FRAME_PACING_THROUGHPUT;
+            } else if (mode == "low-latency") {
+                config.framePacing = testengine::FRAME_PACING_LOW_LATENCY;
+            } else {
+                throw std::invalid_argument("Invalid argument: unknown pacing mode " + mode + ".");
+            }
+        } else if (arg == "--refresh-rate") {
+            config.refreshRate = nextValue();
+        } else if (arg == "--width") {
+            config.width = nextValue();
+        } else if (arg == "--height") {
+            config.height = nextValue();
+        } else if (arg == "--import-threads") {
+            config.importThreads = nextValue();
+        } else if (arg == "--instances") {
+            config.instanceCount = nextValue();
+        } else if (arg == "--no-instancing") {
+            config.instancing = false;
+        } else if (arg == "--no-gpu-culling") {
+            config.gpuCulling = false;
+        } else if (arg == "--meshlet-culling") {
+            config.meshletCulling = true;
+        } else if (arg == "--record-threads") {
+            config.recordThreads = nextValue();
+        } else if (arg == "--profile-trace") {
+            config.profileTracePath = nextString();
+        } else if (arg == "--cpu-trace") {
+            config.cpuTracePath = nextString();
+        } else if (arg == "--no-mesh-optimize") {
+            config.meshOptimizeFlags = 0;
+        } else if (arg == "--no-packed-vertices") {
+            config.packedVertices = false;
+        } else if (arg == "--no-texture-compression") {
+            config.compressedTextures = false;
+        } else if (arg == "--no-bindless") {
+            config.bindlessTextures = false;
+        } else if (arg == "--texture-budget") {
+            config.textureBudget = VkDeviceSize(nextValue()) * 1024 * 1024;
+        } else if (arg == "--lod-levels") {
+            config.lodLevels = nextValue();
+        } else if (arg == "--lod-error") {
+            config.lodErrorPixels = std::stof(nextString());
+        } else if (arg == "--lod-report") {
+            options.lodReportPath = nextString();
+        } else if (arg == "--meshlet-report") {
+            options.meshletReportPath = nextString();
+        } else if (arg == "--texture-report") {
+            options.textureReportPath = nextString();
+        } else if (arg == "--bake-texture") {
+            options.bakeTexturePath = nextString();
+            options.bakeTextureOutput = nextString();
+        } else if (arg == "--mesh-report") {
+            options.meshReportPath = nextString();
+        } else if (arg == "--bench-import") {
+            options.benchImportPath = nextString();
+        } else if (arg == "--bench-trace") {
+            options.benchTracePath = nextString();
+            options.benchTraceScopes = std::stoull(nextString());
+        } else if (arg == "--generate-obj") {
+            options.generateObjPath = nextString();
+            options.generateTriangles = std::stoull(nextString());
+        } else if (arg == "--help") {
+            printUsage(argv[0]);
+            std::exit(EXIT_SUCCESS);
+        } else {
+            throw std::invalid_argument("Invalid argument: unknown option " + arg + ".");
+        }
+    }
+
+    return options;
+}
+
+int main(int argc, char** argv)
 {
-    testengine::TestEngine engine;
     try{
+        Options options = parseArguments(argc, argv);
+
+        if (!options.generateObjPath.empty()) {
+            testengine::writeBenchmarkObj(options.generateObjPath, options.generateTriangles);
+        }
+        if (!options.benchImportPath.empty()) {
+            testengine::benchmarkObjImport(options.benchImportPath, options.config.importThreads);
+        }
+        if (!options.benchTracePath.empty()) {
+            testengine::benchmarkTraceScopes(options.benchTracePath, options.benchTraceScopes);
+        }
+        if (!options.meshReportPath.empty()) {
+            testengine::reportMeshOptimization(options.meshReportPath, options.config.importThreads);
+        }
+        if (!options.lodReportPath.empty()) {
+            testengine::reportMeshLods(options.lodReportPath, options.config.importThreads, options.config.lodLevels);
+        }
+        if (!options.meshletReportPath.empty()) {
+            testengine::reportMeshlets(options.meshletReportPath, options.config.importThreads);
+        }
+        if (!options.textureReportPath.empty()) {
+            testengine::reportTextureCompression(options.textureReportPath, options.config.importThreads);
+        }
+        if (!options.bakeTexturePath.empty()) {
+            testengine::bakeTexture(options.bakeTexturePath, options.bakeTextureOutput,
+                                    options.config.compressedTextures ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_R8G8B8A8_SRGB,
+                                    options.config.importThreads);
+        }
+        if (!options.generateObjPath.empty() || !options.benchImportPath.empty() || !options.benchTracePath.empty() || !options.meshReportPath.empty() ||
+            !options.lodReportPath.empty() || !options.meshletReportPath.empty() || !options.textureReportPath.empty() ||
+            !options.bakeTexturePath.empty()) {
+            return EXIT_SUCCESS;
+        }
+
+        testengine::TestEngine engine(options.config);
         engine.run();
     } catch (const std::exception &e){
         std::cerr << e.what() << '\n';
@@ -18,4 +226,4 @@ int main()
     }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,188 @@
+#include "meshcache.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace testengine {
+
+    MeshCache::MeshCache(std::string directory, uint32_t importSettings)
+        : directory(std::move(directory)), importSettings(importSettings) {}
+
+    bool MeshCache::open(const std::string& sourcePath) {
+        close();
+
+        SourceStamp stamp{};
+        if (!stampSource(sourcePath, stamp)) {
+            return false;
+        }
+
+        std::string path = cachePath(sourcePath);
+        if (!file.open(path) || file.size() < sizeof(Header)) {
+            close();
+            return false;
+        }
+
+        Header header;
+        memcpy(&header, file.data(), sizeof(Header));
+
+        if (header.magic != MAGIC || header.version != VERSION || header.importSettings != importSettings ||
+            header.sourceSize != stamp.size) {
+            close();
+            return false;
+        }
+
+        //an mtime change alone (checkout, copy, touch) does not invalidate the cache if the contents are identical
+        if (header.sourceMtime != stamp.mtime) {
+            if (hashSource(sourcePath) != header.sourceHash) {
+                close();
+                return false;
+            }
+            refreshStamp(path, stamp);
+        }
+
+        uint64_t tableEnd = sizeof(Header) + static_cast<uint64_t>(header.chunkCount) * sizeof(ChunkEntry);
+        if (tableEnd > file.size()) {
+            close();
+            return false;
+        }
+
+        for (uint32_t i = 0; i < header.chunkCount; i++) {
+            ChunkEntry entry;
+            memcpy(&entry, file.data() + sizeof(Header) + i * sizeof(ChunkEntry), sizeof(ChunkEntry));
+
+            if (entry.offset < tableEnd || entry.offset > file.size() || entry.size > file.size() - entry.offset ||
+                entry.elementSize == 0 || entry.size % entry.elementSize != 0) {
+                close();
+                return false;
+            }
+
+            chunks.push_back({entry.id, entry.elementSize, file.data() + entry.offset, entry.size});
+        }
+
+        return true;
+    }
+
+    void MeshCache::close() {
+        chunks.clear();
+        file.close();
+    }
+
+    const MeshChunk* MeshCache::findChunk(uint32_t id) const {
+        for (const auto& chunk : chunks) {
+            if (chunk.id == id) {
+                return &chunk;
+            }
+        }
+        return nullptr;
+    }
+
+    void MeshCache::store(const std::string& sourcePath, const std::vector<MeshChunk>& newChunks) {
+        SourceStamp stamp{};
+        if (!stampSource(sourcePath, stamp)) {
+            throw std::runtime_error("Runtime error: failed to stat mesh source " + sourcePath + ".");
+        }
+
+        Header header{};
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.importSettings = importSettings;
+        header.chunkCount = static_cast<uint32_t>(newChunks.size());
+        header.sourceSize = stamp.size;
+        header.sourceMtime = stamp.mtime;
+        header.sourceHash = hashSource(sourcePath);
+
+        std::vector<ChunkEntry> entries;
+        uint64_t offset = sizeof(Header) + newChunks.size() * sizeof(ChunkEntry);
+        for (const auto& chunk : newChunks) {
+            offset = (offset + CHUNK_ALIGNMENT - 1) & ~(CHUNK_ALIGNMENT - 1);
+            entries.push_back({chunk.id, chunk.elementSize, offset, chunk.size});
+            offset += chunk.size;
+        }
+
+        std::filesystem::create_directories(directory);
+
+        //write to a temporary file and rename it, so a crash never leaves a torn cache behind
+        std::string path = cachePath(sourcePath);
+        std::string temporaryPath = path + ".tmp";
+        {
+            std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                std::cerr << "Warning: failed to write mesh cache " << temporaryPath << '\n';
+                return;
+            }
+
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ChunkEntry));
+
+            const char padding[CHUNK_ALIGNMENT] = {};
+            for (size_t i = 0; i < newChunks.size(); i++) {
+                out.write(padding, static_cast<std::streamsize>(entries[i].offset - static_cast<uint64_t>(out.tellp())));
+                out.write(static_cast<const char*>(newChunks[i].data), static_cast<std::streamsize>(newChunks[i].size));
+            }
+
+            if (!out) {
+                std::cerr << "Warning: failed to write mesh cache " << temporaryPath << '\n';
+                return;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error) {
+            std::cerr << "Warning: failed to write mesh cache " << path << ": " << error.message() << '\n';
+        }
+    }
+
+    std::string MeshCache::cachePath(const std::string& sourcePath) const {
+        std::error_code error;
+        std::string absolutePath = std::filesystem::absolute(sourcePath, error).string();
+        uint64_t pathHash = utils::fnv1a64(absolutePath.data(), absolutePath.size());
+
+        std::ostringstream name;
+        name << directory << '/' << std::filesystem::path(sourcePath).stem().string() << '-'
+             << std::hex << std::setw(16) << std::setfill('0') << pathHash << ".mesh";
+        return name.str();
+    }
+
+    bool MeshCache::stampSource(const std::string& sourcePath, SourceStamp& stamp) {
+        std::error_code error;
+        uintmax_t size = std::filesystem::file_size(sourcePath, error);
+        if (error) {
+            return false;
+        }
+
+        auto mtime = std::filesystem::last_write_time(sourcePath, error);
+        if (error) {
+            return false;
+        }
+
+        stamp.size = static_cast<uint64_t>(size);
+        stamp.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+        return true;
+    }
+
+    uint64_t MeshCache::hashSource(const std::string& sourcePath) {
+        utils::MappedFile source;
+        if (!source.open(sourcePath)) {
+            return 0;
+        }
+        return utils::fnv1a64(source.data(), source.size());
+    }
+
+    void MeshCache::refreshStamp(const std::string& path, const SourceStamp& stamp) {
+        Header header;
+        memcpy(&header, file.data(), sizeof(Header));
+        header.sourceMtime = stamp.mtime;
+
+        std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+        if (out.is_open()) {
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace testengine {
+
+    //one typed array inside a cached mesh, data points into the memory mapped cache file
+    struct MeshChunk {
+        uint32_t id;
+        uint32_t elementSize;
+        const void* data;
+        uint64_t size;
+    };
+
+    enum MeshChunkId : uint32_t {
+        MESH_CHUNK_VERTICES = 1,
+        MESH_CHUNK_INDICES = 2,
+        MESH_CHUNK_LODS = 3,
+        MESH_CHUNK_MESHLETS = 4
+    };
+
+    //Binary cache for imported meshes. A cache file stores the final vertex/index arrays of a source model
+    //and is keyed on the source's size, mtime and content hash plus the import settings that produced it.
+    //A hit memory maps the file and exposes the arrays in place, without parsing or hashing the source.
+    class MeshCache {
+        public:
+            explicit MeshCache(std::string directory, uint32_t importSettings = 0);
+
+            bool open(const std::string& sourcePath);
+            void close();
+
+            const MeshChunk* findChunk(uint32_t id) const;
+
+            void store(const std::string& sourcePath, const std::vector<MeshChunk>& chunks);
+
+        private:
+            static constexpr uint32_t MAGIC = 0x434D4554; //"TEMC"
+            static constexpr uint32_t VERSION = 1;
+            static constexpr uint64_t CHUNK_ALIGNMENT = 16;
+
+            struct Header {
+                uint32_t magic;
+                uint32_t version;
+                uint32_t importSettings;
+                uint32_t chunkCount;
+                uint64_t sourceSize;
+                int64_t sourceMtime;
+                uint64_t sourceHash;
+            };
+
+            struct ChunkEntry {
+                uint32_t id;
+                uint32_t elementSize;
+                uint64_t offset;
+                uint64_t size;
+            };
+
+            struct SourceStamp {
+                uint64_t size;
+                int64_t mtime;
+            };
+
+            std::string directory;
+            uint32_t importSettings;
+
+            utils::MappedFile file;
+            std::vector<MeshChunk> chunks;
+
+            std::string cachePath(const std::string& sourcePath) const;
+            static bool stampSource(const std::string& sourcePath, SourceStamp& stamp);
+            static uint64_t hashSource(const std::string& sourcePath);
+            void refreshStamp(const std::string& path, const SourceStamp& stamp);
+    };
+}
@@ -0,0 +1,255 @@
+#include "meshletpass.hpp"
+
+#include "utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace testengine {
+
+    namespace {
+
+        uint32_t groupCount(uint32_t invocations, uint32_t groupSize) {
+            return (invocations + groupSize - 1) / groupSize;
+        }
+    }
+
+    void MeshletPass::init(VkDevice device, GpuAllocator* allocator, UploadManager* uploadManager, VkPipelineCache pipelineCache,
+                           const DeviceCapabilities& capabilities, const Scene& scene, const Meshlet* meshlets, uint32_t meshletCount,
+                           int32_t vertexOffset, VkBuffer instanceBuffer, uint32_t framesInFlight) {
+        this->device = device;
+        this->allocator = allocator;
+        this->capabilities = capabilities;
+        this->meshletCount = meshletCount;
+        this->vertexOffset = vertexOffset;
+
+        instanceCount = scene.getInstanceCount();
+        if (uint64_t(instanceCount) * meshletCount > MAX_MESHLET_DRAWS) {
+            throw std::runtime_error("Runtime error: too many meshlet draws for the meshlet pass.");
+        }
+        drawCount = instanceCount * meshletCount;
+
+        //sizes are clamped to one element so empty scenes still get valid buffers
+        createBuffer(sizeof(Meshlet) * std::max(meshletCount, 1u), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     meshletBuffer, meshletBufferAllocation);
+        if (meshletCount > 0) {
+            uploadManager->uploadBuffer(meshletBuffer, meshlets, sizeof(Meshlet) * meshletCount,
+                                        VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        }
+
+        frames.resize(framesInFlight);
+        for (FrameResources& frame : frames) {
+            createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                         frame.counts, frame.countsAllocation);
+            createBuffer(sizeof(VkDrawIndexedIndirectCommand) * std::max(drawCount, 1u), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                         frame.commands, frame.commandsAllocation);
+        }
+
+        createDescriptorSets(instanceBuffer);
+        createPipeline(pipelineCache);
+    }
+
+    void MeshletPass::destroy() {
+        vkDestroyPipeline(device, pipeline, nullptr);
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+        for (FrameResources& frame : frames) {
+            vkDestroyBuffer(device, frame.counts, nullptr);
+            allocator->free(frame.countsAllocation);
+            vkDestroyBuffer(device, frame.commands, nullptr);
+            allocator->free(frame.commandsAllocation);
+        }
+        frames.clear();
+
+        vkDestroyBuffer(device, meshletBuffer, nullptr);
+        allocator->free(meshletBufferAllocation);
+    }
+
+    void MeshletPass::record(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4& clip, const glm::vec3& cameraPosition) {
+        if (drawCount == 0) {
+            return;
+        }
+
+        FrameResources& resources = frames[frame];
+
+        vkCmdFillBuffer(commandBuffer, resources.counts, 0, VK_WHOLE_SIZE, 0);
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+
+        CullParameters parameters{};
+        extractFrustumPlanes(clip, parameters.frustumPlanes);
+        parameters.cameraPosition = glm::vec4(cameraPosition, 1.0f);
+        parameters.instanceCount = instanceCount;
+        parameters.meshletCount = meshletCount;
+        parameters.vertexOffset = vertexOffset;
+        parameters.compactDraws = capabilities.drawIndirectCount ? 1 : 0;
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &resources.descriptorSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(parameters), &parameters);
+        vkCmdDispatch(commandBuffer, groupCount(drawCount, WORKGROUP_SIZE), 1, 1);
+
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void MeshletPass::draw(VkCommandBuffer commandBuffer, uint32_t frame) {
+        if (drawCount == 0) {
+            return;
+        }
+
+        FrameResources& resources = frames[frame];
+        const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+        if (capabilities.drawIndirectCount) {
+            vkCmdDrawIndexedIndirectCount(commandBuffer, resources.commands, 0, resources.counts, 0, drawCount, stride);
+        } else {
+            vkCmdDrawIndexedIndirect(commandBuffer, resources.commands, 0, drawCount, stride);
+        }
+    }
+
+    void MeshletPass::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, GpuAllocation& allocation) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create meshlet buffer.");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+        allocation = allocator->allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+        vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+    }
+
+    void MeshletPass::createDescriptorSets(VkBuffer instanceBuffer) {
+        std::array<VkDescriptorSetLayoutBinding, 4> bindings{};
+        for (uint32_t i = 0; i < bindings.size(); i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create meshlet descriptor set layout.");
+        }
+
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSize.descriptorCount = static_cast<uint32_t>(bindings.size() * frames.size());
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = static_cast<uint32_t>(frames.size());
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create meshlet descriptor pool.");
+        }
+
+        std::vector<VkDescriptorSetLayout> layouts(frames.size(), descriptorSetLayout);
+        std::vector<VkDescriptorSet> sets(frames.size());
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(frames.size());
+        allocInfo.pSetLayouts = layouts.data();
+
+        if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to allocate meshlet descriptor sets.");
+        }
+
+        for (size_t i = 0; i < frames.size(); i++) {
+            frames[i].descriptorSet = sets[i];
+
+            std::array<VkDescriptorBufferInfo, 4> bufferInfos = {{
+                {instanceBuffer, 0, VK_WHOLE_SIZE},
+                {meshletBuffer, 0, VK_WHOLE_SIZE},
+                {frames[i].counts, 0, VK_WHOLE_SIZE},
+                {frames[i].commands, 0, VK_WHOLE_SIZE}
+            }};
+
+            std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+            for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+                descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[binding].dstSet = sets[i];
+                descriptorWrites[binding].dstBinding = binding;
+                descriptorWrites[binding].dstArrayElement = 0;
+                descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                descriptorWrites[binding].descriptorCount = 1;
+                descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+            }
+
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        }
+    }
+
+    void MeshletPass::createPipeline(VkPipelineCache pipelineCache) {
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(CullParameters);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create meshlet pipeline layout.");
+        }
+
+        std::vector<char> shaderCode = utils::readFile("shaders/compiled/meshlet_cull.comp.spv");
+
+        VkShaderModuleCreateInfo moduleInfo{};
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.codeSize = shaderCode.size();
+        moduleInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+
+        VkShaderModule shaderModule;
+        if (vkCreateShaderModule(device, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create meshlet shader module.");
+        }
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = shaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = pipelineLayout;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+        pipelineInfo.basePipelineIndex = -1;
+
+        VkResult result = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+        vkDestroyShaderModule(device, shaderModule, nullptr);
+
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create meshlet pipeline.");
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "devicecapabilities.hpp"
+#include "gpuallocator.hpp"
+#include "meshlets.hpp"
+#include "scene.hpp"
+#include "uploadmanager.hpp"
+
+namespace testengine {
+
+    //Cluster level culling of a Scene whose instances all draw the same meshlets. A compute pass tests every
+    //meshlet of every instance against the frustum and its normal cone against the camera, and writes one
+    //VkDrawIndexedIndirectCommand per surviving meshlet with firstInstance selecting the instance, so backfacing
+    //and off-screen parts of a visible model are never rasterized.
+    //With drawIndirectCount the surviving draws are compacted, otherwise culled draws keep an instance count of 0.
+    class MeshletPass {
+        public:
+            //instances * meshlets above this use CullingPass instead, the command buffers grow with the product
+            static constexpr uint32_t MAX_MESHLET_DRAWS = 1u << 21;
+
+            MeshletPass() = default;
+            MeshletPass(const MeshletPass&) = delete;
+            MeshletPass& operator=(const MeshletPass&) = delete;
+
+            //the device needs drawIndirectFirstInstance and either drawIndirectCount or multiDrawIndirect,
+            //instanceBuffer needs STORAGE_BUFFER usage
+            void init(VkDevice device, GpuAllocator* allocator, UploadManager* uploadManager, VkPipelineCache pipelineCache,
+                      const DeviceCapabilities& capabilities, const Scene& scene, const Meshlet* meshlets, uint32_t meshletCount,
+                      int32_t vertexOffset, VkBuffer instanceBuffer, uint32_t framesInFlight);
+            void destroy();
+
+            //culls against the frustum of clip (projection * view * model) and cameraPosition in the same space,
+            //has to be recorded outside a render pass
+            void record(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4& clip, const glm::vec3& cameraPosition);
+            //issues the indirect draws, the instance buffer has to be bound to vertex binding 1
+            void draw(VkCommandBuffer commandBuffer, uint32_t frame);
+
+        private:
+            static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+            //matches CullParameters in meshlet_cull.comp
+            struct CullParameters {
+                glm::vec4 frustumPlanes[6];
+                glm::vec4 cameraPosition;
+                uint32_t instanceCount;
+                uint32_t meshletCount;
+                int32_t vertexOffset;
+                uint32_t compactDraws;
+            };
+
+            struct FrameResources {
+                VkBuffer counts = VK_NULL_HANDLE;
+                GpuAllocation countsAllocation;
+                VkBuffer commands = VK_NULL_HANDLE;
+                GpuAllocation commandsAllocation;
+                VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+            };
+
+            VkDevice device = VK_NULL_HANDLE;
+            GpuAllocator* allocator = nullptr;
+            DeviceCapabilities capabilities;
+
+            uint32_t instanceCount = 0;
+            uint32_t meshletCount = 0;
+            int32_t vertexOffset = 0;
+            uint32_t drawCount = 0;
+
+            VkBuffer meshletBuffer = VK_NULL_HANDLE;
+            GpuAllocation meshletBufferAllocation;
+            std::vector<FrameResources> frames;
+
+            VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+            VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+            VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+            VkPipeline pipeline = VK_NULL_HANDLE;
+
+            void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, GpuAllocation& allocation);
+            void createDescriptorSets(VkBuffer instanceBuffer);
+            void createPipeline(VkPipelineCache pipelineCache);
+    };
+}
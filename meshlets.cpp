@@ -0,0 +1,327 @@
+#include "meshlets.hpp"
+
+#include "meshoptimizer.hpp"
+#include "objimporter.hpp"
+#include "scene.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace testengine {
+
+    namespace {
+
+        const uint32_t NO_TRIANGLE = UINT32_MAX;
+
+        struct PositionHash {
+            size_t operator()(const glm::vec3& p) const {
+                uint32_t bits[3];
+                memcpy(bits, &p, sizeof(bits));
+                return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+            }
+        };
+
+        //cones wider than this (the smallest dot product between the axis and a normal) reject too few views
+        const float MIN_CONE_DOT = 0.1f;
+
+        //camera rings of reportMeshlets(), as multiples of the model's bounding radius
+        const float ORBIT_DISTANCE = 2.5f;
+        const float CLOSE_DISTANCE = 1.2f;
+        const uint32_t VIEWS_PER_RING = 8;
+
+        glm::vec3 triangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+            return glm::cross(b - a, c - a);
+        }
+
+        void computeBounds(const std::vector<Vertex>& vertices, const uint32_t* indices, const std::vector<uint32_t>& meshletVertices,
+                           Meshlet& meshlet) {
+            glm::vec3 minimum = vertices[meshletVertices[0]].pos;
+            glm::vec3 maximum = minimum;
+            for (uint32_t vertex : meshletVertices) {
+                minimum = glm::min(minimum, vertices[vertex].pos);
+                maximum = glm::max(maximum, vertices[vertex].pos);
+            }
+
+            glm::vec3 center = (minimum + maximum) * 0.5f;
+            float radius = 0.0f;
+            for (uint32_t vertex : meshletVertices) {
+                radius = std::max(radius, glm::length(vertices[vertex].pos - center));
+            }
+            meshlet.boundingSphere = glm::vec4(center, radius);
+
+            glm::vec3 axis(0.0f);
+            std::vector<glm::vec3> normals;
+            normals.reserve(meshlet.indexCount / 3);
+            for (uint32_t i = 0; i < meshlet.indexCount; i += 3) {
+                glm::vec3 normal = triangleNormal(vertices[indices[i]].pos, vertices[indices[i + 1]].pos, vertices[indices[i + 2]].pos);
+                float length = glm::length(normal);
+                if (length > 0.0f) {
+                    normals.push_back(normal / length);
+                    axis += normals.back();
+                }
+            }
+
+            meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            float axisLength = glm::length(axis);
+            if (axisLength == 0.0f) {
+                return;
+            }
+            axis /= axisLength;
+
+            float minimumDot = 1.0f;
+            for (const glm::vec3& normal : normals) {
+                minimumDot = std::min(minimumDot, glm::dot(axis, normal));
+            }
+            if (minimumDot < MIN_CONE_DOT) {
+                return;
+            }
+
+            //backfacing from every point whose direction to the meshlet is within 90 degrees minus the cone angle of the axis
+            meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minimumDot * minimumDot));
+        }
+
+        glm::vec3 orbitPosition(const glm::vec4& sphere, float distance, uint32_t view) {
+            float angle = 2.0f * 3.14159265f * float(view) / float(VIEWS_PER_RING);
+            //30 degrees above the xy plane, the model's up axis is z
+            return glm::vec3(sphere) + distance * sphere.w * glm::vec3(std::cos(angle) * 0.866f, std::sin(angle) * 0.866f, 0.5f);
+        }
+    }
+
+    std::vector<Meshlet> buildMeshlets(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+                                       uint32_t maxVertices, uint32_t maxTriangles) {
+        uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+        uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+        //triangles are adjacent if they share a position, texture seams would otherwise split most models into
+        //many small islands
+        std::vector<uint32_t> positionIds(vertexCount);
+        std::unordered_map<glm::vec3, uint32_t, PositionHash> firstAtPosition;
+        firstAtPosition.reserve(vertexCount);
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            positionIds[i] = firstAtPosition.emplace(vertices[i].pos, i).first->second;
+        }
+
+        std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+        for (uint32_t index : indices) {
+            triangleOffsets[positionIds[index] + 1]++;
+        }
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            triangleOffsets[i + 1] += triangleOffsets[i];
+        }
+        std::vector<uint32_t> adjacentTriangles(indices.size());
+        std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for (uint32_t i = 0; i < indices.size(); i++) {
+            adjacentTriangles[fill[positionIds[indices[i]]]++] = i / 3;
+        }
+
+        std::vector<bool> clustered(triangleCount, false);
+        //the last meshlet a vertex was added to, so membership tests need no clearing between meshlets
+        std::vector<uint32_t> vertexMeshlet(vertexCount, UINT32_MAX);
+        //position of a vertex in its meshlet's vertex list
+        std::vector<uint32_t> localVertex(vertexCount, 0);
+
+        std::vector<Meshlet> meshlets;
+        std::vector<uint32_t> reordered;
+        reordered.reserve(indices.size());
+        std::vector<uint32_t> meshletVertices;
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> localIndices;
+
+        uint32_t nextSeed = 0;
+        while (true) {
+            while (nextSeed < triangleCount && clustered[nextSeed]) {
+                nextSeed++;
+            }
+            if (nextSeed == triangleCount) {
+                break;
+            }
+
+            uint32_t id = static_cast<uint32_t>(meshlets.size());
+            Meshlet meshlet{};
+            meshlet.firstIndex = static_cast<uint32_t>(reordered.size());
+            meshletVertices.clear();
+            candidates.clear();
+
+            glm::vec3 positionSum(0.0f);
+
+            auto newVertexCount = [&](uint32_t triangle) {
+                uint32_t count = 0;
+                for (int corner = 0; corner < 3; corner++) {
+                    count += vertexMeshlet[indices[triangle * 3 + corner]] != id ? 1 : 0;
+                }
+                return count;
+            };
+            auto distanceToCenter = [&](uint32_t triangle, const glm::vec3& center) {
+                const uint32_t* corners = &indices[triangle * 3];
+                glm::vec3 centroid = (vertices[corners[0]].pos + vertices[corners[1]].pos + vertices[corners[2]].pos) / 3.0f;
+                glm::vec3 offset = centroid - center;
+                return glm::dot(offset, offset);
+            };
+
+            uint32_t triangle = nextSeed;
+            while (triangle != NO_TRIANGLE) {
+                clustered[triangle] = true;
+                for (int corner = 0; corner < 3; corner++) {
+                    uint32_t vertex = indices[triangle * 3 + corner];
+                    reordered.push_back(vertex);
+                    if (vertexMeshlet[vertex] != id) {
+                        vertexMeshlet[vertex] = id;
+                        localVertex[vertex] = static_cast<uint32_t>(meshletVertices.size());
+                        meshletVertices.push_back(vertex);
+                        positionSum += vertices[vertex].pos;
+                        uint32_t position = positionIds[vertex];
+                        for (uint32_t t = triangleOffsets[position]; t < triangleOffsets[position + 1]; t++) {
+                            if (!clustered[adjacentTriangles[t]]) {
+                                candidates.push_back(adjacentTriangles[t]);
+                            }
+                        }
+                    }
+                }
+                meshlet.indexCount += 3;
+                if (meshlet.indexCount / 3 == maxTriangles) {
+                    break;
+                }
+
+                //fewest new vertices first, then the closest to the meshlet's center to keep it round
+                glm::vec3 center = positionSum / float(meshletVertices.size());
+                triangle = NO_TRIANGLE;
+                uint32_t bestAdded = 4;
+                float bestDistance = 0.0f;
+                size_t write = 0;
+                for (uint32_t candidate : candidates) {
+                    if (clustered[candidate]) {
+                        continue;
+                    }
+                    candidates[write++] = candidate;
+
+                    uint32_t added = newVertexCount(candidate);
+                    if (meshletVertices.size() + added > maxVertices || added > bestAdded) {
+                        continue;
+                    }
+                    float distance = distanceToCenter(candidate, center);
+                    if (added < bestAdded || distance < bestDistance || (distance == bestDistance && candidate < triangle)) {
+                        bestAdded = added;
+                        bestDistance = distance;
+                        triangle = candidate;
+                    }
+                }
+                candidates.resize(write);
+            }
+
+            meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+
+            //growth order is poor for the post transform cache, sort the meshlet's triangles on local indices
+            //so the cost only depends on the meshlet size
+            localIndices.clear();
+            for (uint32_t i = meshlet.firstIndex; i < reordered.size(); i++) {
+                localIndices.push_back(localVertex[reordered[i]]);
+            }
+            optimizeVertexCache(localIndices, meshlet.vertexCount);
+            for (uint32_t i = 0; i < meshlet.indexCount; i++) {
+                reordered[meshlet.firstIndex + i] = meshletVertices[localIndices[i]];
+            }
+
+            computeBounds(vertices, &reordered[meshlet.firstIndex], meshletVertices, meshlet);
+            meshlets.push_back(meshlet);
+        }
+
+        indices.swap(reordered);
+        return meshlets;
+    }
+
+    MeshletStats analyzeMeshlets(const std::vector<Meshlet>& meshlets, uint32_t maxVertices, uint32_t maxTriangles) {
+        MeshletStats stats;
+        stats.meshletCount = static_cast<uint32_t>(meshlets.size());
+        if (meshlets.empty()) {
+            return stats;
+        }
+
+        for (const Meshlet& meshlet : meshlets) {
+            stats.vertexFill += float(meshlet.vertexCount) / float(maxVertices);
+            stats.triangleFill += float(meshlet.indexCount / 3) / float(maxTriangles);
+        }
+        stats.vertexFill /= float(meshlets.size());
+        stats.triangleFill /= float(meshlets.size());
+        return stats;
+    }
+
+    bool isMeshletBackfacing(const Meshlet& meshlet, const glm::vec3& cameraPosition) {
+        glm::vec3 offset = glm::vec3(meshlet.boundingSphere) - cameraPosition;
+        return glm::dot(offset, glm::vec3(meshlet.cone)) >= meshlet.cone.w * glm::length(offset) + meshlet.boundingSphere.w;
+    }
+
+    bool isMeshletOutside(const Meshlet& meshlet, const glm::vec4 frustumPlanes[6]) {
+        for (int i = 0; i < 6; i++) {
+            if (glm::dot(glm::vec3(frustumPlanes[i]), glm::vec3(meshlet.boundingSphere)) + frustumPlanes[i].w < -meshlet.boundingSphere.w) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void reportMeshlets(const std::string& path, uint32_t importThreads) {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+
+        ObjImporter importer(importThreads);
+        importer.import(path, vertices, indices);
+        optimizeMesh(vertices, indices);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Meshlet> meshlets = buildMeshlets(vertices, indices);
+        double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        MeshletStats stats = analyzeMeshlets(meshlets);
+        std::cout << path << ": " << indices.size() / 3 << " triangles in " << stats.meshletCount << " meshlets of at most "
+                  << MESHLET_MAX_VERTICES << " vertices and " << MESHLET_MAX_TRIANGLES << " triangles, built in "
+                  << std::fixed << std::setprecision(1) << buildMs << " ms\n"
+                  << std::setprecision(3) << "fill: vertices " << stats.vertexFill << ", triangles " << stats.triangleFill << '\n'
+                  << "view          backfacing  cone culled  frustum culled  total culled\n";
+
+        glm::vec4 sphere = Scene::computeBoundingSphere(vertices.data(), static_cast<uint32_t>(vertices.size()));
+        const float ringDistances[] = {ORBIT_DISTANCE, CLOSE_DISTANCE};
+        const char* ringNames[] = {"orbit", "close"};
+
+        for (int ring = 0; ring < 2; ring++) {
+            for (uint32_t view = 0; view < VIEWS_PER_RING; view++) {
+                glm::vec3 camera = orbitPosition(sphere, ringDistances[ring], view);
+                glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.01f * sphere.w, 10.0f * sphere.w);
+                glm::mat4 viewMatrix = glm::lookAt(camera, glm::vec3(sphere), glm::vec3(0.0f, 0.0f, 1.0f));
+                glm::vec4 frustumPlanes[6];
+                extractFrustumPlanes(projection * viewMatrix, frustumPlanes);
+
+                //triangles that are really backfacing, the best any cluster test could do
+                size_t backfacing = 0;
+                for (size_t i = 0; i < indices.size(); i += 3) {
+                    const glm::vec3& a = vertices[indices[i]].pos;
+                    glm::vec3 normal = triangleNormal(a, vertices[indices[i + 1]].pos, vertices[indices[i + 2]].pos);
+                    backfacing += glm::dot(normal, a - camera) >= 0.0f ? 1 : 0;
+                }
+
+                size_t coneCulled = 0;
+                size_t frustumCulled = 0;
+                for (const Meshlet& meshlet : meshlets) {
+                    if (isMeshletOutside(meshlet, frustumPlanes)) {
+                        frustumCulled += meshlet.indexCount / 3;
+                    } else if (isMeshletBackfacing(meshlet, camera)) {
+                        coneCulled += meshlet.indexCount / 3;
+                    }
+                }
+
+                float triangleCount = float(indices.size() / 3);
+                std::cout << std::left << std::setw(6) << ringNames[ring] << std::right << std::setw(2) << view
+                          << std::setw(16) << float(backfacing) / triangleCount
+                          << std::setw(13) << float(coneCulled) / triangleCount
+                          << std::setw(16) << float(frustumCulled) / triangleCount
+                          << std::setw(14) << float(coneCulled + frustumCulled) / triangleCount << '\n';
+            }
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vertex.hpp"
+
+namespace testengine {
+
+    const uint32_t MESHLET_MAX_VERTICES = 64;
+    const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+    //a cluster of triangles, stored as a contiguous range of the index buffer; matches Meshlet in meshlet_cull.comp
+    struct Meshlet {
+        //xyz center and w radius in model space
+        glm::vec4 boundingSphere;
+        //xyz axis and w cutoff of the cone around all triangle normals, a cutoff of 1 is never backfacing
+        glm::vec4 cone;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        uint32_t vertexCount;
+        uint32_t padding;
+    };
+
+    struct MeshletStats {
+        uint32_t meshletCount = 0;
+        //average fraction of the vertex and triangle limits a meshlet uses
+        float vertexFill = 0.0f;
+        float triangleFill = 0.0f;
+    };
+
+    //Greedy clustering: a meshlet grows by the adjacent triangle that adds the fewest new vertices, ties going
+    //to the one closest to the meshlet's center, until no neighbour fits the limits; the next meshlet starts at the earliest
+    //unclustered triangle. Reorders the triangles of indices so every meshlet is a contiguous range, the
+    //result only depends on the input so the same mesh always yields the same meshlets.
+    std::vector<Meshlet> buildMeshlets(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+                                       uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+    MeshletStats analyzeMeshlets(const std::vector<Meshlet>& meshlets, uint32_t maxVertices = MESHLET_MAX_VERTICES,
+                                 uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+    //true if no triangle of the meshlet can face cameraPosition, same test as meshlet_cull.comp
+    bool isMeshletBackfacing(const Meshlet& meshlet, const glm::vec3& cameraPosition);
+    //true if the bounding sphere is outside one of the planes (see extractFrustumPlanes)
+    bool isMeshletOutside(const Meshlet& meshlet, const glm::vec4 frustumPlanes[6]);
+
+    //imports path, builds meshlets and prints their fill rates and the fraction of triangles culled from a
+    //ring of camera views around the model
+    void reportMeshlets(const std::string& path, uint32_t importThreads);
+}
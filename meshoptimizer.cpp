@@ -0,0 +1,385 @@
+#include "meshoptimizer.hpp"
+
+#include "objimporter.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+namespace testengine {
+
+    namespace {
+
+        const uint32_t NO_TRIANGLE = UINT32_MAX;
+
+        //Forsyth's tuning constants, the cache size is larger than any real cache on purpose
+        const uint32_t FORSYTH_CACHE_SIZE = 32;
+        const uint32_t FORSYTH_MAX_VALENCE = 32;
+        const float CACHE_DECAY_POWER = 1.5f;
+        const float LAST_TRIANGLE_SCORE = 0.75f;
+        const float VALENCE_BOOST_SCALE = 2.0f;
+        const float VALENCE_BOOST_POWER = 0.5f;
+
+        const uint32_t FETCH_CACHE_LINE_SIZE = 64;
+        const uint32_t FETCH_CACHE_LINES = 256;
+
+        struct ForsythScores {
+            float cache[FORSYTH_CACHE_SIZE];
+            float valence[FORSYTH_MAX_VALENCE + 1];
+
+            ForsythScores() {
+                for (uint32_t i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+                    //the last triangle's vertices get a fixed score so it is not simply repeated
+                    cache[i] = i < 3 ? LAST_TRIANGLE_SCORE
+                                     : std::pow(1.0f - float(i - 3) / float(FORSYTH_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+                }
+                valence[0] = 0.0f;
+                for (uint32_t i = 1; i <= FORSYTH_MAX_VALENCE; i++) {
+                    valence[i] = VALENCE_BOOST_SCALE * std::pow(float(i), -VALENCE_BOOST_POWER);
+                }
+            }
+
+            float vertexScore(int32_t cachePosition, uint32_t remainingTriangles) const {
+                if (remainingTriangles == 0) {
+                    return -1.0f;
+                }
+                float score = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+                return score + valence[std::min(remainingTriangles, FORSYTH_MAX_VALENCE)];
+            }
+        };
+
+        double millisecondsSince(std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize) {
+        VertexCacheStats stats;
+
+        //a vertex stays in a FIFO cache until cacheSize newer vertices were inserted after it
+        std::vector<uint32_t> insertedAt(vertexCount, 0);
+        uint32_t time = cacheSize + 1;
+
+        for (uint32_t index : indices) {
+            if (time - insertedAt[index] > cacheSize) {
+                insertedAt[index] = time++;
+                stats.verticesTransformed++;
+            }
+        }
+
+        size_t triangleCount = indices.size() / 3;
+        stats.acmr = triangleCount > 0 ? float(stats.verticesTransformed) / float(triangleCount) : 0.0f;
+        stats.atvr = vertexCount > 0 ? float(stats.verticesTransformed) / float(vertexCount) : 0.0f;
+        return stats;
+    }
+
+    VertexFetchStats analyzeVertexFetch(const std::vector<uint32_t>& indices, uint32_t vertexCount, size_t vertexSize) {
+        VertexFetchStats stats;
+        std::vector<uint64_t> tags(FETCH_CACHE_LINES, UINT64_MAX);
+
+        for (uint32_t index : indices) {
+            uint64_t firstLine = uint64_t(index) * vertexSize / FETCH_CACHE_LINE_SIZE;
+            uint64_t lastLine = (uint64_t(index + 1) * vertexSize - 1) / FETCH_CACHE_LINE_SIZE;
+
+            for (uint64_t line = firstLine; line <= lastLine; line++) {
+                uint64_t& tag = tags[line % FETCH_CACHE_LINES];
+                if (tag != line) {
+                    tag = line;
+                    stats.bytesFetched += FETCH_CACHE_LINE_SIZE;
+                }
+            }
+        }
+
+        uint64_t vertexBytes = uint64_t(vertexCount) * vertexSize;
+        stats.overfetch = vertexBytes > 0 ? float(double(stats.bytesFetched) / double(vertexBytes)) : 0.0f;
+        return stats;
+    }
+
+    void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount) {
+        static const ForsythScores scores;
+
+        uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+        if (triangleCount == 0) {
+            return;
+        }
+
+        //triangles using each vertex, the first remainingTriangles[v] entries of a vertex are not emitted yet
+        std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+        for (uint32_t index : indices) {
+            remainingTriangles[index]++;
+        }
+
+        std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remainingTriangles[v];
+        }
+
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            for (uint32_t k = 0; k < 3; k++) {
+                adjacency[fill[indices[t * 3 + k]]++] = t;
+            }
+        }
+
+        std::vector<int32_t> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            vertexScores[v] = scores.vertexScore(-1, remainingTriangles[v]);
+        }
+
+        auto triangleScore = [&](uint32_t t) {
+            return vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+        };
+
+        uint32_t bestTriangle = 0;
+        float bestScore = triangleScore(0);
+        for (uint32_t t = 1; t < triangleCount; t++) {
+            float score = triangleScore(t);
+            if (score > bestScore) {
+                bestScore = score;
+                bestTriangle = t;
+            }
+        }
+
+        std::vector<uint32_t> output;
+        output.reserve(indices.size());
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<uint32_t> cache;
+        std::vector<uint32_t> newCache;
+        cache.reserve(FORSYTH_CACHE_SIZE + 3);
+        newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+        uint32_t deadEndCursor = 0;
+
+        for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+            //nothing in the cache has triangles left, continue with the next unemitted triangle in input order
+            if (bestTriangle == NO_TRIANGLE) {
+                while (emitted[deadEndCursor]) {
+                    deadEndCursor++;
+                }
+                bestTriangle = deadEndCursor;
+            }
+
+            uint32_t triangle[3] = {indices[bestTriangle * 3], indices[bestTriangle * 3 + 1], indices[bestTriangle * 3 + 2]};
+            emitted[bestTriangle] = true;
+            output.insert(output.end(), triangle, triangle + 3);
+
+            for (uint32_t v : triangle) {
+                uint32_t* triangles = &adjacency[adjacencyOffsets[v]];
+                uint32_t count = remainingTriangles[v];
+                for (uint32_t i = 0; i < count; i++) {
+                    if (triangles[i] == bestTriangle) {
+                        triangles[i] = triangles[count - 1];
+                        break;
+                    }
+                }
+                remainingTriangles[v]--;
+            }
+
+            //the emitted triangle's vertices move to the front, everything else shifts back by up to three
+            newCache.clear();
+            for (uint32_t v : triangle) {
+                if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) {
+                    newCache.push_back(v);
+                }
+            }
+            for (uint32_t v : cache) {
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                    newCache.push_back(v);
+                }
+            }
+
+            for (size_t i = FORSYTH_CACHE_SIZE; i < newCache.size(); i++) {
+                uint32_t v = newCache[i];
+                cachePosition[v] = -1;
+                vertexScores[v] = scores.vertexScore(-1, remainingTriangles[v]);
+            }
+            newCache.resize(std::min<size_t>(newCache.size(), FORSYTH_CACHE_SIZE));
+
+            for (size_t i = 0; i < newCache.size(); i++) {
+                uint32_t v = newCache[i];
+                cachePosition[v] = static_cast<int32_t>(i);
+                vertexScores[v] = scores.vertexScore(static_cast<int32_t>(i), remainingTriangles[v]);
+            }
+
+            //only triangles touching the cache can have changed score
+            bestTriangle = NO_TRIANGLE;
+            bestScore = -1.0f;
+            for (uint32_t v : newCache) {
+                const uint32_t* triangles = &adjacency[adjacencyOffsets[v]];
+                for (uint32_t i = 0; i < remainingTriangles[v]; i++) {
+                    float score = triangleScore(triangles[i]);
+                    if (score > bestScore) {
+                        bestScore = score;
+                        bestTriangle = triangles[i];
+                    }
+                }
+            }
+
+            cache.swap(newCache);
+        }
+
+        indices.swap(output);
+    }
+
+    void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold) {
+        const uint32_t CACHE_SIZE = 16;
+
+        uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+        uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+        if (triangleCount < 2) {
+            return;
+        }
+
+        //a triangle missing the cache with all three vertices starts a new cluster, moving clusters around
+        //then only costs the misses that happen at their start anyway
+        std::vector<uint32_t> clusterStarts;
+        std::vector<uint32_t> insertedAt(vertexCount, 0);
+        uint32_t time = CACHE_SIZE + 1;
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            uint32_t misses = 0;
+            for (uint32_t k = 0; k < 3; k++) {
+                uint32_t index = indices[t * 3 + k];
+                if (time - insertedAt[index] > CACHE_SIZE) {
+                    insertedAt[index] = time++;
+                    misses++;
+                }
+            }
+            if (misses == 3 || t == 0) {
+                clusterStarts.push_back(t);
+            }
+        }
+        if (clusterStarts.size() < 2) {
+            return;
+        }
+        clusterStarts.push_back(triangleCount);
+
+        struct Cluster {
+            uint32_t firstTriangle;
+            uint32_t triangleCount;
+            float sortKey;
+        };
+
+        //area weighted centroids, the cross product's length is twice the triangle area
+        auto accumulate = [&](uint32_t first, uint32_t last, glm::vec3& centroid, glm::vec3& normal, float& area) {
+            for (uint32_t t = first; t < last; t++) {
+                const glm::vec3& a = vertices[indices[t * 3]].pos;
+                const glm::vec3& b = vertices[indices[t * 3 + 1]].pos;
+                const glm::vec3& c = vertices[indices[t * 3 + 2]].pos;
+                glm::vec3 cross = glm::cross(b - a, c - a);
+                float weight = glm::length(cross);
+                centroid += (a + b + c) * (weight / 3.0f);
+                normal += cross;
+                area += weight;
+            }
+        };
+
+        glm::vec3 meshCentroid(0.0f);
+        glm::vec3 meshNormal(0.0f);
+        float meshArea = 0.0f;
+        accumulate(0, triangleCount, meshCentroid, meshNormal, meshArea);
+        if (meshArea > 0.0f) {
+            meshCentroid /= meshArea;
+        }
+
+        std::vector<Cluster> clusters(clusterStarts.size() - 1);
+        for (size_t i = 0; i < clusters.size(); i++) {
+            glm::vec3 centroid(0.0f);
+            glm::vec3 normal(0.0f);
+            float area = 0.0f;
+            accumulate(clusterStarts[i], clusterStarts[i + 1], centroid, normal, area);
+
+            float normalLength = glm::length(normal);
+            clusters[i].firstTriangle = clusterStarts[i];
+            clusters[i].triangleCount = clusterStarts[i + 1] - clusterStarts[i];
+            //clusters far out along their own normal are likely to occlude the rest of the mesh, draw them first
+            clusters[i].sortKey = (area > 0.0f && normalLength > 0.0f) ? glm::dot(centroid / area - meshCentroid, normal / normalLength) : 0.0f;
+        }
+
+        std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+            return a.sortKey > b.sortKey;
+        });
+
+        std::vector<uint32_t> reordered;
+        reordered.reserve(indices.size());
+        for (const Cluster& cluster : clusters) {
+            auto first = indices.begin() + size_t(cluster.firstTriangle) * 3;
+            reordered.insert(reordered.end(), first, first + size_t(cluster.triangleCount) * 3);
+        }
+
+        float acmrBefore = analyzeVertexCache(indices, vertexCount, CACHE_SIZE).acmr;
+        float acmrAfter = analyzeVertexCache(reordered, vertexCount, CACHE_SIZE).acmr;
+        if (acmrAfter <= acmrBefore * threshold) {
+            indices.swap(reordered);
+        }
+    }
+
+    void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+        std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+        std::vector<Vertex> reordered;
+        reordered.reserve(vertices.size());
+
+        for (uint32_t& index : indices) {
+            if (remap[index] == UINT32_MAX) {
+                remap[index] = static_cast<uint32_t>(reordered.size());
+                reordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+
+        vertices.swap(reordered);
+    }
+
+    void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t flags) {
+        if (flags & MESH_OPTIMIZE_VERTEX_CACHE) {
+            optimizeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+        }
+        if (flags & MESH_OPTIMIZE_OVERDRAW) {
+            optimizeOverdraw(indices, vertices);
+        }
+        if (flags & MESH_OPTIMIZE_VERTEX_FETCH) {
+            optimizeVertexFetch(vertices, indices);
+        }
+    }
+
+    void reportMeshOptimization(const std::string& path, uint32_t importThreads) {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+
+        ObjImporter importer(importThreads);
+        importer.import(path, vertices, indices);
+
+        std::cout << path << ": " << indices.size() / 3 << " triangles, " << vertices.size() << " vertices\n"
+                  << std::fixed << std::setprecision(3)
+                  << "stage           ACMR(16)  ATVR(16)  ACMR(32)  ATVR(32)  overfetch       ms\n";
+
+        auto printStage = [&](const char* name, double ms) {
+            uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+            VertexCacheStats cache16 = analyzeVertexCache(indices, vertexCount, 16);
+            VertexCacheStats cache32 = analyzeVertexCache(indices, vertexCount, 32);
+            VertexFetchStats fetch = analyzeVertexFetch(indices, vertexCount, sizeof(Vertex));
+
+            std::cout << std::left << std::setw(14) << name << std::right
+                      << std::setw(10) << cache16.acmr << std::setw(10) << cache16.atvr
+                      << std::setw(10) << cache32.acmr << std::setw(10) << cache32.atvr
+                      << std::setw(11) << fetch.overfetch << std::setw(9) << std::setprecision(1) << ms
+                      << std::setprecision(3) << '\n';
+        };
+
+        printStage("original", 0.0);
+
+        auto start = std::chrono::steady_clock::now();
+        optimizeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+        printStage("vertex cache", millisecondsSince(start));
+
+        start = std::chrono::steady_clock::now();
+        optimizeOverdraw(indices, vertices);
+        printStage("overdraw", millisecondsSince(start));
+
+        start = std::chrono::steady_clock::now();
+        optimizeVertexFetch(vertices, indices);
+        printStage("vertex fetch", millisecondsSince(start));
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vertex.hpp"
+
+namespace testengine {
+
+    //stages of optimizeMesh(), also stored as the mesh cache import settings so toggling them reimports
+    enum MeshOptimizeFlags : uint32_t {
+        MESH_OPTIMIZE_VERTEX_CACHE = 1,
+        MESH_OPTIMIZE_OVERDRAW = 2,
+        MESH_OPTIMIZE_VERTEX_FETCH = 4,
+        MESH_OPTIMIZE_ALL = MESH_OPTIMIZE_VERTEX_CACHE | MESH_OPTIMIZE_OVERDRAW | MESH_OPTIMIZE_VERTEX_FETCH
+    };
+
+    struct VertexCacheStats {
+        uint32_t verticesTransformed = 0;
+        //average cache miss ratio: transformed vertices per triangle, 0.5 is the ideal for large regular meshes
+        float acmr = 0.0f;
+        //average transform to vertex ratio: transformed vertices per unique vertex, 1.0 is the ideal
+        float atvr = 0.0f;
+    };
+
+    struct VertexFetchStats {
+        uint64_t bytesFetched = 0;
+        //fetched bytes per vertex byte, 1.0 means every cache line of the vertex buffer was fetched exactly once
+        float overfetch = 0.0f;
+    };
+
+    //simulates a FIFO post-transform cache of cacheSize entries
+    VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = 16);
+    //simulates a small direct mapped cache of 64 byte lines in front of the vertex buffer
+    VertexFetchStats analyzeVertexFetch(const std::vector<uint32_t>& indices, uint32_t vertexCount, size_t vertexSize);
+
+    //Forsyth's linear-speed vertex cache optimization, reorders triangles so they reuse recently transformed
+    //vertices; independent of the exact cache size of the GPU
+    void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+    //Sander et al. style overdraw reordering of a cache optimized index buffer: the triangles are split into
+    //clusters at cache flushes and clusters facing outwards are drawn first. The result is only kept if the
+    //ACMR grows by less than threshold (1.05 allows 5% more vertex transforms).
+    void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+    //renumbers vertices in the order the index buffer first references them and drops unreferenced ones
+    void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+    //runs the stages selected by flags (MeshOptimizeFlags) in the order cache, overdraw, fetch
+    void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t flags = MESH_OPTIMIZE_ALL);
+
+    //imports path and prints ACMR/ATVR and fetch statistics after every optimization stage
+    void reportMeshOptimization(const std::string& path, uint32_t importThreads);
+}
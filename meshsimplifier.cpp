@@ -0,0 +1,461 @@
+#include "meshsimplifier.hpp"
+
+#include "meshoptimizer.hpp"
+#include "objimporter.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+
+namespace testengine {
+
+    namespace {
+
+        //levels that keep more than this fraction of the previous level's triangles are not worth a draw
+        const float MIN_LOD_REDUCTION = 0.9f;
+        //a pass only applies collapses no more expensive than the cheapest 1/PASS_CANDIDATE_FRACTION of the candidates
+        const size_t PASS_CANDIDATE_FRACTION = 8;
+
+        //symmetric 4x4 matrix of the summed squared plane distances, plus the summed plane weights
+        struct Quadric {
+            double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+            double a11 = 0, a12 = 0, a13 = 0;
+            double a22 = 0, a23 = 0;
+            double a33 = 0;
+            double weight = 0;
+
+            void addPlane(const glm::vec3& normal, double distance, double planeWeight) {
+                a00 += planeWeight * normal.x * normal.x;
+                a01 += planeWeight * normal.x * normal.y;
+                a02 += planeWeight * normal.x * normal.z;
+                a03 += planeWeight * normal.x * distance;
+                a11 += planeWeight * normal.y * normal.y;
+                a12 += planeWeight * normal.y * normal.z;
+                a13 += planeWeight * normal.y * distance;
+                a22 += planeWeight * normal.z * normal.z;
+                a23 += planeWeight * normal.z * distance;
+                a33 += planeWeight * distance * distance;
+                weight += planeWeight;
+            }
+
+            void add(const Quadric& other) {
+                a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+                a11 += other.a11; a12 += other.a12; a13 += other.a13;
+                a22 += other.a22; a23 += other.a23;
+                a33 += other.a33;
+                weight += other.weight;
+            }
+
+            //weighted mean squared distance of p to the accumulated planes
+            double evaluate(const glm::vec3& p) const {
+                double x = p.x, y = p.y, z = p.z;
+                double sum = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+                           + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+                           + a22 * z * z + 2 * a23 * z
+                           + a33;
+                return weight > 0 ? std::max(sum, 0.0) / weight : 0.0;
+            }
+        };
+
+        enum VertexKind : uint8_t {
+            //interior vertex with one set of attributes, collapses along any edge
+            VERTEX_MANIFOLD,
+            //on an open border, collapses along the border only
+            VERTEX_BORDER,
+            //one of two vertices on an attribute seam, collapses along the seam together with its twin
+            VERTEX_SEAM,
+            //corners, seam junctions and anything non-manifold
+            VERTEX_LOCKED
+        };
+
+        const uint32_t NO_EDGE = UINT32_MAX;
+        const uint32_t MULTIPLE_EDGES = UINT32_MAX - 1;
+
+        //open edges get a plane through the edge perpendicular to the surface, so borders and seams keep their
+        //shape; weighted per squared edge length against the triangle area weights of the surface planes
+        const double OPEN_EDGE_WEIGHT = 10.0;
+
+        struct Collapse {
+            uint32_t from;
+            uint32_t to;
+            double error;
+        };
+
+        struct PositionHash {
+            size_t operator()(const glm::vec3& p) const {
+                uint32_t bits[3];
+                memcpy(bits, &p, sizeof(bits));
+                return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+            }
+        };
+
+        //the topology of the current index buffer, rebuilt after every pass
+        struct Topology {
+            std::vector<VertexKind> kinds;
+            //the single open edge leaving/entering a vertex, NO_EDGE or MULTIPLE_EDGES
+            std::vector<uint32_t> openOut;
+            std::vector<uint32_t> openIn;
+            //the other vertex at the same position, for seam vertices
+            std::vector<uint32_t> twin;
+        };
+
+        glm::vec3 triangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+            return glm::cross(b - a, c - a);
+        }
+
+        //links the vertices sharing a position into circular lists
+        std::vector<uint32_t> buildWedges(const std::vector<Vertex>& vertices) {
+            std::vector<uint32_t> wedges(vertices.size());
+            std::unordered_map<glm::vec3, uint32_t, PositionHash> firstAtPosition;
+            firstAtPosition.reserve(vertices.size());
+
+            for (uint32_t i = 0; i < vertices.size(); i++) {
+                auto [it, inserted] = firstAtPosition.emplace(vertices[i].pos, i);
+                if (inserted) {
+                    wedges[i] = i;
+                } else {
+                    wedges[i] = wedges[it->second];
+                    wedges[it->second] = i;
+                }
+            }
+            return wedges;
+        }
+
+        void buildTopology(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& wedges,
+                           const std::vector<uint32_t>& indices, Topology& topology) {
+            size_t vertexCount = vertices.size();
+            topology.kinds.assign(vertexCount, VERTEX_LOCKED);
+            topology.openOut.assign(vertexCount, NO_EDGE);
+            topology.openIn.assign(vertexCount, NO_EDGE);
+            topology.twin.assign(vertexCount, NO_EDGE);
+
+            std::unordered_map<uint64_t, uint32_t> edges;
+            edges.reserve(indices.size());
+            for (size_t i = 0; i < indices.size(); i += 3) {
+                for (int e = 0; e < 3; e++) {
+                    edges[(uint64_t(indices[i + e]) << 32) | indices[i + (e + 1) % 3]]++;
+                }
+            }
+
+            std::vector<bool> referenced(vertexCount, false);
+            for (const auto& [edge, uses] : edges) {
+                uint32_t a = static_cast<uint32_t>(edge >> 32);
+                uint32_t b = static_cast<uint32_t>(edge & UINT32_MAX);
+                referenced[a] = referenced[b] = true;
+
+                //an edge used twice in one direction is non-manifold, its vertices stay locked below
+                bool open = edges.find((uint64_t(b) << 32) | a) == edges.end();
+                if (open || uses > 1) {
+                    topology.openOut[a] = topology.openOut[a] == NO_EDGE && uses == 1 ? b : MULTIPLE_EDGES;
+                    topology.openIn[b] = topology.openIn[b] == NO_EDGE && uses == 1 ? a : MULTIPLE_EDGES;
+                }
+            }
+
+            auto single = [&](uint32_t v) {
+                return topology.openOut[v] < MULTIPLE_EDGES && topology.openIn[v] < MULTIPLE_EDGES;
+            };
+            auto samePosition = [&](uint32_t a, uint32_t b) {
+                return vertices[a].pos == vertices[b].pos;
+            };
+
+            for (uint32_t v = 0; v < vertexCount; v++) {
+                if (!referenced[v]) {
+                    continue;
+                }
+
+                uint32_t otherCount = 0;
+                uint32_t other = NO_EDGE;
+                for (uint32_t w = wedges[v]; w != v; w = wedges[w]) {
+                    if (referenced[w]) {
+                        otherCount++;
+                        other = w;
+                    }
+                }
+
+                if (otherCount == 0) {
+                    if (topology.openOut[v] == NO_EDGE && topology.openIn[v] == NO_EDGE) {
+                        topology.kinds[v] = VERTEX_MANIFOLD;
+                    } else if (single(v)) {
+                        topology.kinds[v] = VERTEX_BORDER;
+                    }
+                } else if (otherCount == 1 && single(v) && single(other) &&
+                           samePosition(topology.openOut[v], topology.openIn[other]) &&
+                           samePosition(topology.openIn[v], topology.openOut[other])) {
+                    //the two sides of the seam run in opposite directions
+                    topology.kinds[v] = VERTEX_SEAM;
+                    topology.twin[v] = other;
+                }
+            }
+        }
+
+        void addOpenEdgeQuadrics(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                 const Topology& topology, std::vector<Quadric>& quadrics) {
+            for (size_t i = 0; i < indices.size(); i += 3) {
+                for (int e = 0; e < 3; e++) {
+                    uint32_t a = indices[i + e];
+                    uint32_t b = indices[i + (e + 1) % 3];
+                    if (topology.openOut[a] != b) {
+                        continue;
+                    }
+
+                    const glm::vec3& pa = vertices[a].pos;
+                    const glm::vec3& pb = vertices[b].pos;
+                    glm::vec3 edge = pb - pa;
+                    glm::vec3 normal = glm::cross(edge, triangleNormal(pa, pb, vertices[indices[i + (e + 2) % 3]].pos));
+                    float length = glm::length(normal);
+                    if (length == 0.0f) {
+                        continue;
+                    }
+                    normal /= length;
+
+                    double distance = -glm::dot(normal, pa);
+                    double weight = OPEN_EDGE_WEIGHT * glm::dot(edge, edge);
+                    quadrics[a].addPlane(normal, distance, weight);
+                    quadrics[b].addPlane(normal, distance, weight);
+                }
+            }
+        }
+
+        //borders and seams may only move along themselves
+        bool canCollapse(const Topology& topology, uint32_t from, uint32_t to) {
+            switch (topology.kinds[from]) {
+                case VERTEX_MANIFOLD:
+                    return true;
+                case VERTEX_BORDER:
+                case VERTEX_SEAM:
+                    return topology.openOut[from] == to || topology.openIn[from] == to;
+                default:
+                    return false;
+            }
+        }
+
+        //the vertex a seam vertex's twin collapses onto when the seam vertex collapses onto to
+        uint32_t twinTarget(const Topology& topology, uint32_t from, uint32_t to) {
+            uint32_t twin = topology.twin[from];
+            return topology.openOut[from] == to ? topology.openIn[twin] : topology.openOut[twin];
+        }
+
+        double millisecondsSince(std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    std::vector<uint32_t> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                       size_t targetIndexCount, float& error) {
+        std::vector<uint32_t> result = indices;
+        uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+        double maxError = 0.0;
+
+        std::vector<uint32_t> wedges = buildWedges(vertices);
+        Topology topology;
+        buildTopology(vertices, wedges, result, topology);
+
+        //area weighted planes of the adjacent triangles
+        std::vector<Quadric> quadrics(vertexCount);
+        for (size_t i = 0; i < result.size(); i += 3) {
+            const glm::vec3& a = vertices[result[i]].pos;
+            glm::vec3 normal = triangleNormal(a, vertices[result[i + 1]].pos, vertices[result[i + 2]].pos);
+            float length = glm::length(normal);
+            if (length == 0.0f) {
+                continue;
+            }
+            normal /= length;
+            double distance = -glm::dot(normal, a);
+            for (int corner = 0; corner < 3; corner++) {
+                quadrics[result[i + corner]].addPlane(normal, distance, length * 0.5);
+            }
+        }
+        addOpenEdgeQuadrics(vertices, result, topology, quadrics);
+
+        std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+        std::vector<uint32_t> adjacentTriangles;
+        std::vector<Collapse> collapses;
+        std::vector<uint32_t> collapseTarget(vertexCount);
+        std::vector<bool> touched(vertexCount);
+
+        //reject collapses that flip a remaining triangle or reach into an area changed this pass
+        auto validCollapse = [&](uint32_t from, uint32_t to) {
+            for (uint32_t t = triangleOffsets[from]; t < triangleOffsets[from + 1]; t++) {
+                const uint32_t* triangle = &result[adjacentTriangles[t] * 3];
+                if (touched[triangle[0]] || touched[triangle[1]] || touched[triangle[2]]) {
+                    return false;
+                }
+                if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+                    continue;
+                }
+
+                glm::vec3 before[3];
+                glm::vec3 after[3];
+                for (int corner = 0; corner < 3; corner++) {
+                    before[corner] = vertices[triangle[corner]].pos;
+                    after[corner] = triangle[corner] == from ? vertices[to].pos : before[corner];
+                }
+                if (glm::dot(triangleNormal(before[0], before[1], before[2]), triangleNormal(after[0], after[1], after[2])) <= 0.0f) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        auto applyCollapse = [&](uint32_t from, uint32_t to) {
+            for (uint32_t t = triangleOffsets[from]; t < triangleOffsets[from + 1]; t++) {
+                const uint32_t* triangle = &result[adjacentTriangles[t] * 3];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+            }
+            collapseTarget[from] = to;
+            quadrics[to].add(quadrics[from]);
+        };
+
+        //every pass applies the cheapest collapses whose neighbourhoods do not overlap, then rebuilds
+        while (result.size() > targetIndexCount) {
+            size_t triangleCount = result.size() / 3;
+
+            std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+            for (uint32_t index : result) {
+                triangleOffsets[index + 1]++;
+            }
+            for (uint32_t i = 0; i < vertexCount; i++) {
+                triangleOffsets[i + 1] += triangleOffsets[i];
+            }
+            adjacentTriangles.resize(result.size());
+            std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for (size_t i = 0; i < result.size(); i++) {
+                adjacentTriangles[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+
+            collapses.clear();
+            for (size_t i = 0; i < result.size(); i += 3) {
+                for (int e = 0; e < 6; e++) {
+                    uint32_t from = result[i + e % 3];
+                    uint32_t to = result[i + (e < 3 ? (e + 1) % 3 : (e + 2) % 3)];
+                    if (!canCollapse(topology, from, to)) {
+                        continue;
+                    }
+
+                    double collapseError = quadrics[from].evaluate(vertices[to].pos);
+                    if (topology.kinds[from] == VERTEX_SEAM) {
+                        uint32_t twin = topology.twin[from];
+                        collapseError = std::max(collapseError, quadrics[twin].evaluate(vertices[twinTarget(topology, from, to)].pos));
+                    }
+                    collapses.push_back({from, to, collapseError});
+                }
+            }
+            if (collapses.empty()) {
+                break;
+            }
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+            //a collapse removes two triangles of a closed surface
+            size_t collapseLimit = (triangleCount - targetIndexCount / 3) / 2 + 1;
+            size_t collapseCount = 0;
+            //expensive collapses wait for a later pass, where the cheap ones around them may have made them cheaper
+            double errorLimit = collapses[collapses.size() / PASS_CANDIDATE_FRACTION].error;
+
+            for (uint32_t i = 0; i < vertexCount; i++) {
+                collapseTarget[i] = i;
+            }
+            std::fill(touched.begin(), touched.end(), false);
+
+            for (const Collapse& collapse : collapses) {
+                if (collapseCount >= collapseLimit || (collapse.error > errorLimit && collapseCount > 0)) {
+                    break;
+                }
+                if (touched[collapse.from] || touched[collapse.to] || !validCollapse(collapse.from, collapse.to)) {
+                    continue;
+                }
+
+                if (topology.kinds[collapse.from] == VERTEX_SEAM) {
+                    uint32_t twin = topology.twin[collapse.from];
+                    uint32_t target = twinTarget(topology, collapse.from, collapse.to);
+                    if (touched[twin] || touched[target] || !validCollapse(twin, target)) {
+                        continue;
+                    }
+                    applyCollapse(twin, target);
+                }
+                applyCollapse(collapse.from, collapse.to);
+
+                maxError = std::max(maxError, collapse.error);
+                collapseCount++;
+            }
+
+            if (collapseCount == 0) {
+                break;
+            }
+
+            //remap and drop the triangles that collapsed to a line
+            size_t write = 0;
+            for (size_t i = 0; i < result.size(); i += 3) {
+                uint32_t a = collapseTarget[result[i]];
+                uint32_t b = collapseTarget[result[i + 1]];
+                uint32_t c = collapseTarget[result[i + 2]];
+                if (a != b && b != c && a != c) {
+                    result[write++] = a;
+                    result[write++] = b;
+                    result[write++] = c;
+                }
+            }
+            result.resize(write);
+
+            buildTopology(vertices, wedges, result, topology);
+        }
+
+        error = static_cast<float>(std::sqrt(maxError));
+        return result;
+    }
+
+    std::vector<MeshLod> generateLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t levelCount) {
+        std::vector<MeshLod> lods;
+        lods.push_back({0, static_cast<uint32_t>(indices.size()), 0.0f});
+
+        std::vector<uint32_t> source(indices);
+        float error = 0.0f;
+
+        for (uint32_t level = 1; level < std::min(levelCount, MAX_MESH_LODS); level++) {
+            size_t targetIndexCount = source.size() / 6 * 3;
+            if (targetIndexCount == 0) {
+                break;
+            }
+
+            float levelError = 0.0f;
+            std::vector<uint32_t> levelIndices = simplifyMesh(vertices, source, targetIndexCount, levelError);
+            if (levelIndices.size() > source.size() * MIN_LOD_REDUCTION) {
+                break;
+            }
+
+            //every level is simplified from the previous one, so the errors add up
+            error += levelError;
+            optimizeVertexCache(levelIndices, static_cast<uint32_t>(vertices.size()));
+
+            lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(levelIndices.size()), error});
+            indices.insert(indices.end(), levelIndices.begin(), levelIndices.end());
+            source.swap(levelIndices);
+        }
+
+        return lods;
+    }
+
+    void reportMeshLods(const std::string& path, uint32_t importThreads, uint32_t levelCount) {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+
+        ObjImporter importer(importThreads);
+        importer.import(path, vertices, indices);
+        optimizeMesh(vertices, indices);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<MeshLod> lods = generateLods(vertices, indices, levelCount);
+        double ms = millisecondsSince(start);
+
+        std::cout << path << ": " << lods.size() << " levels built in " << std::fixed << std::setprecision(1) << ms << " ms\n"
+                  << "level  triangles   ratio      error\n";
+        for (size_t i = 0; i < lods.size(); i++) {
+            std::cout << std::setw(5) << i << std::setw(11) << lods[i].indexCount / 3
+                      << std::setw(8) << std::setprecision(3) << float(lods[i].indexCount) / float(lods[0].indexCount)
+                      << std::setw(11) << std::setprecision(5) << lods[i].error << '\n';
+        }
+    }
+}
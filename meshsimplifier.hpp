@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vertex.hpp"
+
+namespace testengine {
+
+    const uint32_t MAX_MESH_LODS = 8;
+
+    //one level of detail, a range of the mesh's index buffer drawn with the mesh's vertices
+    struct MeshLod {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        //estimated distance between this level and the full resolution surface, in model units
+        float error;
+    };
+
+    //Quadric error edge collapse (Garland/Heckbert) restricted to collapses onto existing vertices, so the
+    //result is an index buffer into the unchanged vertices and every level can share one vertex buffer.
+    //Vertices on open borders only slide along the border and the two vertices of an attribute seam collapse
+    //together along the seam, so neither cracks nor texture seams open up; corners and junctions never move.
+    //Stops at targetIndexCount or when no collapse is left; error receives the largest collapse error.
+    std::vector<uint32_t> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                       size_t targetIndexCount, float& error);
+
+    //appends up to levelCount - 1 simplified levels, each about half the triangles of the previous one, to
+    //indices and returns the whole chain with the original indices as level 0. Stops early when a level
+    //would not remove at least 10% of the triangles.
+    std::vector<MeshLod> generateLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t levelCount);
+
+    //imports path and prints the triangle count, error and build time of every level
+    void reportMeshLods(const std::string& path, uint32_t importThreads, uint32_t levelCount);
+}
@@ -0,0 +1,484 @@
+#include "objimporter.hpp"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+#include "utils.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace testengine {
+
+    namespace {
+
+        double millisecondsSince(std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        bool isSpace(char c) {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        const char* skipSpaces(const char* p, const char* end) {
+            while (p < end && isSpace(*p)) {
+                p++;
+            }
+            return p;
+        }
+
+        const char* findLineEnd(const char* p, const char* end) {
+            const void* newline = memchr(p, '\n', static_cast<size_t>(end - p));
+            return newline != nullptr ? static_cast<const char*>(newline) : end;
+        }
+
+        //true if the line starts with keyword followed by whitespace
+        bool hasKeyword(const char* p, const char* end, const char* keyword, size_t length) {
+            return static_cast<size_t>(end - p) > length && memcmp(p, keyword, length) == 0 && isSpace(p[length]);
+        }
+
+        //parsed as double and narrowed like tinyobjloader does, missing components read as 0
+        float parseFloat(const char*& p, const char* end) {
+            p = skipSpaces(p, end);
+            if (p < end && *p == '+') {
+                p++;
+            }
+
+            double value = 0.0;
+            auto result = std::from_chars(p, end, value);
+            if (result.ec != std::errc()) {
+                return 0.0f;
+            }
+            p = result.ptr;
+            return static_cast<float>(value);
+        }
+
+        bool parseIndex(const char*& p, const char* end, int64_t& value) {
+            auto result = std::from_chars(p, end, value);
+            if (result.ec != std::errc()) {
+                return false;
+            }
+            p = result.ptr;
+            return true;
+        }
+
+        //OBJ indices are 1-based, negative indices are relative to the elements defined so far
+        uint32_t resolveIndex(int64_t index, uint32_t definedCount) {
+            if (index > 0) {
+                return static_cast<uint32_t>(index - 1);
+            }
+            if (index < 0 && -index <= static_cast<int64_t>(definedCount)) {
+                return static_cast<uint32_t>(static_cast<int64_t>(definedCount) + index);
+            }
+            throw std::runtime_error("Runtime error: invalid OBJ face index.");
+        }
+
+        size_t hashVertex(const Vertex& vertex) {
+            return std::hash<Vertex>()(vertex);
+        }
+    }
+
+    ObjImporter::ObjImporter(uint32_t threadCount) : threadCount(threadCount) {
+        if (this->threadCount == 0) {
+            this->threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+    }
+
+    void ObjImporter::import(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+        utils::MappedFile file;
+        if (!file.open(path)) {
+            throw std::runtime_error("Runtime error: failed to open model " + path + ".");
+        }
+
+        timings = {};
+        auto phaseStart = std::chrono::steady_clock::now();
+
+        const char* begin = reinterpret_cast<const char*>(file.data());
+        const char* end = begin + file.size();
+
+        //split at line boundaries, small files get fewer chunks than threads
+        size_t chunkCount = std::min<size_t>(threadCount, std::max<size_t>(1, file.size() / MIN_CHUNK_SIZE));
+        std::vector<Chunk> chunks(chunkCount);
+        const char* chunkBegin = begin;
+        for (size_t i = 0; i < chunkCount; i++) {
+            const char* chunkEnd = end;
+            if (i + 1 < chunkCount) {
+                const char* lineEnd = findLineEnd(std::max(chunkBegin, begin + file.size() * (i + 1) / chunkCount), end);
+                chunkEnd = lineEnd < end ? lineEnd + 1 : end;
+            }
+            chunks[i].begin = chunkBegin;
+            chunks[i].end = chunkEnd;
+            chunkBegin = chunkEnd;
+        }
+        uint32_t workers = static_cast<uint32_t>(chunkCount);
+
+        //the first pass only counts v/vt lines, so every chunk knows where its elements land in the shared
+        //arrays and can resolve relative indices while parsing
+        utils::parallelFor(workers, [&](uint32_t i) { countElements(chunks[i]); });
+
+        uint32_t positionCount = 0;
+        uint32_t texCoordCount = 0;
+        for (auto& chunk : chunks) {
+            chunk.positionBase = positionCount;
+            chunk.texCoordBase = texCoordCount;
+            positionCount += chunk.positionCount;
+            texCoordCount += chunk.texCoordCount;
+        }
+
+        std::vector<float> positions(static_cast<size_t>(positionCount) * 3);
+        std::vector<float> texCoords(static_cast<size_t>(texCoordCount) * 2);
+        utils::parallelFor(workers, [&](uint32_t i) { parseChunk(chunks[i], positions, texCoords); });
+
+        timings.parseMs = millisecondsSince(phaseStart);
+        phaseStart = std::chrono::steady_clock::now();
+
+        utils::parallelFor(workers, [&](uint32_t i) { dedupChunk(chunks[i], positions, texCoords); });
+
+        timings.dedupMs = millisecondsSince(phaseStart);
+        phaseStart = std::chrono::steady_clock::now();
+
+        //every shard owns the vertices whose hash falls into it and walks the partial tables in chunk order,
+        //so the first entry it sees for a vertex is its first occurrence in the file
+        //a single chunk's table is already the final one
+        if (workers == 1) {
+            std::fill(chunks[0].firstOccurrence.begin(), chunks[0].firstOccurrence.end(), 1);
+        } else {
+            utils::parallelFor(workers, [&](uint32_t shard) {
+                size_t shardUniqueCount = 0;
+                for (const auto& chunk : chunks) {
+                    shardUniqueCount += chunk.uniqueVertices.size();
+                }
+
+                std::unordered_map<Vertex, uint64_t> owners;
+                owners.reserve(shardUniqueCount / workers + 1);
+
+                for (size_t c = 0; c < chunks.size(); c++) {
+                    Chunk& chunk = chunks[c];
+                    for (size_t i = 0; i < chunk.uniqueVertices.size(); i++) {
+                        if ((chunk.uniqueHashes[i] >> 32) % workers != shard) {
+                            continue;
+                        }
+
+                        auto [entry, inserted] = owners.try_emplace(chunk.uniqueVertices[i], (static_cast<uint64_t>(c) << 32) | i);
+                        chunk.firstOccurrence[i] = inserted;
+                        chunk.owner[i] = entry->second;
+                    }
+                }
+            });
+        }
+
+        size_t vertexCount = 0;
+        size_t indexCount = 0;
+        std::vector<size_t> vertexBases(chunkCount);
+        for (size_t c = 0; c < chunkCount; c++) {
+            vertexBases[c] = vertexCount;
+            vertexCount += std::count(chunks[c].firstOccurrence.begin(), chunks[c].firstOccurrence.end(), 1);
+            chunks[c].indexOffset = indexCount;
+            indexCount += chunks[c].localIndices.size();
+        }
+
+        vertices.resize(vertexCount);
+        indices.resize(indexCount);
+
+        utils::parallelFor(workers, [&](uint32_t c) {
+            Chunk& chunk = chunks[c];
+            size_t next = vertexBases[c];
+            for (size_t i = 0; i < chunk.uniqueVertices.size(); i++) {
+                if (chunk.firstOccurrence[i]) {
+                    chunk.remap[i] = static_cast<uint32_t>(next);
+                    vertices[next++] = chunk.uniqueVertices[i];
+                }
+            }
+        });
+
+        //first occurrences all have their final index now, duplicates take their owner's
+        utils::parallelFor(workers, [&](uint32_t c) {
+            Chunk& chunk = chunks[c];
+            for (size_t i = 0; i < chunk.uniqueVertices.size(); i++) {
+                if (!chunk.firstOccurrence[i]) {
+                    const Chunk& ownerChunk = chunks[chunk.owner[i] >> 32];
+                    chunk.remap[i] = ownerChunk.remap[chunk.owner[i] & 0xFFFFFFFFu];
+                }
+            }
+
+            uint32_t* output = indices.data() + chunk.indexOffset;
+            for (size_t i = 0; i < chunk.localIndices.size(); i++) {
+                output[i] = chunk.remap[chunk.localIndices[i]];
+            }
+        });
+
+        timings.mergeMs = millisecondsSince(phaseStart);
+    }
+
+    void ObjImporter::countElements(Chunk& chunk) {
+        for (const char* line = chunk.begin; line < chunk.end;) {
+            const char* lineEnd = findLineEnd(line, chunk.end);
+            const char* p = skipSpaces(line, lineEnd);
+
+            if (hasKeyword(p, lineEnd, "v", 1)) {
+                chunk.positionCount++;
+            } else if (hasKeyword(p, lineEnd, "vt", 2)) {
+                chunk.texCoordCount++;
+            }
+
+            line = lineEnd + 1;
+        }
+    }
+
+    void ObjImporter::parseChunk(Chunk& chunk, std::vector<float>& positions, std::vector<float>& texCoords) {
+        float* positionOutput = positions.data() + static_cast<size_t>(chunk.positionBase) * 3;
+        float* texCoordOutput = texCoords.data() + static_cast<size_t>(chunk.texCoordBase) * 2;
+        uint32_t positionTotal = static_cast<uint32_t>(positions.size() / 3);
+        uint32_t texCoordTotal = static_cast<uint32_t>(texCoords.size() / 2);
+        uint32_t positionsDefined = chunk.positionBase;
+        uint32_t texCoordsDefined = chunk.texCoordBase;
+
+        std::vector<Corner> face;
+
+        for (const char* line = chunk.begin; line < chunk.end;) {
+            const char* lineEnd = findLineEnd(line, chunk.end);
+            const char* p = skipSpaces(line, lineEnd);
+
+            if (hasKeyword(p, lineEnd, "v", 1)) {
+                p += 1;
+                *positionOutput++ = parseFloat(p, lineEnd);
+                *positionOutput++ = parseFloat(p, lineEnd);
+                *positionOutput++ = parseFloat(p, lineEnd);
+                positionsDefined++;
+            } else if (hasKeyword(p, lineEnd, "vt", 2)) {
+                p += 2;
+                *texCoordOutput++ = parseFloat(p, lineEnd);
+                *texCoordOutput++ = parseFloat(p, lineEnd);
+                texCoordsDefined++;
+            } else if (hasKeyword(p, lineEnd, "f", 1)) {
+                p += 1;
+                face.clear();
+
+                //v, v/vt, v//vn or v/vt/vn
+                while ((p = skipSpaces(p, lineEnd)) < lineEnd) {
+                    int64_t index;
+                    if (!parseIndex(p, lineEnd, index)) {
+                        throw std::runtime_error("Runtime error: malformed OBJ face.");
+                    }
+
+                    Corner corner{resolveIndex(index, positionsDefined), NO_TEXCOORD};
+                    if (p < lineEnd && *p == '/') {
+                        p++;
+                        if (p < lineEnd && *p != '/') {
+                            if (!parseIndex(p, lineEnd, index)) {
+                                throw std::runtime_error("Runtime error: malformed OBJ face.");
+                            }
+                            corner.texCoord = resolveIndex(index, texCoordsDefined);
+                        }
+                        if (p < lineEnd && *p == '/') {
+                            p++;
+                            parseIndex(p, lineEnd, index);
+                        }
+                    }
+
+                    if (corner.position >= positionTotal || (corner.texCoord != NO_TEXCOORD && corner.texCoord >= texCoordTotal)) {
+                        throw std::runtime_error("Runtime error: OBJ face index out of range.");
+                    }
+                    face.push_back(corner);
+                }
+
+                for (size_t k = 2; k < face.size(); k++) {
+                    chunk.corners.push_back(face[0]);
+                    chunk.corners.push_back(face[k - 1]);
+                    chunk.corners.push_back(face[k]);
+                }
+            }
+
+            line = lineEnd + 1;
+        }
+    }
+
+    void ObjImporter::dedupChunk(Chunk& chunk, const std::vector<float>& positions, const std::vector<float>& texCoords) {
+        std::unordered_map<Vertex, uint32_t> uniqueVertices;
+        uniqueVertices.reserve(chunk.corners.size() / 4 + 1);
+        chunk.localIndices.reserve(chunk.corners.size());
+
+        for (const auto& corner : chunk.corners) {
+            Vertex vertex{};
+
+            const float* position = &positions[static_cast<size_t>(corner.position) * 3];
+            vertex.pos = {position[0], position[1], position[2]};
+            if (corner.texCoord != NO_TEXCOORD) {
+                const float* texCoord = &texCoords[static_cast<size_t>(corner.texCoord) * 2];
+                vertex.texCoord = {texCoord[0], 1.0f - texCoord[1]};
+            } else {
+                vertex.texCoord = {0.0f, 1.0f};
+            }
+            vertex.color = {1.0f, 1.0f, 1.0f};
+
+            auto [entry, inserted] = uniqueVertices.try_emplace(vertex, static_cast<uint32_t>(chunk.uniqueVertices.size()));
+            if (inserted) {
+                chunk.uniqueVertices.push_back(vertex);
+                chunk.uniqueHashes.push_back(hashVertex(vertex));
+            }
+            chunk.localIndices.push_back(entry->second);
+        }
+
+        chunk.corners.clear();
+        chunk.corners.shrink_to_fit();
+
+        chunk.firstOccurrence.resize(chunk.uniqueVertices.size());
+        chunk.owner.resize(chunk.uniqueVertices.size());
+        chunk.remap.resize(chunk.uniqueVertices.size());
+    }
+
+    void ObjImporter::importReference(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn, err;
+
+        std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())) {
+            throw std::runtime_error(warn + err);
+        }
+
+        for (const auto& shape : shapes) {
+            for (const auto& index : shape.mesh.indices) {
+                Vertex vertex{};
+
+                vertex.pos = {
+                    attrib.vertices[3 * index.vertex_index + 0],
+                    attrib.vertices[3 * index.vertex_index + 1],
+                    attrib.vertices[3 * index.vertex_index + 2]
+                };
+                vertex.texCoord = {
+                    attrib.texcoords[2 * index.texcoord_index + 0],
+                    1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+                };
+                vertex.color = {1.0f, 1.0f, 1.0f};
+
+                if (uniqueVertices.count(vertex) == 0) {
+                    uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+                    vertices.push_back(vertex);
+                }
+                indices.push_back(uniqueVertices[vertex]);
+            }
+        }
+    }
+
+    void benchmarkObjImport(const std::string& path, uint32_t maxThreads) {
+        const int RUNS = 3;
+
+        if (maxThreads == 0) {
+            maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        std::vector<Vertex> referenceVertices;
+        std::vector<uint32_t> referenceIndices;
+        auto referenceStart = std::chrono::steady_clock::now();
+        ObjImporter::importReference(path, referenceVertices, referenceIndices);
+        double referenceMs = millisecondsSince(referenceStart);
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << path << ": " << referenceIndices.size() / 3 << " triangles, " << referenceVertices.size() << " unique vertices\n"
+                  << "reference (tinyobjloader): " << referenceMs << " ms\n";
+
+        double singleThreadMs = 0.0;
+        for (uint32_t threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+            ObjImporter importer(threads);
+            ObjImportTimings best{};
+            double bestMs = 0.0;
+            bool identical = true;
+
+            for (int run = 0; run < RUNS; run++) {
+                std::vector<Vertex> vertices;
+                std::vector<uint32_t> indices;
+
+                auto start = std::chrono::steady_clock::now();
+                importer.import(path, vertices, indices);
+                double ms = millisecondsSince(start);
+
+                if (run == 0 || ms < bestMs) {
+                    bestMs = ms;
+                    best = importer.getTimings();
+                }
+                identical = identical && vertices == referenceVertices && indices == referenceIndices;
+            }
+
+            if (threads == 1) {
+                singleThreadMs = bestMs;
+            }
+
+            std::cout << "threads " << std::setw(3) << threads << ": " << std::setw(8) << bestMs << " ms"
+                      << " (parse " << best.parseMs << ", dedup " << best.dedupMs << ", merge " << best.mergeMs << ")"
+                      << std::setprecision(2)
+                      << "  x" << singleThreadMs / bestMs << " vs 1 thread, x" << referenceMs / bestMs << " vs reference"
+                      << std::setprecision(1)
+                      << (identical ? "" : "  OUTPUT DIFFERS FROM REFERENCE") << '\n';
+
+            if (threads == maxThreads) {
+                break;
+            }
+        }
+    }
+
+    void writeBenchmarkObj(const std::string& path, uint64_t triangleCount) {
+        uint64_t side = static_cast<uint64_t>(std::ceil(std::sqrt(static_cast<double>(std::max<uint64_t>(triangleCount, 2)) / 2.0)));
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("Runtime error: failed to write " + path + ".");
+        }
+
+        std::string buffer;
+        char line[128];
+        auto flush = [&]() {
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        };
+
+        buffer += "# benchmark grid, " + std::to_string(side * side * 2) + " triangles\n";
+
+        for (uint64_t y = 0; y <= side; y++) {
+            for (uint64_t x = 0; x <= side; x++) {
+                float u = static_cast<float>(x) / side;
+                float v = static_cast<float>(y) / side;
+                float height = 0.05f * std::sin(u * 40.0f) * std::cos(v * 40.0f);
+                buffer.append(line, snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", u - 0.5f, v - 0.5f, height));
+            }
+            flush();
+        }
+
+        for (uint64_t y = 0; y <= side; y++) {
+            for (uint64_t x = 0; x <= side; x++) {
+                buffer.append(line, snprintf(line, sizeof(line), "vt %.6f %.6f\n",
+                                             static_cast<float>(x) / side, static_cast<float>(y) / side));
+            }
+            flush();
+        }
+
+        for (uint64_t y = 0; y < side; y++) {
+            for (uint64_t x = 0; x < side; x++) {
+                uint64_t a = y * (side + 1) + x + 1;
+                uint64_t b = a + 1;
+                uint64_t c = a + side + 1;
+                uint64_t d = c + 1;
+                buffer.append(line, snprintf(line, sizeof(line), "f %llu/%llu %llu/%llu %llu/%llu\nf %llu/%llu %llu/%llu %llu/%llu\n",
+                    (unsigned long long)a, (unsigned long long)a, (unsigned long long)b, (unsigned long long)b,
+                    (unsigned long long)d, (unsigned long long)d, (unsigned long long)a, (unsigned long long)a,
+                    (unsigned long long)d, (unsigned long long)d, (unsigned long long)c, (unsigned long long)c));
+            }
+            flush();
+        }
+
+        if (!out) {
+            throw std::runtime_error("Runtime error: failed to write " + path + ".");
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vertex.hpp"
+
+namespace testengine {
+
+    struct ObjImportTimings {
+        double parseMs = 0.0;
+        double dedupMs = 0.0;
+        double mergeMs = 0.0;
+    };
+
+    //Multi-threaded Wavefront OBJ importer. The memory mapped file is split into line aligned chunks that are
+    //parsed and deduplicated in parallel, each thread into its own partial vertex table. The partial tables are
+    //then merged by hash shard, and final indices are assigned in first-seen order, so the output is identical
+    //to a single-threaded import regardless of the thread count.
+    //Only positions and texture coordinates are imported, polygons are triangulated as fans.
+    class ObjImporter {
+        public:
+            //0 uses one thread per hardware thread
+            explicit ObjImporter(uint32_t threadCount = 0);
+
+            void import(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+            //the original tinyobjloader based import, kept as the reference for the benchmark
+            static void importReference(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+            uint32_t getThreadCount() const { return threadCount; }
+            const ObjImportTimings& getTimings() const { return timings; }
+
+        private:
+            //files smaller than this per thread are not worth splitting further
+            static constexpr size_t MIN_CHUNK_SIZE = 256 * 1024;
+            static constexpr uint32_t NO_TEXCOORD = UINT32_MAX;
+
+            struct Corner {
+                uint32_t position;
+                uint32_t texCoord;
+            };
+
+            struct Chunk {
+                const char* begin;
+                const char* end;
+
+                uint32_t positionCount = 0;
+                uint32_t texCoordCount = 0;
+                uint32_t positionBase = 0;
+                uint32_t texCoordBase = 0;
+
+                std::vector<Corner> corners;
+
+                //partial dedup table of this chunk, in first-seen order
+                std::vector<Vertex> uniqueVertices;
+                std::vector<size_t> uniqueHashes;
+                std::vector<uint32_t> localIndices;
+
+                //per unique vertex: set if this is the first occurrence in the whole file, otherwise the packed
+                //chunk/local index of the first occurrence
+                std::vector<uint8_t> firstOccurrence;
+                std::vector<uint64_t> owner;
+                std::vector<uint32_t> remap;
+                size_t indexOffset = 0;
+            };
+
+            uint32_t threadCount;
+            ObjImportTimings timings;
+
+            static void countElements(Chunk& chunk);
+            static void parseChunk(Chunk& chunk, std::vector<float>& positions, std::vector<float>& texCoords);
+            static void dedupChunk(Chunk& chunk, const std::vector<float>& positions, const std::vector<float>& texCoords);
+    };
+
+    //imports path with the reference loader and with 1..maxThreads threads, and prints timings and speedups
+    void benchmarkObjImport(const std::string& path, uint32_t maxThreads);
+
+    //writes a textured, gently displaced grid mesh with at least triangleCount triangles for import benchmarks
+    void writeBenchmarkObj(const std::string& path, uint64_t triangleCount);
+}
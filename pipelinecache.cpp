@@ -0,0 +1,139 @@
+#include "pipelinecache.hpp"
+
+#include "utils.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace testengine {
+
+    PipelineCache::PipelineCache(std::string path) : path(std::move(path)) {}
+
+    void PipelineCache::load(VkPhysicalDevice physicalDevice, VkDevice device) {
+        this->device = device;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        utils::MappedFile file;
+        const uint8_t* initialData = nullptr;
+        size_t initialSize = 0;
+
+        if (file.open(path)) {
+            const char* reason = nullptr;
+            if (validate(file.data(), file.size(), reason)) {
+                initialData = file.data() + sizeof(Header);
+                initialSize = file.size() - sizeof(Header);
+            } else {
+                std::cout << "Ignoring pipeline cache " << path << ": " << reason << '\n';
+            }
+        }
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = initialSize;
+        cacheInfo.pInitialData = initialData;
+
+        warm = initialData != nullptr;
+        if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) != VK_SUCCESS) {
+            //drivers may still reject data that passed our checks, fall back to an empty cache
+            cacheInfo.initialDataSize = 0;
+            cacheInfo.pInitialData = nullptr;
+            warm = false;
+            if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) != VK_SUCCESS) {
+                throw std::runtime_error("Runtime error: failed to create pipeline cache.");
+            }
+        }
+    }
+
+    void PipelineCache::save() {
+        size_t dataSize = 0;
+        if (vkGetPipelineCacheData(device, cache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+            return;
+        }
+
+        std::vector<uint8_t> data(dataSize);
+        if (vkGetPipelineCacheData(device, cache, &dataSize, data.data()) != VK_SUCCESS) {
+            return;
+        }
+
+        Header header{};
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.dataSize = dataSize;
+        header.dataHash = utils::fnv1a64(data.data(), dataSize);
+
+        std::error_code error;
+        std::filesystem::path parent = std::filesystem::path(path).parent_path();
+        if (!parent.empty()) {
+            std::filesystem::create_directories(parent, error);
+        }
+
+        //write to a temporary file and rename it, a torn file would otherwise be rejected on every start
+        std::string temporaryPath = path + ".tmp";
+        {
+            std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(dataSize));
+            if (!out) {
+                std::cerr << "Warning: failed to write pipeline cache " << temporaryPath << '\n';
+                return;
+            }
+        }
+
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error) {
+            std::cerr << "Warning: failed to write pipeline cache " << path << ": " << error.message() << '\n';
+        }
+    }
+
+    void PipelineCache::destroy() {
+        if (cache != VK_NULL_HANDLE) {
+            vkDestroyPipelineCache(device, cache, nullptr);
+            cache = VK_NULL_HANDLE;
+        }
+    }
+
+    bool PipelineCache::validate(const uint8_t* data, size_t size, const char*& reason) const {
+        if (size < sizeof(Header) + sizeof(VkPipelineCacheHeaderVersionOne)) {
+            reason = "file too small";
+            return false;
+        }
+
+        Header header;
+        memcpy(&header, data, sizeof(Header));
+        if (header.magic != MAGIC || header.version != VERSION) {
+            reason = "unknown format";
+            return false;
+        }
+        if (header.dataSize != size - sizeof(Header)) {
+            reason = "truncated";
+            return false;
+        }
+        if (utils::fnv1a64(data + sizeof(Header), header.dataSize) != header.dataHash) {
+            reason = "corrupted";
+            return false;
+        }
+
+        VkPipelineCacheHeaderVersionOne driverHeader;
+        memcpy(&driverHeader, data + sizeof(Header), sizeof(driverHeader));
+        if (driverHeader.headerSize < sizeof(driverHeader) || driverHeader.headerSize > header.dataSize ||
+            driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+            reason = "invalid driver header";
+            return false;
+        }
+        if (driverHeader.vendorID != properties.vendorID || driverHeader.deviceID != properties.deviceID) {
+            reason = "created on a different device";
+            return false;
+        }
+        if (memcmp(driverHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            reason = "created by a different driver version";
+            return false;
+        }
+
+        return true;
+    }
+}
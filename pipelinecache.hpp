@@ -0,0 +1,43 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <string>
+
+namespace testengine {
+
+    //VkPipelineCache persisted between runs. The driver's cache blob is stored behind a small header with its
+    //size and hash, and is only handed back to the driver if both that header and the driver's own header
+    //(vendor, device and cache UUID) match; anything else starts with an empty cache.
+    class PipelineCache {
+        public:
+            explicit PipelineCache(std::string path);
+
+            void load(VkPhysicalDevice physicalDevice, VkDevice device);
+            void save();
+            void destroy();
+
+            VkPipelineCache get() const { return cache; }
+            //true if the cache was created from a valid file, i.e. pipelines should compile warm
+            bool isWarm() const { return warm; }
+
+        private:
+            static constexpr uint32_t MAGIC = 0x43504554; //"TEPC"
+            static constexpr uint32_t VERSION = 1;
+
+            struct Header {
+                uint32_t magic;
+                uint32_t version;
+                uint64_t dataSize;
+                uint64_t dataHash;
+            };
+
+            std::string path;
+            VkDevice device = VK_NULL_HANDLE;
+            VkPhysicalDeviceProperties properties{};
+            VkPipelineCache cache = VK_NULL_HANDLE;
+            bool warm = false;
+
+            bool validate(const uint8_t* data, size_t size, const char*& reason) const;
+    };
+}
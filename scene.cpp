@@ -0,0 +1,132 @@
+#include "scene.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace testengine {
+
+    namespace {
+
+        glm::vec4 row(const glm::mat4& matrix, int index) {
+            return glm::vec4(matrix[0][index], matrix[1][index], matrix[2][index], matrix[3][index]);
+        }
+    }
+
+    void extractFrustumPlanes(const glm::mat4& clip, glm::vec4 planes[6]) {
+        planes[0] = row(clip, 3) + row(clip, 0);
+        planes[1] = row(clip, 3) - row(clip, 0);
+        planes[2] = row(clip, 3) + row(clip, 1);
+        planes[3] = row(clip, 3) - row(clip, 1);
+        planes[4] = row(clip, 2);
+        planes[5] = row(clip, 3) - row(clip, 2);
+
+        for (int i = 0; i < 6; i++) {
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+        }
+    }
+
+    uint32_t Scene::addMesh(const MeshLod* lods, uint32_t lodCount, int32_t vertexOffset, const glm::vec4& boundingSphere) {
+        if (lodCount == 0 || lodCount > MAX_MESH_LODS) {
+            throw std::runtime_error("Runtime error: mesh needs between 1 and MAX_MESH_LODS levels of detail.");
+        }
+
+        SceneMesh mesh{};
+        mesh.vertexOffset = vertexOffset;
+        mesh.boundingSphere = boundingSphere;
+        mesh.lodCount = lodCount;
+        std::copy(lods, lods + lodCount, mesh.lods);
+        meshes.push_back(mesh);
+        return static_cast<uint32_t>(meshes.size() - 1);
+    }
+
+    void Scene::addInstance(uint32_t mesh, const glm::mat4& transform, uint32_t material) {
+        if (mesh >= meshes.size()) {
+            throw std::runtime_error("Runtime error: instance references unknown mesh.");
+        }
+        instances.push_back({mesh, transform, material});
+    }
+
+    void Scene::clearInstances() {
+        instances.clear();
+        instanceData.clear();
+        batches.clear();
+    }
+
+    void Scene::buildBatches() {
+        //counting sort by mesh, stable so instances of one mesh keep the order they were added in
+        std::vector<uint32_t> firstInstance(meshes.size() + 1, 0);
+        for (const Instance& instance : instances) {
+            firstInstance[instance.mesh + 1]++;
+        }
+        for (size_t i = 1; i < firstInstance.size(); i++) {
+            firstInstance[i] += firstInstance[i - 1];
+        }
+
+        batches.clear();
+        for (uint32_t mesh = 0; mesh < meshes.size(); mesh++) {
+            uint32_t count = firstInstance[mesh + 1] - firstInstance[mesh];
+            if (count > 0) {
+                batches.push_back({mesh, firstInstance[mesh], count});
+            }
+        }
+
+        instanceData.resize(instances.size());
+        for (const Instance& instance : instances) {
+            InstanceData& data = instanceData[firstInstance[instance.mesh]++];
+            data = {};
+            data.model = instance.transform;
+            data.material = instance.material;
+        }
+    }
+
+    std::vector<glm::mat4> Scene::gridTransforms(uint32_t count, float spacing) {
+        std::vector<glm::mat4> transforms;
+        transforms.reserve(count);
+
+        uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+        for (uint32_t i = 0; i < count; i++) {
+            //rows and columns are numbered 0, -1, 1, -2, 2, ... so the first instance sits at the origin
+            int32_t x = static_cast<int32_t>(i % side);
+            int32_t y = static_cast<int32_t>(i / side);
+            x = (x % 2 == 0) ? x / 2 : -(x + 1) / 2;
+            y = (y % 2 == 0) ? y / 2 : -(y + 1) / 2;
+
+            transforms.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(x * spacing, y * spacing, 0.0f)));
+        }
+
+        return transforms;
+    }
+
+    glm::vec4 Scene::computeBoundingSphere(const Vertex* vertices, uint32_t vertexCount) {
+        if (vertexCount == 0) {
+            return glm::vec4(0.0f);
+        }
+
+        glm::vec3 minimum = vertices[0].pos;
+        glm::vec3 maximum = vertices[0].pos;
+        for (uint32_t i = 1; i < vertexCount; i++) {
+            minimum = glm::min(minimum, vertices[i].pos);
+            maximum = glm::max(maximum, vertices[i].pos);
+        }
+
+        glm::vec3 center = (minimum + maximum) * 0.5f;
+        float radiusSquared = 0.0f;
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            glm::vec3 offset = vertices[i].pos - center;
+            radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+        }
+
+        return glm::vec4(center, std::sqrt(radiusSquared));
+    }
+
+    uint32_t Scene::selectLod(const SceneMesh& mesh, float errorScale) {
+        uint32_t lod = 0;
+        while (lod + 1 < mesh.lodCount && mesh.lods[lod + 1].error * errorScale <= 1.0f) {
+            lod++;
+        }
+        return lod;
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "meshsimplifier.hpp"
+#include "vertex.hpp"
+
+namespace testengine {
+
+    //ranges of the shared vertex/index buffers, one index range per level of detail
+    struct SceneMesh {
+        int32_t vertexOffset;
+        //xyz center and w radius in model space
+        glm::vec4 boundingSphere;
+        //lods[0] is the full resolution mesh, errors grow with the level
+        uint32_t lodCount;
+        MeshLod lods[MAX_MESH_LODS];
+    };
+
+    //per instance data, read through the instance rate vertex binding
+    struct InstanceData {
+        glm::mat4 model;
+        //index into the bindless texture array
+        uint32_t material;
+        uint32_t padding[3];
+    };
+
+    //one instanced draw, covering instanceCount consecutive entries of the instance data
+    struct DrawBatch {
+        uint32_t mesh;
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+    };
+
+    //Gribb/Hartmann plane extraction for a [0, 1] depth range, normals point into the frustum and are normalized,
+    //planes[4] is the near plane
+    void extractFrustumPlanes(const glm::mat4& clip, glm::vec4 planes[6]);
+
+    //Meshes and the instances placed in the world. buildBatches() groups the instances by mesh so every mesh
+    //is drawn with a single instanced draw, whatever the order the instances were added in.
+    class Scene {
+        public:
+            uint32_t addMesh(const MeshLod* lods, uint32_t lodCount, int32_t vertexOffset, const glm::vec4& boundingSphere);
+            void addInstance(uint32_t mesh, const glm::mat4& transform, uint32_t material = 0);
+            void clearInstances();
+
+            void buildBatches();
+
+            const std::vector<SceneMesh>& getMeshes() const { return meshes; }
+            const std::vector<InstanceData>& getInstanceData() const { return instanceData; }
+            const std::vector<DrawBatch>& getBatches() const { return batches; }
+            uint32_t getInstanceCount() const { return static_cast<uint32_t>(instanceData.size()); }
+
+            //square grid of count transforms in the xy plane centered on the origin, the first one is the identity
+            static std::vector<glm::mat4> gridTransforms(uint32_t count, float spacing);
+            //sphere around the bounding box of the vertices, not minimal but cheap and never too small
+            static glm::vec4 computeBoundingSphere(const Vertex* vertices, uint32_t vertexCount);
+            //coarsest level whose error stays below one unit once multiplied by errorScale, e.g. pixels per model unit
+            //over the allowed error in pixels; matches the selection in cull.comp
+            static uint32_t selectLod(const SceneMesh& mesh, float errorScale);
+
+        private:
+            struct Instance {
+                uint32_t mesh;
+                glm::mat4 transform;
+                uint32_t material;
+            };
+
+            std::vector<SceneMesh> meshes;
+            std::vector<Instance> instances;
+
+            std::vector<InstanceData> instanceData;
+            std::vector<DrawBatch> batches;
+    };
+}
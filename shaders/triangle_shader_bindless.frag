@@ -0,0 +1,27 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 1, binding = 0) uniform sampler textureSampler;
+layout(set = 1, binding = 1) uniform texture2D textures[];
+
+//finest level of every texture wanted in the frame, relative to level 0 of the bound image
+layout(std430, binding = 2) buffer TextureFeedback {
+    int minLevels[];
+} feedback;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragMaterial;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    //instances of one draw may use different materials, so the index is not uniform
+    outColor = texture(sampler2D(textures[nonuniformEXT(fragMaterial)], textureSampler), fragTexCoord);
+
+    //one fragment in 8x8 reports, enough to find the finest level while keeping the atomics off the hot path
+    if ((uint(gl_FragCoord.x) & 7u) == 0u && (uint(gl_FragCoord.y) & 7u) == 0u) {
+        int level = int(floor(textureQueryLod(sampler2D(textures[nonuniformEXT(fragMaterial)], textureSampler), fragTexCoord).y));
+        atomicMin(feedback.minLevels[fragMaterial], level);
+    }
+}
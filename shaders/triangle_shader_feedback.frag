@@ -0,0 +1,22 @@
+#version 450
+
+layout(binding = 1) uniform sampler2D texSampler;
+
+//finest level of every texture wanted in the frame, relative to level 0 of the bound image
+layout(std430, binding = 2) buffer TextureFeedback {
+    int minLevels[];
+} feedback;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = texture(texSampler, fragTexCoord);
+
+    //one fragment in 8x8 reports, enough to find the finest level while keeping the atomics off the hot path
+    if ((uint(gl_FragCoord.x) & 7u) == 0u && (uint(gl_FragCoord.y) & 7u) == 0u) {
+        atomicMin(feedback.minLevels[0], int(floor(textureQueryLod(texSampler, fragTexCoord).y)));
+    }
+}
@@ -0,0 +1,30 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+} ubo;
+
+//maps the unorm16 positions back to the mesh bounds
+layout(push_constant) uniform VertexQuantization {
+    vec4 offset;
+    vec4 scale;
+} quantization;
+
+layout(location = 0) in vec4 inPosition;
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in mat4 inInstanceModel;
+layout(location = 7) in uint inInstanceMaterial;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterial;
+
+void main() {
+    vec3 position = quantization.offset.xyz + inPosition.xyz * quantization.scale.xyz;
+    gl_Position = ubo.projection * ubo.view * ubo.model * inInstanceModel * vec4(position, 1.0);
+    fragColor = vec3(1.0);
+    fragTexCoord = inTexCoord;
+    fragMaterial = inInstanceMaterial;
+}
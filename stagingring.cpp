@@ -0,0 +1,105 @@
+#include "stagingring.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace testengine {
+
+    namespace {
+
+        VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+            return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+        }
+    }
+
+    void StagingRing::init(VkDevice device, GpuAllocator* allocator, VkDeviceSize capacity) {
+        this->device = device;
+        this->allocator = allocator;
+        this->capacity = capacity;
+
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = capacity;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create staging ring.");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+        allocation = allocator->allocate(memRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, false);
+        vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+    }
+
+    void StagingRing::destroy() {
+        vkDestroyBuffer(device, buffer, nullptr);
+        allocator->free(allocation);
+        buffer = VK_NULL_HANDLE;
+        submissions.clear();
+        head = tail = usedBytes = openBytes = 0;
+    }
+
+    bool StagingRing::reserve(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+        if (usedBytes == 0) {
+            head = tail = 0;
+        }
+
+        //live data is [tail, head) when not wrapped, else [tail, capacity) + [0, head)
+        bool wrapped = head < tail || (head == tail && usedBytes > 0);
+        VkDeviceSize aligned = alignUp(head, alignment);
+
+        if (!wrapped) {
+            if (aligned + size <= capacity) {
+                offset = aligned;
+            } else if (size <= tail) {
+                //the rest of the buffer is skipped and reclaimed together with this submission
+                offset = 0;
+            } else {
+                return false;
+            }
+        } else {
+            if (aligned + size > tail) {
+                return false;
+            }
+            offset = aligned;
+        }
+
+        VkDeviceSize consumed = offset >= head ? offset + size - head : (capacity - head) + size;
+        head = offset + size;
+        usedBytes += consumed;
+        openBytes += consumed;
+        return true;
+    }
+
+    VkDeviceSize StagingRing::largestFree(VkDeviceSize alignment) const {
+        if (usedBytes == 0) {
+            return capacity;
+        }
+
+        bool wrapped = head < tail || head == tail;
+        VkDeviceSize aligned = alignUp(head, alignment);
+        if (wrapped) {
+            return aligned < tail ? tail - aligned : 0;
+        }
+        return std::max(aligned < capacity ? capacity - aligned : 0, tail);
+    }
+
+    void StagingRing::close(uint64_t submissionId) {
+        if (openBytes == 0) {
+            return;
+        }
+        submissions.push_back({submissionId, head, openBytes});
+        openBytes = 0;
+    }
+
+    void StagingRing::release(uint64_t submissionId) {
+        while (!submissions.empty() && submissions.front().id <= submissionId) {
+            tail = submissions.front().end;
+            usedBytes -= submissions.front().bytes;
+            submissions.pop_front();
+        }
+    }
+}
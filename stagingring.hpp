@@ -0,0 +1,57 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <deque>
+
+#include "gpuallocator.hpp"
+
+namespace testengine {
+
+    //One persistently mapped host visible buffer used as a ring for all staging data. Space is handed out at
+    //the head and given back at the tail: everything reserved between two close() calls belongs to one
+    //submission and is reclaimed together by release() once that submission finished on the GPU.
+    class StagingRing {
+        public:
+            StagingRing() = default;
+            StagingRing(const StagingRing&) = delete;
+            StagingRing& operator=(const StagingRing&) = delete;
+
+            void init(VkDevice device, GpuAllocator* allocator, VkDeviceSize capacity);
+            void destroy();
+
+            //false if there is no contiguous free range of size bytes right now
+            bool reserve(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+            //largest reservation that would currently succeed
+            VkDeviceSize largestFree(VkDeviceSize alignment) const;
+
+            //everything reserved since the previous close() is in use until release(submissionId)
+            void close(uint64_t submissionId);
+            void release(uint64_t submissionId);
+
+            VkBuffer getBuffer() const { return buffer; }
+            uint8_t* getMapped() const { return static_cast<uint8_t*>(allocation.mapped); }
+            VkDeviceSize getCapacity() const { return capacity; }
+            VkDeviceSize getUsed() const { return usedBytes; }
+
+        private:
+            struct Submission {
+                uint64_t id;
+                VkDeviceSize end;
+                VkDeviceSize bytes;
+            };
+
+            VkDevice device = VK_NULL_HANDLE;
+            GpuAllocator* allocator = nullptr;
+            VkBuffer buffer = VK_NULL_HANDLE;
+            GpuAllocation allocation;
+            VkDeviceSize capacity = 0;
+
+            VkDeviceSize head = 0;
+            VkDeviceSize tail = 0;
+            //includes alignment padding and the space skipped when wrapping around
+            VkDeviceSize usedBytes = 0;
+            VkDeviceSize openBytes = 0;
+            std::deque<Submission> submissions;
+    };
+}
@@ -11,13 +11,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
-
 #include "testengine.hpp"
+#include "objimporter.hpp"
+#include "trace.hpp"
 #include "utils.hpp"
 
 #include <stdexcept>
@@ -34,100 +30,176 @@
 
 namespace testengine {
 
+    TestEngine::TestEngine(const EngineConfig& config) : config(config) {}
+
     void TestEngine::run() {
-                initWindow();
+                launchTime = std::chrono::steady_clock::now();
+                if (!config.cpuTracePath.empty()) {
+                    startTrace(config.cpuTracePath);
+                }
+                if (!config.headless) {
+                    initWindow();
+                }
                 initVulkan();
                 mainLoop();
                 cleanup();
+                stopTrace();
             }
 
     void TestEngine::initWindow() {
         glfwInit();
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
-        window = glfwCreateWindow(WIDTH, HEIGHT, "TestEngine", nullptr, nullptr);
+        window = glfwCreateWindow(config.width, config.height, "TestEngine", nullptr, nullptr);
         glfwSetWindowUserPointer(window, this);
         glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
     }
 
     void TestEngine::initVulkan() {
         createInstance();
-        createSurface();
+        if (!config.headless) {
+            createSurface();
+        }
         pickPhysicalDevice();
         createLogicalDevice();
-        createSwapChain();
+        gpuAllocator.init(physicalDevice, device);
+        if (config.headless) {
+            createOffscreenTargets();
+        } else {
+            createSwapChain();
+        }
         createImageViews();
         createRenderPass();
         createDescriptorSetLayout();
+        pipelineCache.load(physicalDevice, device);
         createGraphicsPipeline();
         createCommandPool();
+        createUploadManager();
+        attachmentExtent = chooseAttachmentExtent(swapChainExtent);
         createColorResources();
         createDepthResources();
         createFramebuffers();
-        createTextureImage();
-        createTextureImageView();
+        createTextureStreamer();
         createTextureSampler();
         loadModel();
         createVertexBuffer();
         createIndexBuffer();
+        createScene();
+        createInstanceBuffer();
+        createCullingPass();
+        uploadManager.submit();
+        releaseModelData();
         createUniformBuffers();
         createDescriptorPool();
         createDescriptorSets();
         createCommandBuffers();
+        createSecondaryCommandBuffers();
         createSyncObjects();
+        createProfiler();
+
+        gpuAllocator.printStats();
     }
 
     void TestEngine::mainLoop() {
 
-        while(!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
-            drawFrame();
+        if (config.headless) {
+            uint32_t frameCount = config.frameCount > 0 ? config.frameCount : HEADLESS_DEFAULT_FRAMES;
+            for (uint32_t i = 0; i < frameCount; i++) {
+                drawFrame();
+            }
+        } else {
+            while(!glfwWindowShouldClose(window) && (config.frameCount == 0 || frameCounter < config.frameCount)) {
+                //low latency pacing samples input inside drawFrame(), after waiting for the frame's start
+                if (!framePacer.isPacing()) {
+                    glfwPollEvents();
+                }
+                drawFrame();
+            }
         }
 
         vkDeviceWaitIdle(device);
+
+        //oldest frame first, the profiler continues the GPU clock in submission order
+        for (uint32_t i = 0; i < config.framesInFlight; i++) {
+            readFrameTimestamps((frameScheduler.getFrameIndex() + i) % config.framesInFlight);
+        }
+
+        //the frame time summary goes last, the bench targets read it with tail
+        textureStreamer.printStats();
+        std::cout << "Uniform ring: peak " << uniformRing.getPeakUsed() << " of " << uniformRing.getFrameCapacity() << " bytes per frame\n";
+        framePacer.printSummary();
+        printAttachmentMemory();
+        gpuProfiler.printSummary();
+        if (!config.profileTracePath.empty()) {
+            gpuProfiler.writeChromeTrace(config.profileTracePath);
+        }
+        printFrameTimeSummary();
     }
 
     void TestEngine::cleanup() {
         cleanupSwapChain();
 
+        gpuProfiler.destroy();
+
         vkDestroySampler(device, textureSampler, nullptr);
-        vkDestroyImageView(device, textureImageView, nullptr);
-        vkDestroyImage(device, textureImage, nullptr);
-        vkFreeMemory(device, textureImageMemory, nullptr);
+        textureStreamer.destroy();
 
         vkDestroyBuffer(device, vertexBuffer, nullptr);
-        vkFreeMemory(device, vertexBufferMemory, nullptr);
+        gpuAllocator.free(vertexBufferAllocation);
 
         vkDestroyBuffer(device, indexBuffer, nullptr);
-        vkFreeMemory(device, indexBufferMemory, nullptr);
+        gpuAllocator.free(indexBufferAllocation);
+
+        vkDestroyBuffer(device, instanceBuffer, nullptr);
+        gpuAllocator.free(instanceBufferAllocation);
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-            vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+        if (gpuCullingEnabled) {
+            cullingPass.destroy();
+        }
+        if (meshletCullingEnabled) {
+            meshletPass.destroy();
         }
 
+        uniformRing.destroy();
+
         vkDestroyDescriptorPool(device, descriptorPool, nullptr);
         vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        if (bindlessEnabled) {
+            vkDestroyDescriptorSetLayout(device, bindlessSetLayout, nullptr);
+        }
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < config.framesInFlight; i++) {
             vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
             vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-            vkDestroyFence(device, inFlightFences[i], nullptr);
         }
+        frameScheduler.destroy();
 
         vkDestroyCommandPool(device, commandPool, nullptr);
+        for (VkCommandPool pool : secondaryCommandPools) {
+            vkDestroyCommandPool(device, pool, nullptr);
+        }
 
         vkDestroyPipeline(device, graphicsPipeline, nullptr);
         vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
         vkDestroyRenderPass(device, renderPass, nullptr);
 
-        vkDestroySurfaceKHR(instance, surface, nullptr);
-        vkDestroyInstance(instance, nullptr);
+        pipelineCache.save();
+        pipelineCache.destroy();
+
+        uploadManager.destroy();
+        gpuAllocator.destroy();
         vkDestroyDevice(device, nullptr);
 
-        glfwDestroyWindow(window);
-        glfwTerminate();
+        if (!config.headless) {
+            vkDestroySurfaceKHR(instance, surface, nullptr);
+        }
+        vkDestroyInstance(instance, nullptr);
+
+        if (!config.headless) {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
     }
 
     void TestEngine::createInstance() {
@@ -142,10 +214,15 @@ namespace testengine {
         appInfo.pApplicationName = "VulkanApp";
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "StrayEngine";
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        //1.2 so Vulkan 1.2 features can be enabled where the device supports them, older devices still work
+        appInfo.apiVersion = VK_API_VERSION_1_2;
 
+        //headless mode never touches GLFW, so it needs no surface extensions
         uint32_t glfwExtensionCount = 0;
-        const char** glfwExtensionsNames = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        const char** glfwExtensionsNames = nullptr;
+        if (!config.headless) {
+            glfwExtensionsNames = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        }
 
         std::cout << "GLFW required instance extensions:\n";
         for (uint32_t i = 0; i < glfwExtensionCount; i++) {
@@ -214,7 +291,8 @@ namespace testengine {
         for (const auto& device : devices) {
             if (isDeviceSuitable(device)) {
                 physicalDevice = device;
-                msaaSamples = getMaxUsableSampleCount();
+                queryDeviceCapabilities();
+                msaaSamples = chooseSampleCount();
                 break;
             }
         }
@@ -224,11 +302,103 @@ namespace testengine {
         }
     }
 
+    void TestEngine::queryDeviceCapabilities() {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        capabilities.apiVersion = properties.apiVersion;
+
+        VkPhysicalDeviceFeatures features{};
+        vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+        capabilities.multiDrawIndirect = features.multiDrawIndirect;
+        capabilities.drawIndirectFirstInstance = features.drawIndirectFirstInstance;
+        capabilities.textureCompressionBC = features.textureCompressionBC;
+        capabilities.fragmentStoresAndAtomics = features.fragmentStoresAndAtomics;
+        capabilities.pipelineStatisticsQuery = features.pipelineStatisticsQuery && features.inheritedQueries;
+        capabilities.minUniformBufferOffsetAlignment = properties.limits.minUniformBufferOffsetAlignment;
+        capabilities.maxImageDimension2D = properties.limits.maxImageDimension2D;
+        capabilities.framebufferSampleCounts = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+
+        VkPhysicalDeviceMemoryProperties memoryProperties{};
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            if (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+                capabilities.lazilyAllocatedMemory = true;
+            }
+        }
+
+        //present timing only matters with a window, headless devices never enable it
+        bool presentWaitExtensions = false;
+        if (!config.headless) {
+            uint32_t extensionCount;
+            vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+            std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+            vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+            std::set<std::string> extensionNames;
+            for (const auto& extension : availableExtensions) {
+                extensionNames.insert(extension.extensionName);
+            }
+            presentWaitExtensions = extensionNames.count(VK_KHR_PRESENT_ID_EXTENSION_NAME) > 0 &&
+                                    extensionNames.count(VK_KHR_PRESENT_WAIT_EXTENSION_NAME) > 0;
+        }
+
+        //Vulkan 1.2 feature structs may only be queried on 1.2 devices
+        if (properties.apiVersion >= VK_API_VERSION_1_2) {
+            VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+            presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+            VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+            presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+            presentIdFeatures.pNext = &presentWaitFeatures;
+
+            VkPhysicalDeviceVulkan12Features features12{};
+            features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+            if (presentWaitExtensions) {
+                features12.pNext = &presentIdFeatures;
+            }
+
+            VkPhysicalDeviceFeatures2 features2{};
+            features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features2.pNext = &features12;
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+            capabilities.drawIndirectCount = features12.drawIndirectCount;
+            capabilities.timelineSemaphore = features12.timelineSemaphore;
+            capabilities.presentWait = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+            capabilities.descriptorIndexing = features12.runtimeDescriptorArray && features12.descriptorBindingPartiallyBound &&
+                                              features12.descriptorBindingSampledImageUpdateAfterBind &&
+                                              features12.shaderSampledImageArrayNonUniformIndexing;
+
+            VkPhysicalDeviceVulkan12Properties properties12{};
+            properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+            VkPhysicalDeviceProperties2 properties2{};
+            properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+            properties2.pNext = &properties12;
+            vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+
+            capabilities.maxBindlessTextures = std::min(properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+                                                        properties12.maxPerStageDescriptorUpdateAfterBindSampledImages);
+        }
+
+        std::cout << "Device capabilities: Vulkan " << VK_API_VERSION_MAJOR(properties.apiVersion) << '.' << VK_API_VERSION_MINOR(properties.apiVersion)
+                  << ", multiDrawIndirect " << capabilities.multiDrawIndirect
+                  << ", drawIndirectFirstInstance " << capabilities.drawIndirectFirstInstance
+                  << ", drawIndirectCount " << capabilities.drawIndirectCount
+                  << ", timelineSemaphore " << capabilities.timelineSemaphore
+                  << ", textureCompressionBC " << capabilities.textureCompressionBC
+                  << ", fragmentStoresAndAtomics " << capabilities.fragmentStoresAndAtomics
+                  << ", pipelineStatisticsQuery " << capabilities.pipelineStatisticsQuery
+                  << ", presentWait " << capabilities.presentWait
+                  << ", lazilyAllocatedMemory " << capabilities.lazilyAllocatedMemory
+                  << ", descriptorIndexing " << capabilities.descriptorIndexing << " (" << capabilities.maxBindlessTextures << " textures)\n";
+    }
+
     void TestEngine::createLogicalDevice() {
         QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+        std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value()};
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -243,14 +413,50 @@ namespace testengine {
         VkPhysicalDeviceFeatures deviceFeatures{};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
         deviceFeatures.sampleRateShading = VK_TRUE;
+        deviceFeatures.multiDrawIndirect = capabilities.multiDrawIndirect;
+        deviceFeatures.drawIndirectFirstInstance = capabilities.drawIndirectFirstInstance;
+        deviceFeatures.textureCompressionBC = capabilities.textureCompressionBC;
+        deviceFeatures.fragmentStoresAndAtomics = capabilities.fragmentStoresAndAtomics;
+        deviceFeatures.pipelineStatisticsQuery = capabilities.pipelineStatisticsQuery;
+        deviceFeatures.inheritedQueries = capabilities.pipelineStatisticsQuery;
+
+        VkPhysicalDeviceVulkan12Features features12{};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+        features12.drawIndirectCount = capabilities.drawIndirectCount;
+        features12.timelineSemaphore = capabilities.timelineSemaphore;
+        features12.runtimeDescriptorArray = capabilities.descriptorIndexing;
+        features12.descriptorBindingPartiallyBound = capabilities.descriptorIndexing;
+        features12.descriptorBindingSampledImageUpdateAfterBind = capabilities.descriptorIndexing;
+        features12.shaderSampledImageArrayNonUniformIndexing = capabilities.descriptorIndexing;
+
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        presentWaitFeatures.presentWait = VK_TRUE;
+
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        presentIdFeatures.presentId = VK_TRUE;
+
+        if (capabilities.presentWait) {
+            features12.pNext = &presentIdFeatures;
+        }
 
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        if (capabilities.apiVersion >= VK_API_VERSION_1_2) {
+            createInfo.pNext = &features12;
+        }
+        std::vector<const char*> extensions = getRequiredDeviceExtensions();
+        if (capabilities.presentWait) {
+            extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        }
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
 
         //ignored in up-to-date implementations
         if (enableValidationLayers) {
@@ -266,6 +472,7 @@ namespace testengine {
 
         vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
         vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+        vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
     }
 
     void TestEngine::createSwapChain() {
@@ -307,7 +514,8 @@ namespace testengine {
         createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        //lets the presentation engine hand over from the retiring swapchain, whose queued presents still complete
+        createInfo.oldSwapchain = swapChain;
 
         if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
             throw std::runtime_error("Runtime error: failed to create swap chain.");
@@ -319,6 +527,23 @@ namespace testengine {
 
         swapChainImageFormat = surfaceFormat.format;
         swapChainExtent = extent;
+        framePacer.setSwapchain(swapChain);
+    }
+
+    void TestEngine::createOffscreenTargets() {
+        swapChainImageFormat = findSupportedFormat({VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB},
+                                                   VK_IMAGE_TILING_OPTIMAL,
+                                                   VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+        swapChainExtent = {config.width, config.height};
+
+        swapChainImages.resize(HEADLESS_IMAGE_COUNT);
+        offscreenImagesAllocations.resize(HEADLESS_IMAGE_COUNT);
+
+        for (size_t i = 0; i < swapChainImages.size(); i++) {
+            createImage(swapChainExtent.width, swapChainExtent.height, 1, VK_SAMPLE_COUNT_1_BIT, swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                        swapChainImages[i], offscreenImagesAllocations[i]);
+        }
     }
 
     void TestEngine::createImageViews() {
@@ -334,7 +559,8 @@ namespace testengine {
         colorAttachment.format = swapChainImageFormat;
         colorAttachment.samples = msaaSamples;
         colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        //only the resolved color is ever read, the samples may stay in tile memory
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -366,13 +592,14 @@ namespace testengine {
         colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        //PRESENT_SRC_KHR needs VK_KHR_swapchain, which headless devices do not enable
+        colorAttachmentResolve.finalLayout = config.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         VkAttachmentReference colorAttachmentResolveRef{};
         colorAttachmentResolveRef.attachment = 2;
         colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-        std::array<VkAttachmentDescription, 3> attachments = {colorAttachment, depthAttachment, colorAttachmentResolve};
+        std::vector<VkAttachmentDescription> attachments = {colorAttachment, depthAttachment, colorAttachmentResolve};
 
         VkSubpassDescription subpass{};
         subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
@@ -381,6 +608,14 @@ namespace testengine {
         subpass.pDepthStencilAttachment = &depthAttachmentRef;
         subpass.pResolveAttachments = &colorAttachmentResolveRef;
 
+        //without MSAA the swapchain image is the color attachment and nothing is resolved
+        if (msaaSamples == VK_SAMPLE_COUNT_1_BIT) {
+            attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            attachments[0].finalLayout = colorAttachmentResolve.finalLayout;
+            attachments.pop_back();
+            subpass.pResolveAttachments = nullptr;
+        }
+
         VkSubpassDependency dependency{};
         dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
         dependency.dstSubpass = 0;
@@ -405,7 +640,7 @@ namespace testengine {
     void TestEngine::createDescriptorSetLayout() {
         VkDescriptorSetLayoutBinding uboLayoutBinding{};
         uboLayoutBinding.binding = 0;
-        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         uboLayoutBinding.descriptorCount = 1;
         uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
@@ -416,7 +651,14 @@ namespace testengine {
         samplerLayoutBinding.pImmutableSamplers = nullptr;
         samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-        std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
+        //finest texture level the fragment shader wanted, read back by the texture streamer
+        VkDescriptorSetLayoutBinding feedbackLayoutBinding{};
+        feedbackLayoutBinding.binding = 2;
+        feedbackLayoutBinding.descriptorCount = 1;
+        feedbackLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        feedbackLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        std::array<VkDescriptorSetLayoutBinding, 3> bindings = {uboLayoutBinding, samplerLayoutBinding, feedbackLayoutBinding};
 
         VkDescriptorSetLayoutCreateInfo layoutInfo{};
         layoutInfo.sType  = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -426,11 +668,62 @@ namespace testengine {
         if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
             throw std::runtime_error("Runtime error: failed to create descriptor set layout.");
         }
+
+        //the bindless shader always writes feedback, so it needs fragment stores as well
+        bindlessEnabled = config.bindlessTextures && capabilities.descriptorIndexing && capabilities.fragmentStoresAndAtomics &&
+                          capabilities.maxBindlessTextures > 1;
+        if (!bindlessEnabled) {
+            if (config.bindlessTextures) {
+                std::cout << "Bindless textures unsupported, every material samples texture 0\n";
+            }
+            return;
+        }
+        //the combined image sampler of set 0 counts against the same per stage limit
+        bindlessCapacity = std::min(TextureStreamer::MAX_TEXTURES, capabilities.maxBindlessTextures - 1);
+
+        VkDescriptorSetLayoutBinding sharedSamplerBinding{};
+        sharedSamplerBinding.binding = 0;
+        sharedSamplerBinding.descriptorCount = 1;
+        sharedSamplerBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        sharedSamplerBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        VkDescriptorSetLayoutBinding texturesBinding{};
+        texturesBinding.binding = 1;
+        texturesBinding.descriptorCount = bindlessCapacity;
+        texturesBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        texturesBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        std::array<VkDescriptorSetLayoutBinding, 2> bindlessBindings = {sharedSamplerBinding, texturesBinding};
+        //slots of textures that were never added stay unwritten
+        std::array<VkDescriptorBindingFlags, 2> bindingFlags = {0, VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT};
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+        bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+        layoutInfo.pNext = &bindingFlagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindlessBindings.size());
+        layoutInfo.pBindings = bindlessBindings.data();
+
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &bindlessSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create bindless descriptor set layout.");
+        }
     }
 
     void TestEngine::createGraphicsPipeline() {
-        std::vector<char> vertShaderCode = utils::readFile("shaders/compiled/triangle_shader.vert.spv");
-        std::vector<char> fragShaderCode = utils::readFile("shaders/compiled/triangle_shader.frag.spv");
+        //the packed variant dequantizes positions and has no vertex color input
+        std::vector<char> vertShaderCode = utils::readFile(config.packedVertices ? "shaders/compiled/triangle_shader_packed.vert.spv"
+                                                                                 : "shaders/compiled/triangle_shader.vert.spv");
+        //the feedback variants write the texture level they sample, which needs stores from fragment shaders
+        const char* fragShaderPath = "shaders/compiled/triangle_shader.frag.spv";
+        if (bindlessEnabled) {
+            fragShaderPath = "shaders/compiled/triangle_shader_bindless.frag.spv";
+        } else if (capabilities.fragmentStoresAndAtomics) {
+            fragShaderPath = "shaders/compiled/triangle_shader_feedback.frag.spv";
+        }
+        std::vector<char> fragShaderCode = utils::readFile(fragShaderPath);
 
         std::cout << "Vertex shader code size: " << vertShaderCode.size() << '\n';
         std::cout << "Fragment shader code size: " << fragShaderCode.size() << '\n';
@@ -452,7 +745,7 @@ namespace testengine {
 
         VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
-        auto bindingDescription = getBindingDescription();
+        std::array<VkVertexInputBindingDescription, 2> bindingDescriptions = {getBindingDescription(), getInstanceBindingDescription()};
         auto attributeDescriptions = getAttributeDescriptions();
 
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
@@ -462,9 +755,9 @@ namespace testengine {
         vertexInputInfo.vertexAttributeDescriptionCount = 0;
         vertexInputInfo.pVertexAttributeDescriptions = nullptr;
 
-        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
         vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+        vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
         vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
         VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
@@ -510,8 +803,18 @@ namespace testengine {
 
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 1;
-        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+        std::array<VkDescriptorSetLayout, 2> setLayouts = {descriptorSetLayout, bindlessSetLayout};
+        pipelineLayoutInfo.setLayoutCount = bindlessEnabled ? 2 : 1;
+        pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+
+        VkPushConstantRange quantizationRange{};
+        quantizationRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        quantizationRange.offset = 0;
+        quantizationRange.size = sizeof(VertexQuantization);
+        if (config.packedVertices) {
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &quantizationRange;
+        }
 
         VkPipelineDepthStencilStateCreateInfo depthStencil{};
         depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
@@ -544,9 +847,12 @@ namespace testengine {
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
         pipelineInfo.basePipelineIndex = -1;
 
-        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+        auto compileStart = std::chrono::steady_clock::now();
+        if (vkCreateGraphicsPipelines(device, pipelineCache.get(), 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
             throw std::runtime_error("Runtime error: failed to create graphics pipeline");
         }
+        std::cout << "Graphics pipeline created (" << (pipelineCache.isWarm() ? "warm" : "cold") << " cache) in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compileStart).count() << " ms\n";
 
         vkDestroyShaderModule(device, vertShaderModule, nullptr);
         vkDestroyShaderModule(device, fragShaderModule, nullptr);
@@ -556,11 +862,14 @@ namespace testengine {
         swapChainFramebuffers.resize(swapChainImageViews.size());
 
         for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-            std::array<VkImageView, 3> attachments = {
+            std::vector<VkImageView> attachments = {
                 colorImageView,
                 depthImageView,
                 swapChainImageViews[i]
             };
+            if (msaaSamples == VK_SAMPLE_COUNT_1_BIT) {
+                attachments = {swapChainImageViews[i], depthImageView};
+            }
 
             VkFramebufferCreateInfo framebufferInfo{};
             framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -590,64 +899,126 @@ namespace testengine {
         }
     }
 
+    void TestEngine::createUploadManager() {
+        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+        uploadManager.init(device, &gpuAllocator, queueFamilyIndices.graphicsFamily.value(), graphicsQueue,
+                           queueFamilyIndices.transferFamily.value(), transferQueue);
+    }
+
     void TestEngine::createColorResources() {
+        if (msaaSamples == VK_SAMPLE_COUNT_1_BIT) {
+            return;
+        }
+
         VkFormat colorFormat = swapChainImageFormat;
 
-        createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, colorFormat, VK_IMAGE_TILING_OPTIMAL,
-                    VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                    colorImage, colorImageMemory);
+        //never stored, so tilers may keep it in tile memory and never back it; createImage falls back to device local memory
+        createImage(attachmentExtent.width, attachmentExtent.height, 1, msaaSamples, colorFormat, VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, colorImage, colorImageAllocation);
         colorImageView = createImageView(colorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
     }
 
     void TestEngine::createDepthResources() {
         VkFormat depthFormat = findDepthFormat();
 
-        createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL,
-                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                    depthImage, depthImageMemory);
+        createImage(attachmentExtent.width, attachmentExtent.height, 1, msaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, depthImage, depthImageAllocation);
 
         depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
     }
 
-    void TestEngine::createTextureImage() {
-        int texWidth, texHeight, texChannels;
-        stbi_uc* pixels = stbi_load("textures/viking_room.png", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-
-        VkDeviceSize imageSize = texWidth * texHeight * 4;
-
-        if (!pixels) {
-            throw std::runtime_error("Runtime error: failed to load texture image.");
+    VkExtent2D TestEngine::chooseAttachmentExtent(VkExtent2D extent) {
+        //attachments larger than the framebuffer are valid, the render area limits what is drawn
+        bool fits = extent.width <= attachmentExtent.width && extent.height <= attachmentExtent.height;
+        uint64_t area = uint64_t(extent.width) * extent.height;
+        uint64_t attachmentArea = uint64_t(attachmentExtent.width) * attachmentExtent.height;
+        if (fits && area * 4 >= attachmentArea) {
+            return attachmentExtent;
         }
 
-        mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
-
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-
-        createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                        stagingBuffer, stagingBufferMemory);
-
-        void* data;
-        vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-        memcpy(data, pixels, static_cast<size_t>(imageSize));
-        vkUnmapMemory(device, stagingBufferMemory);
-        stbi_image_free(pixels);
-
-        createImage(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-                    VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
+        //the first allocation and shrinking fit exactly, a window that grew once likely keeps growing
+        if (attachmentExtent.width == 0 || fits) {
+            return extent;
+        }
 
-        transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-        copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+        auto grow = [this](uint32_t required, uint32_t current) {
+            if (required <= current) {
+                return current;
+            }
+            uint32_t grown = std::max(required, current + current / 2);
+            grown = (grown + ATTACHMENT_EXTENT_GRANULARITY - 1) / ATTACHMENT_EXTENT_GRANULARITY * ATTACHMENT_EXTENT_GRANULARITY;
+            return std::max(required, std::min(grown, capabilities.maxImageDimension2D));
+        };
+        return {grow(extent.width, attachmentExtent.width), grow(extent.height, attachmentExtent.height)};
+    }
 
-        generateMipMaps(textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
+    void TestEngine::printAttachmentMemory() {
+        //what the attachments took at the most samples the device supports in device local memory, measured without allocating
+        VkSampleCountFlagBits maxSamples = getMaxUsableSampleCount();
+        VkDeviceSize maxSampleBytes = getImageMemorySize(attachmentExtent, maxSamples, swapChainImageFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) +
+                                      getImageMemorySize(attachmentExtent, maxSamples, findDepthFormat(), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+
+        //lazily allocated memory is only backed as far as the attachments left tile memory
+        VkDeviceSize bytes = 0;
+        VkDeviceSize committedBytes = 0;
+        bool lazilyAllocated = false;
+        for (const GpuAllocation* allocation : {&colorImageAllocation, &depthImageAllocation}) {
+            bytes += allocation->size;
+            if (allocation->memory != VK_NULL_HANDLE && (gpuAllocator.getMemoryTypeFlags(allocation->memoryType) & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+                VkDeviceSize committed = 0;
+                vkGetDeviceMemoryCommitment(device, allocation->memory, &committed);
+                committedBytes += committed;
+                lazilyAllocated = true;
+            } else {
+                committedBytes += allocation->size;
+            }
+        }
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        const double MiB = 1024.0 * 1024.0;
+        std::cout << "Attachment memory at " << attachmentExtent.width << 'x' << attachmentExtent.height << ": "
+                  << maxSampleBytes / MiB << " MiB at " << maxSamples << "x in device local memory before, "
+                  << bytes / MiB << " MiB at " << msaaSamples << "x " << (lazilyAllocated ? "lazily allocated" : "in device local memory")
+                  << " now, " << committedBytes / MiB << " MiB committed\n";
     }
 
-    void TestEngine::createTextureImageView() {
-        textureImageView = createImageView(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+    void TestEngine::createTextureStreamer() {
+        std::vector<VkFormat> candidates;
+        if (config.compressedTextures && capabilities.textureCompressionBC) {
+            candidates.push_back(VK_FORMAT_BC7_SRGB_BLOCK);
+        }
+        candidates.push_back(VK_FORMAT_R8G8B8A8_SRGB);
+        textureFormat = findSupportedFormat(candidates, VK_IMAGE_TILING_OPTIMAL,
+                                            VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+
+        textureStreamer.init(device, &gpuAllocator, &uploadManager, &frameScheduler, config.textureBudget, config.framesInFlight,
+                             capabilities.fragmentStoresAndAtomics);
+
+        //runs on the streaming thread, the first frames are drawn with the placeholder meanwhile.
+        //A texture baked with make bake_textures is used as it is, without looking at the source image; otherwise the
+        //imported KTX2 file is reused until the source image changes or the device wants another format
+        textureId = textureStreamer.add([texturePath = TEXTURE_PATH, assetPath = TEXTURE_ASSET_PATH, cachePath = TEXTURE_CACHE_PATH,
+                                         format = textureFormat, threads = config.importThreads]() {
+            auto loadStart = std::chrono::steady_clock::now();
+            TextureData texture;
+            if (readKtx2(assetPath, texture) && texture.format == format) {
+                std::cout << "Loaded baked texture " << assetPath;
+            } else if (readKtx2(cachePath, texture) && texture.format == format && texture.source == stampTextureSource(texturePath)) {
+                std::cout << "Loaded texture cache " << cachePath;
+            } else {
+                texture = importTexture(texturePath, format, threads);
+                if (!writeKtx2(cachePath, texture)) {
+                    std::cerr << "Warning: failed to write texture cache " << cachePath << '\n';
+                }
+                std::cout << "Imported " << texturePath;
+            }
+            std::cout << " in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count() << " ms: "
+                      << texture.width << "x" << texture.height << ", " << texture.levels.size() << " levels, " << texture.data.size() << " bytes ("
+                      << (format == VK_FORMAT_BC7_SRGB_BLOCK ? "BC7" : "RGBA8") << ")\n";
+            return texture;
+        });
     }
 
     void TestEngine::createTextureSampler() {
@@ -665,7 +1036,8 @@ namespace testengine {
         samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
         samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
         samplerInfo.minLod = 0.0f;
-        samplerInfo.maxLod = static_cast<float>(mipLevels);
+        //streamed images hold only their resident levels, level 0 of the view is always the finest one to sample
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
         samplerInfo.mipLodBias = 0.0f;
 
         VkPhysicalDeviceProperties properties{};
@@ -679,112 +1051,294 @@ namespace testengine {
     }
 
     void TestEngine::loadModel() {
-        tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> shapes;
-        std::vector<tinyobj::material_t> materials;
-        std::string warn, err;
-
-        std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-
-        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str())) {
-            throw std::runtime_error(warn + err);
-        }
-
-        for (const auto& shape : shapes) {
-            for (const auto& index : shape.mesh.indices) {
-                Vertex vertex{};
-
-                vertex.pos = {
-                    attrib.vertices[3 * index.vertex_index + 0],
-                    attrib.vertices[3 * index.vertex_index + 1],
-                    attrib.vertices[3 * index.vertex_index + 2]
-                };
-                vertex.texCoord = {
-                    attrib.texcoords[2 * index.texcoord_index + 0],
-                    1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-                };
-                vertex.color = {1.0f, 1.0f, 1.0f};
-
-                if (uniqueVertices.count(vertex) == 0) {
-                    uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                    vertices.push_back(vertex);
-                }
-                indices.push_back(uniqueVertices[vertex]);
+        auto loadStart = std::chrono::steady_clock::now();
+
+        if (meshCache.open(MODEL_PATH)) {
+            const MeshChunk* vertexChunk = meshCache.findChunk(MESH_CHUNK_VERTICES);
+            const MeshChunk* indexChunk = meshCache.findChunk(MESH_CHUNK_INDICES);
+            const MeshChunk* lodChunk = meshCache.findChunk(MESH_CHUNK_LODS);
+            const MeshChunk* meshletChunk = meshCache.findChunk(MESH_CHUNK_MESHLETS);
+
+            if (vertexChunk != nullptr && indexChunk != nullptr && lodChunk != nullptr && meshletChunk != nullptr &&
+                vertexChunk->elementSize == sizeof(Vertex) && indexChunk->elementSize == sizeof(uint32_t) &&
+                lodChunk->elementSize == sizeof(MeshLod) && meshletChunk->elementSize == sizeof(Meshlet) &&
+                validateCachedLods(lodChunk, indexChunk) && validateCachedMeshlets(meshletChunk, indexChunk)) {
+                modelData.vertices = static_cast<const Vertex*>(vertexChunk->data);
+                modelData.vertexCount = static_cast<uint32_t>(vertexChunk->size / sizeof(Vertex));
+                modelData.indices = static_cast<const uint32_t*>(indexChunk->data);
+                modelData.indexCount = static_cast<uint32_t>(indexChunk->size / sizeof(uint32_t));
+                modelData.lods = static_cast<const MeshLod*>(lodChunk->data);
+                modelData.lodCount = static_cast<uint32_t>(lodChunk->size / sizeof(MeshLod));
+                modelData.meshlets = static_cast<const Meshlet*>(meshletChunk->data);
+                modelData.meshletCount = static_cast<uint32_t>(meshletChunk->size / sizeof(Meshlet));
+
+                std::cout << "Loaded " << MODEL_PATH << " from mesh cache in "
+                          << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count() << " ms\n";
+                return;
             }
+            meshCache.close();
         }
+
+        importModel();
+
+        meshCache.store(MODEL_PATH, {
+            {MESH_CHUNK_VERTICES, sizeof(Vertex), vertices.data(), vertices.size() * sizeof(Vertex)},
+            {MESH_CHUNK_INDICES, sizeof(uint32_t), indices.data(), indices.size() * sizeof(uint32_t)},
+            {MESH_CHUNK_LODS, sizeof(MeshLod), lods.data(), lods.size() * sizeof(MeshLod)},
+            {MESH_CHUNK_MESHLETS, sizeof(Meshlet), meshlets.data(), meshlets.size() * sizeof(Meshlet)}
+        });
+
+        modelData.vertices = vertices.data();
+        modelData.vertexCount = static_cast<uint32_t>(vertices.size());
+        modelData.indices = indices.data();
+        modelData.indexCount = static_cast<uint32_t>(indices.size());
+        modelData.lods = lods.data();
+        modelData.lodCount = static_cast<uint32_t>(lods.size());
+        modelData.meshlets = meshlets.data();
+        modelData.meshletCount = static_cast<uint32_t>(meshlets.size());
+
+        std::cout << "Imported " << MODEL_PATH << " in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count() << " ms\n";
     }
 
-    void TestEngine::createVertexBuffer() {
-        VkDeviceSize bufferSize = sizeof(Vertex) * vertices.size();
+    bool TestEngine::validateCachedLods(const MeshChunk* lodChunk, const MeshChunk* indexChunk) {
+        //a stale or corrupt chunk would draw outside the index buffer, it is treated as a cache miss
+        uint64_t lodCount = lodChunk->size / sizeof(MeshLod);
+        uint64_t indexCount = indexChunk->size / sizeof(uint32_t);
+        if (lodCount == 0 || lodCount > MAX_MESH_LODS) {
+            std::cout << "Mesh cache: " << lodCount << " levels of detail out of range, reimporting\n";
+            return false;
+        }
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                        stagingBuffer, stagingBufferMemory);
+        const MeshLod* cachedLods = static_cast<const MeshLod*>(lodChunk->data);
+        for (uint64_t i = 0; i < lodCount; i++) {
+            if (uint64_t(cachedLods[i].firstIndex) + cachedLods[i].indexCount > indexCount) {
+                std::cout << "Mesh cache: level " << i << " exceeds the index chunk, reimporting\n";
+                return false;
+            }
+        }
+        return true;
+    }
 
-        void* data;
-        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, vertices.data(), (size_t) bufferSize);
-        vkUnmapMemory(device, stagingBufferMemory);
+    bool TestEngine::validateCachedMeshlets(const MeshChunk* meshletChunk, const MeshChunk* indexChunk) {
+        //meshlets become indirect draws of their index range just like levels of detail
+        uint64_t meshletCount = meshletChunk->size / sizeof(Meshlet);
+        uint64_t indexCount = indexChunk->size / sizeof(uint32_t);
+        const Meshlet* cachedMeshlets = static_cast<const Meshlet*>(meshletChunk->data);
+        for (uint64_t i = 0; i < meshletCount; i++) {
+            if (cachedMeshlets[i].indexCount > 3 * MESHLET_MAX_TRIANGLES ||
+                uint64_t(cachedMeshlets[i].firstIndex) + cachedMeshlets[i].indexCount > indexCount) {
+                std::cout << "Mesh cache: meshlet " << i << " exceeds the index chunk or the triangle limit, reimporting\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void TestEngine::importModel() {
+        ObjImporter importer(config.importThreads);
+        importer.import(MODEL_PATH, vertices, indices);
+
+        const ObjImportTimings& timings = importer.getTimings();
+        std::cout << "Parsed " << MODEL_PATH << " on " << importer.getThreadCount() << " threads: parse "
+                  << timings.parseMs << " ms, dedup " << timings.dedupMs << " ms, merge " << timings.mergeMs << " ms\n";
+
+        if (config.meshOptimizeFlags != 0) {
+            uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+            VertexCacheStats before = analyzeVertexCache(indices, vertexCount);
+
+            auto optimizeStart = std::chrono::steady_clock::now();
+            optimizeMesh(vertices, indices, config.meshOptimizeFlags);
+            double optimizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - optimizeStart).count();
+
+            VertexCacheStats after = analyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+            std::cout << "Optimized " << MODEL_PATH << " in " << optimizeMs << " ms: ACMR " << before.acmr << " -> " << after.acmr
+                      << ", ATVR " << before.atvr << " -> " << after.atvr << '\n';
+        }
+
+        //reorders the triangles of the full resolution level, so it has to run before the levels are appended
+        auto meshletStart = std::chrono::steady_clock::now();
+        meshlets = buildMeshlets(vertices, indices);
+        MeshletStats meshletStats = analyzeMeshlets(meshlets);
+        std::cout << "Built " << meshletStats.meshletCount << " meshlets in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - meshletStart).count()
+                  << " ms: vertex fill " << meshletStats.vertexFill << ", triangle fill " << meshletStats.triangleFill << '\n';
+
+        //the levels are appended to indices, after the optimizer so they share its vertex order
+        auto lodStart = std::chrono::steady_clock::now();
+        lods = generateLods(vertices, indices, std::max(config.lodLevels, 1u));
+        std::cout << "Generated " << lods.size() << " levels of detail in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - lodStart).count() << " ms:";
+        for (const MeshLod& lod : lods) {
+            std::cout << ' ' << lod.indexCount / 3;
+        }
+        std::cout << " triangles\n";
+    }
+
+    void TestEngine::releaseModelData() {
+        //the GPU buffers own the geometry now, only the index count is needed for drawing
+        meshCache.close();
+        vertices.clear();
+        vertices.shrink_to_fit();
+        indices.clear();
+        indices.shrink_to_fit();
+        lods.clear();
+        lods.shrink_to_fit();
+        meshlets.clear();
+        meshlets.shrink_to_fit();
+
+        modelData.vertices = nullptr;
+        modelData.indices = nullptr;
+        modelData.lods = nullptr;
+        modelData.meshlets = nullptr;
+    }
+
+    void TestEngine::createVertexBuffer() {
+        //the upload copies into staging memory right away, so the packed copy only has to outlive the call
+        std::vector<PackedVertex> packedVertices;
+        const void* data = modelData.vertices;
+        VkDeviceSize bufferSize = sizeof(Vertex) * modelData.vertexCount;
+
+        if (config.packedVertices) {
+            vertexQuantization = computeVertexQuantization(modelData.vertices, modelData.vertexCount);
+            packVertices(modelData.vertices, modelData.vertexCount, vertexQuantization, packedVertices);
+            data = packedVertices.data();
+            bufferSize = sizeof(PackedVertex) * modelData.vertexCount;
+        }
 
         createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferAllocation);
 
-        copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
+        uploadManager.uploadBuffer(vertexBuffer, data, bufferSize,
+                                   VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        std::cout << "Vertex buffer: " << modelData.vertexCount << " vertices, " << bufferSize << " bytes ("
+                  << (config.packedVertices ? sizeof(PackedVertex) : sizeof(Vertex)) << " bytes per vertex)\n";
     }
 
     void TestEngine::createIndexBuffer() {
-        VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+        std::vector<uint16_t> shortIndices;
+        const void* data = modelData.indices;
+        VkDeviceSize bufferSize = sizeof(uint32_t) * modelData.indexCount;
+        indexType = VK_INDEX_TYPE_UINT32;
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                        stagingBuffer, stagingBufferMemory);
-
-        void* data;
-        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, indices.data(), (size_t) bufferSize);
-        vkUnmapMemory(device, stagingBufferMemory);
+        //0xFFFF is left unused so the buffer stays valid if primitive restart is ever enabled
+        if (modelData.vertexCount < 0xFFFF) {
+            shortIndices.assign(modelData.indices, modelData.indices + modelData.indexCount);
+            data = shortIndices.data();
+            bufferSize = sizeof(uint16_t) * modelData.indexCount;
+            indexType = VK_INDEX_TYPE_UINT16;
+        }
 
         createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                        indexBuffer, indexBufferMemory);
+                        indexBuffer, indexBufferAllocation);
 
-        copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+        uploadManager.uploadBuffer(indexBuffer, data, bufferSize,
+                                   VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        std::cout << "Index buffer: " << modelData.indexCount << " indices, " << bufferSize << " bytes ("
+                  << (indexType == VK_INDEX_TYPE_UINT16 ? "uint16" : "uint32") << ")\n";
     }
 
-    void TestEngine::createUniformBuffers() {
-        VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+    void TestEngine::createScene() {
+        uint32_t mesh = scene.addMesh(modelData.lods, modelData.lodCount, 0, Scene::computeBoundingSphere(modelData.vertices, modelData.vertexCount));
+        for (const glm::mat4& transform : Scene::gridTransforms(config.instanceCount, INSTANCE_SPACING)) {
+            //the material of an instance is the slot of its texture in the bindless table
+            scene.addInstance(mesh, transform, textureId);
+        }
+        scene.buildBatches();
+
+        //draws recorded on the CPU: one per batch, or one per instance without instancing
+        drawList.clear();
+        for (const DrawBatch& batch : scene.getBatches()) {
+            if (config.instancing) {
+                drawList.push_back(batch);
+            } else {
+                for (uint32_t i = 0; i < batch.instanceCount; i++) {
+                    drawList.push_back({batch.mesh, batch.firstInstance + i, 1});
+                }
+            }
+        }
 
-        uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-        uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-        uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+        std::cout << "Scene: " << scene.getInstanceCount() << " instances of " << scene.getMeshes().size() << " meshes with "
+                  << modelData.lodCount << " levels of detail in " << drawList.size() << " draws\n";
+    }
+
+    void TestEngine::createInstanceBuffer() {
+        //at least one element so the buffer is valid for empty scenes
+        VkDeviceSize bufferSize = sizeof(InstanceData) * std::max(scene.getInstanceCount(), 1u);
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                         uniformBuffers[i], uniformBuffersMemory[i]);
-            vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+        //read as vertex attributes by CPU recorded draws and as a storage buffer by the culling pass
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, instanceBuffer, instanceBufferAllocation);
+
+        if (scene.getInstanceCount() > 0) {
+            uploadManager.uploadBuffer(instanceBuffer, scene.getInstanceData().data(), sizeof(InstanceData) * scene.getInstanceCount(),
+                                       VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+                                       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        }
+    }
+
+    void TestEngine::createCullingPass() {
+        if (!config.gpuCulling) {
+            return;
         }
+        if (!capabilities.drawIndirectFirstInstance) {
+            std::cout << "drawIndirectFirstInstance not supported, GPU culling disabled.\n";
+            return;
+        }
+
+        if (config.meshletCulling) {
+            uint64_t meshletDraws = uint64_t(scene.getInstanceCount()) * modelData.meshletCount;
+            if (!capabilities.drawIndirectCount && !capabilities.multiDrawIndirect) {
+                std::cout << "Indirect multi draws not supported, culling whole instances instead of meshlets.\n";
+            } else if (meshletDraws > MeshletPass::MAX_MESHLET_DRAWS) {
+                std::cout << meshletDraws << " meshlet draws exceed " << MeshletPass::MAX_MESHLET_DRAWS
+                          << ", culling whole instances instead of meshlets.\n";
+            } else {
+                meshletPass.init(device, &gpuAllocator, &uploadManager, pipelineCache.get(), capabilities, scene,
+                                 modelData.meshlets, modelData.meshletCount, scene.getMeshes()[0].vertexOffset, instanceBuffer,
+                                 config.framesInFlight);
+                meshletCullingEnabled = true;
+
+                std::cout << "Meshlet culling enabled, " << modelData.meshletCount << " meshlets per instance\n";
+                return;
+            }
+        }
+
+        cullingPass.init(device, &gpuAllocator, &uploadManager, pipelineCache.get(), capabilities, scene, instanceBuffer,
+                         config.framesInFlight);
+        gpuCullingEnabled = true;
+
+        std::cout << "GPU culling enabled, " << (capabilities.drawIndirectCount ? "draw count read from the GPU" : "one indirect command per batch") << '\n';
+    }
+
+    void TestEngine::createUniformBuffers() {
+        uniformRing.init(device, &gpuAllocator, UNIFORM_RING_FRAME_SIZE, capabilities.minUniformBufferOffsetAlignment,
+                         config.framesInFlight);
     }
 
     void TestEngine::createDescriptorPool() {
-        std::array<VkDescriptorPoolSize, 2> poolSizes{};
+        std::array<VkDescriptorPoolSize, 5> poolSizes{};
 
-        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        poolSizes[0].descriptorCount = config.framesInFlight;
         poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        poolSizes[1].descriptorCount = config.framesInFlight;
+        poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[2].descriptorCount = config.framesInFlight;
+        //the texture table of every frame in flight
+        poolSizes[3].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+        poolSizes[3].descriptorCount = config.framesInFlight;
+        poolSizes[4].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        poolSizes[4].descriptorCount = config.framesInFlight * std::max(bindlessCapacity, 1u);
 
         VkDescriptorPoolCreateInfo poolInfo{};
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = bindlessEnabled ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT : 0;
         poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
         poolInfo.pPoolSizes = poolSizes.data();
-        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        poolInfo.maxSets = config.framesInFlight * 2;
 
         if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
             throw std::runtime_error("Runtime error: failed to create descriptor pool.");
@@ -792,29 +1346,30 @@ namespace testengine {
     }
 
     void TestEngine::createDescriptorSets() {
-        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);;
+        std::vector<VkDescriptorSetLayout> layouts(config.framesInFlight, descriptorSetLayout);;
 
         VkDescriptorSetAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
         allocInfo.descriptorPool = descriptorPool;
-        allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        allocInfo.descriptorSetCount = config.framesInFlight;
         allocInfo.pSetLayouts = layouts.data();
 
-        descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+        descriptorSets.resize(config.framesInFlight);
         if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
             throw std::runtime_error("Runtime error: failed to allocate descriptor sets.");
         }
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < config.framesInFlight; i++) {
             VkDescriptorBufferInfo bufferInfo{};
-            bufferInfo.buffer = uniformBuffers[i];
+            //every set views the whole ring, the block is picked by the dynamic offset at bind time
+            bufferInfo.buffer = uniformRing.getBuffer();
             bufferInfo.offset = 0;
             bufferInfo.range = sizeof(UniformBufferObject);
 
-            VkDescriptorImageInfo imageInfo{};
-            imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            imageInfo.imageView = textureImageView;
-            imageInfo.sampler = textureSampler;
+            VkDescriptorBufferInfo feedbackInfo{};
+            feedbackInfo.buffer = textureStreamer.getFeedbackBuffer(static_cast<uint32_t>(i));
+            feedbackInfo.offset = 0;
+            feedbackInfo.range = textureStreamer.getFeedbackSize();
 
             std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
 
@@ -822,24 +1377,56 @@ namespace testengine {
             descriptorWrites[0].dstSet = descriptorSets[i];
             descriptorWrites[0].dstBinding = 0;
             descriptorWrites[0].dstArrayElement = 0;
-            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
             descriptorWrites[0].descriptorCount = 1;
             descriptorWrites[0].pBufferInfo = &bufferInfo;
 
             descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             descriptorWrites[1].dstSet = descriptorSets[i];
-            descriptorWrites[1].dstBinding = 1;
+            descriptorWrites[1].dstBinding = 2;
             descriptorWrites[1].dstArrayElement = 0;
-            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
             descriptorWrites[1].descriptorCount = 1;
-            descriptorWrites[1].pImageInfo = &imageInfo;
+            descriptorWrites[1].pBufferInfo = &feedbackInfo;
 
             vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
         }
+
+        if (bindlessEnabled) {
+            //one table per frame in flight, streamed views change while the previous frame still samples its table
+            std::vector<VkDescriptorSetLayout> bindlessLayouts(config.framesInFlight, bindlessSetLayout);
+            allocInfo.pSetLayouts = bindlessLayouts.data();
+
+            bindlessSets.resize(config.framesInFlight);
+            if (vkAllocateDescriptorSets(device, &allocInfo, bindlessSets.data()) != VK_SUCCESS) {
+                throw std::runtime_error("Runtime error: failed to allocate bindless descriptor sets.");
+            }
+
+            for (size_t i = 0; i < config.framesInFlight; i++) {
+                VkDescriptorImageInfo samplerInfo{};
+                samplerInfo.sampler = textureSampler;
+
+                VkWriteDescriptorSet descriptorWrite{};
+                descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrite.dstSet = bindlessSets[i];
+                descriptorWrite.dstBinding = 0;
+                descriptorWrite.dstArrayElement = 0;
+                descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+                descriptorWrite.descriptorCount = 1;
+                descriptorWrite.pImageInfo = &samplerInfo;
+
+                vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+            }
+        }
+
+        textureDescriptorGenerations.assign(config.framesInFlight, 0);
+        for (size_t i = 0; i < config.framesInFlight; i++) {
+            updateTextureDescriptor(static_cast<uint32_t>(i));
+        }
     }
 
     void TestEngine::createCommandBuffers() {
-        commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        commandBuffers.resize(config.framesInFlight);
 
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -852,26 +1439,82 @@ namespace testengine {
         }
     }
 
+    void TestEngine::createSecondaryCommandBuffers() {
+        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+        uint32_t slotCount = config.framesInFlight * jobSystem.getThreadCount();
+
+        secondaryCommandPools.resize(slotCount);
+        secondaryCommandBuffers.resize(slotCount);
+
+        //one pool per recording thread and frame in flight, reset as a whole before the slot is recorded again
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+        for (uint32_t i = 0; i < slotCount; i++) {
+            if (vkCreateCommandPool(device, &poolInfo, nullptr, &secondaryCommandPools[i]) != VK_SUCCESS) {
+                throw std::runtime_error("Runtime error: failed to create secondary command pool.");
+            }
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = secondaryCommandPools[i];
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount = 1;
+
+            if (vkAllocateCommandBuffers(device, &allocInfo, &secondaryCommandBuffers[i]) != VK_SUCCESS) {
+                throw std::runtime_error("Runtime error: failed to allocate secondary command buffers.");
+            }
+        }
+    }
+
     void TestEngine::createSyncObjects() {
-        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+        imageAvailableSemaphores.resize(config.framesInFlight);
+        renderFinishedSemaphores.resize(config.framesInFlight);
 
         VkSemaphoreCreateInfo semaphoreInfo{};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        VkFenceCreateInfo fenceInfo{};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < config.framesInFlight; i++) {
             if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-                vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-                vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+                vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS) {
                     throw std::runtime_error("Runtime error: failed to create semaphores.");
             }
         }
 
+        frameScheduler.init(device, config.framesInFlight, capabilities.timelineSemaphore);
+        std::cout << config.framesInFlight << " frames in flight, paced by "
+                  << (capabilities.timelineSemaphore ? "a timeline semaphore" : "one fence per frame") << '\n';
+
+        double refreshRate = config.refreshRate;
+        if (refreshRate == 0.0 && !config.headless) {
+            const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+            refreshRate = mode != nullptr ? mode->refreshRate : 0.0;
+        }
+        //headless frames are only held to a display when one was asked for, benchmarks render as fast as possible
+        bool simulatedDisplay = config.headless && (config.refreshRate > 0 || config.framePacing == FRAME_PACING_LOW_LATENCY);
+        framePacer.init(device, config.framePacing, refreshRate, capabilities.presentWait, simulatedDisplay);
+    }
+
+    void TestEngine::createProfiler() {
+        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+        uint32_t validBits = queueFamilies[indices.graphicsFamily.value()].timestampValidBits;
+        if (validBits == 0) {
+            std::cout << "GPU timestamps not supported on the graphics queue, GPU frame times disabled.\n";
+        }
+
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        gpuProfiler.init(device, config.framesInFlight, validBits, properties.limits.timestampPeriod, capabilities.pipelineStatisticsQuery);
+        pendingTimestampFrames.assign(config.framesInFlight, -1);
     }
 
     void TestEngine::updateUniformBuffer(uint32_t currentImage) {
@@ -886,7 +1529,61 @@ namespace testengine {
         ubo.projection = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float) swapChainExtent.height, 0.1f, 10.0f);
         ubo.projection[1][1] *= -1;
 
-        memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+        uniformRing.beginFrame(currentImage);
+        frameUniformOffset = uniformRing.push(ubo);
+        frameUniforms = ubo;
+    }
+
+    void TestEngine::updateTextureDescriptor(uint32_t frame) {
+        //the set of frame is not in use, its previous submission finished
+        if (textureDescriptorGenerations[frame] == textureStreamer.getGeneration()) {
+            return;
+        }
+
+        if (bindlessEnabled) {
+            //only the slots whose view changed since the table was last written
+            uint32_t textureCount = std::min(textureStreamer.getTextureCount(), bindlessCapacity);
+            std::vector<VkDescriptorImageInfo> imageInfos;
+            std::vector<uint32_t> slots;
+            for (uint32_t i = 0; i < textureCount; i++) {
+                if (textureStreamer.getViewGeneration(i) > textureDescriptorGenerations[frame]) {
+                    imageInfos.push_back({VK_NULL_HANDLE, textureStreamer.getImageView(i), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+                    slots.push_back(i);
+                }
+            }
+
+            std::vector<VkWriteDescriptorSet> descriptorWrites(slots.size());
+            for (size_t i = 0; i < slots.size(); i++) {
+                descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[i].dstSet = bindlessSets[frame];
+                descriptorWrites[i].dstBinding = 1;
+                descriptorWrites[i].dstArrayElement = slots[i];
+                descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+                descriptorWrites[i].descriptorCount = 1;
+                descriptorWrites[i].pImageInfo = &imageInfos[i];
+            }
+
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+            textureDescriptorGenerations[frame] = textureStreamer.getGeneration();
+            return;
+        }
+
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = textureStreamer.getImageView(textureId);
+        imageInfo.sampler = textureSampler;
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = descriptorSets[frame];
+        descriptorWrite.dstBinding = 1;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pImageInfo = &imageInfo;
+
+        vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+        textureDescriptorGenerations[frame] = textureStreamer.getGeneration();
     }
 
     void TestEngine::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
@@ -899,6 +1596,26 @@ namespace testengine {
             throw std::runtime_error("Runtime error: failed to begin recording command buffer.");
         }
 
+        //the first scope spans the frame, its time is the GPU frame time
+        gpuProfiler.beginFrame(commandBuffer, currentFrame);
+        uint32_t frameScope = gpuProfiler.beginScope(commandBuffer, "frame");
+
+        float lodScale = computeLodScale();
+        if (meshletCullingEnabled) {
+            //the camera in the space of the instance transforms, where the meshlet cones are tested
+            glm::vec3 cameraPosition = glm::vec3(glm::inverse(frameUniforms.view * frameUniforms.model)[3]);
+            uint32_t cullScope = gpuProfiler.beginScope(commandBuffer, "meshlet culling", true);
+            meshletPass.record(commandBuffer, currentFrame, frameUniforms.projection * frameUniforms.view * frameUniforms.model, cameraPosition);
+            gpuProfiler.endScope(commandBuffer, cullScope);
+        } else if (gpuCullingEnabled) {
+            uint32_t cullScope = gpuProfiler.beginScope(commandBuffer, "culling", true);
+            cullingPass.record(commandBuffer, currentFrame, frameUniforms.projection * frameUniforms.view * frameUniforms.model, lodScale);
+            gpuProfiler.endScope(commandBuffer, cullScope);
+        } else {
+            CpuProfileScope scope(gpuProfiler, "select lods");
+            selectDrawLods(lodScale);
+        }
+
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
         renderPassInfo.renderPass = renderPass;
@@ -913,7 +1630,86 @@ namespace testengine {
         renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
         renderPassInfo.pClearValues = clearValues.data();
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        //short draw lists are cheaper to record inline than to fan out
+        uint32_t recordingThreads = 1;
+        if (!gpuCullingEnabled && !meshletCullingEnabled) {
+            uint32_t useful = static_cast<uint32_t>((drawList.size() + MIN_DRAWS_PER_RECORDING_THREAD - 1) / MIN_DRAWS_PER_RECORDING_THREAD);
+            recordingThreads = std::min(jobSystem.getThreadCount(), useful);
+        }
+
+        uint32_t renderPassScope = gpuProfiler.beginScope(commandBuffer, "render pass", true);
+        if (recordingThreads > 1) {
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            recordSecondaryCommandBuffers(imageIndex, recordingThreads);
+            vkCmdExecuteCommands(commandBuffer, recordingThreads, &secondaryCommandBuffers[currentFrame * jobSystem.getThreadCount()]);
+        } else {
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            recordDrawState(commandBuffer);
+            if (meshletCullingEnabled) {
+                meshletPass.draw(commandBuffer, currentFrame);
+            } else if (gpuCullingEnabled) {
+                cullingPass.draw(commandBuffer, currentFrame);
+            } else {
+                recordDraws(commandBuffer, 0, drawList.size());
+            }
+        }
+        vkCmdEndRenderPass(commandBuffer);
+        gpuProfiler.endScope(commandBuffer, renderPassScope);
+
+        //waiting for the frame on the host does not make the levels the fragment shader wrote visible to readFeedback()
+        VkBufferMemoryBarrier feedbackBarrier{};
+        feedbackBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        feedbackBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        feedbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        feedbackBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        feedbackBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        feedbackBarrier.buffer = textureStreamer.getFeedbackBuffer(currentFrame);
+        feedbackBarrier.offset = 0;
+        feedbackBarrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                             0, 0, nullptr, 1, &feedbackBarrier, 0, nullptr);
+
+        gpuProfiler.endScope(commandBuffer, frameScope);
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to record command buffer.");
+        }
+    }
+
+    void TestEngine::recordSecondaryCommandBuffers(uint32_t imageIndex, uint32_t threadCount) {
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = swapChainFramebuffers[imageIndex];
+        inheritanceInfo.pipelineStatistics = gpuProfiler.getActiveStatistics();
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+        //every thread records a contiguous slice of the draw list with its own pool, so no pool is shared between threads
+        jobSystem.parallelFor(threadCount, [&](uint32_t thread) {
+            TE_TRACE_SCOPE("recordSecondaryCommandBuffer");
+            uint32_t slot = currentFrame * jobSystem.getThreadCount() + thread;
+            vkResetCommandPool(device, secondaryCommandPools[slot], 0);
+
+            VkCommandBuffer commandBuffer = secondaryCommandBuffers[slot];
+            if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+                throw std::runtime_error("Runtime error: failed to begin recording secondary command buffer.");
+            }
+
+            recordDrawState(commandBuffer);
+            recordDraws(commandBuffer, drawList.size() * thread / threadCount, drawList.size() * (thread + 1) / threadCount);
+
+            if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("Runtime error: failed to record secondary command buffer.");
+            }
+        });
+    }
+
+    void TestEngine::recordDrawState(VkCommandBuffer commandBuffer) {
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 
         VkViewport viewport{};
@@ -930,58 +1726,177 @@ namespace testengine {
         scissor.extent = swapChainExtent;
         vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 1, &frameUniformOffset);
+        if (bindlessEnabled) {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &bindlessSets[currentFrame], 0, nullptr);
+        }
 
-        VkBuffer vertexBuffers[] = {vertexBuffer};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+        VkBuffer vertexBuffers[] = {vertexBuffer, instanceBuffer};
+        VkDeviceSize offsets[] = {0, 0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
 
-        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
 
-        vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-        vkCmdEndRenderPass(commandBuffer);
+        if (config.packedVertices) {
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VertexQuantization), &vertexQuantization);
+        }
+    }
 
-        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-            throw std::runtime_error("Runtime error: failed to record command buffer.");
+    void TestEngine::recordDraws(VkCommandBuffer commandBuffer, size_t first, size_t last) {
+        const std::vector<SceneMesh>& meshes = scene.getMeshes();
+        for (size_t i = first; i < last; i++) {
+            const DrawBatch& draw = drawList[i];
+            const SceneMesh& mesh = meshes[draw.mesh];
+            const MeshLod& lod = mesh.lods[drawLods[i]];
+            vkCmdDrawIndexed(commandBuffer, lod.indexCount, draw.instanceCount, lod.firstIndex, mesh.vertexOffset, draw.firstInstance);
+        }
+    }
+
+    float TestEngine::computeLodScale() {
+        //pixels covered by one model unit at unit distance, over the error allowed on screen
+        float pixelsPerUnit = std::abs(frameUniforms.projection[1][1]) * swapChainExtent.height * 0.5f;
+        return pixelsPerUnit / config.lodErrorPixels;
+    }
+
+    void TestEngine::selectDrawLods(float lodScale) {
+        //distances are measured from the near plane in the space of the instance transforms, like in cull.comp
+        glm::vec4 frustumPlanes[6];
+        extractFrustumPlanes(frameUniforms.projection * frameUniforms.view * frameUniforms.model, frustumPlanes);
+        const glm::vec4& nearPlane = frustumPlanes[4];
+
+        const std::vector<SceneMesh>& meshes = scene.getMeshes();
+        const std::vector<InstanceData>& instanceData = scene.getInstanceData();
+        drawLods.resize(drawList.size());
+
+        for (size_t i = 0; i < drawList.size(); i++) {
+            const DrawBatch& draw = drawList[i];
+            const SceneMesh& mesh = meshes[draw.mesh];
+
+            //an instanced draw has one level for all its instances, the one its nearest instance needs
+            float errorScale = 0.0f;
+            for (uint32_t instance = draw.firstInstance; instance < draw.firstInstance + draw.instanceCount; instance++) {
+                const glm::mat4& model = instanceData[instance].model;
+                glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(mesh.boundingSphere), 1.0f));
+                float scale = std::max(std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))), glm::length(glm::vec3(model[2])));
+                float distance = glm::dot(glm::vec3(nearPlane), center) + nearPlane.w - mesh.boundingSphere.w * scale;
+                if (distance <= 0.0f) {
+                    errorScale = std::numeric_limits<float>::infinity();
+                    break;
+                }
+                errorScale = std::max(errorScale, scale * lodScale / distance);
+            }
+
+            drawLods[i] = Scene::selectLod(mesh, errorScale);
+            submittedTriangles += uint64_t(mesh.lods[drawLods[i]].indexCount / 3) * draw.instanceCount;
+            fullResolutionTriangles += uint64_t(mesh.lods[0].indexCount / 3) * draw.instanceCount;
         }
     }
 
     void TestEngine::drawFrame() {
-        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        TE_TRACE_SCOPE("drawFrame");
+        {
+            CpuProfileScope scope(gpuProfiler, "wait");
+            currentFrame = frameScheduler.beginFrame();
+        }
+        uploadManager.collect();
+        textureStreamer.update(currentFrame);
+        updateTextureDescriptor(currentFrame);
+
+        //the scheduler waited for this slot's previous frame, its timestamps are available and this never stalls
+        readFrameTimestamps(currentFrame);
+
+        if (framePacer.isPacing()) {
+            {
+                CpuProfileScope scope(gpuProfiler, "pace");
+                if (framePacer.needsPreviousFrame()) {
+                    frameScheduler.waitForSubmitted();
+                    readFrameTimestamps((currentFrame + config.framesInFlight - 1) % config.framesInFlight);
+                }
+                framePacer.pace(frameCounter);
+            }
 
-        uint32_t imageIndex;
-        VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
-        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-            recreateSwapChain();
-            return;
-        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-            throw std::runtime_error("Runtime error: failed to acquire swap chain image.");
+            //input is sampled after the wait, not before it
+            if (!config.headless) {
+                glfwPollEvents();
+            }
         }
 
-        vkResetFences(device, 1, &inFlightFences[currentFrame]);
+        //cpu time covers everything after the frame wait, i.e. the work the CPU actually does for the frame
+        auto cpuStart = std::chrono::steady_clock::now();
+
+        uint32_t imageIndex;
+        if (config.headless) {
+            framePacer.simulateAcquire(frameCounter, static_cast<uint32_t>(swapChainImages.size()));
+            imageIndex = offscreenImageIndex;
+            offscreenImageIndex = (offscreenImageIndex + 1) % static_cast<uint32_t>(swapChainImages.size());
+        } else {
+            VkResult result;
+            {
+                CpuProfileScope scope(gpuProfiler, "acquire");
+                result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+            }
+            if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+                //nothing was submitted, so the scheduler's values did not move: resources retired on its timeline, like
+                //streamed images replaced in this call, stay alive until a frame submitted after them completed
+                recreateSwapChain();
+                return;
+            } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+                throw std::runtime_error("Runtime error: failed to acquire swap chain image.");
+            }
+        }
 
-        vkResetCommandBuffer(commandBuffers[currentFrame], 0);
-        recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+        //uniforms first, recording derives the culling frustum from them
+        framePacer.beginFrame(frameCounter);
+        {
+            CpuProfileScope scope(gpuProfiler, "update uniforms");
+            updateUniformBuffer(currentFrame);
+        }
 
-        updateUniformBuffer(currentFrame);
+        {
+            CpuProfileScope scope(gpuProfiler, "record");
+            vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+            recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+        }
 
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
+        //offscreen targets are never acquired or presented, so headless frames skip both semaphores
         VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
         VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.waitSemaphoreCount = config.headless ? 0 : 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
         VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.signalSemaphoreCount = config.headless ? 0 : 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
-        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-            throw std::runtime_error("Runtime error: failed to submit draw command buffer");
+        {
+            CpuProfileScope scope(gpuProfiler, "submit");
+            if (frameScheduler.submit(graphicsQueue, submitInfo) != VK_SUCCESS) {
+                throw std::runtime_error("Runtime error: failed to submit draw command buffer");
+            }
+        }
+        gpuProfiler.frameSubmitted(currentFrame);
+        framePacer.frameSubmitted(frameCounter);
+
+        pendingTimestampFrames[currentFrame] = static_cast<int64_t>(frameCounter);
+        if (frameCounter == 0) {
+            std::cout << "First frame submitted " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - launchTime).count()
+                      << " ms after start\n";
+        }
+        frameCounter++;
+
+        if (config.headless) {
+            double cpuTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
+            cpuFrameTimes.push_back(cpuTime);
+            if (!gpuProfiler.hasTimestamps()) {
+                std::cout << "frame " << frameCounter - 1 << ": cpu " << cpuTime << " ms, gpu n/a\n";
+            }
+            return;
         }
 
         VkPresentInfoKHR presentInfo{};
@@ -994,7 +1909,25 @@ namespace testengine {
         presentInfo.pSwapchains = swapChains;
         presentInfo.pImageIndices = &imageIndex;
 
-        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+        //lets the pacer wait for this frame to reach the screen
+        uint64_t frameNumber = frameCounter - 1;
+        uint64_t presentIdValue = framePacer.getPresentId(frameNumber);
+        VkPresentIdKHR presentId{};
+        presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        presentId.swapchainCount = 1;
+        presentId.pPresentIds = &presentIdValue;
+        if (capabilities.presentWait) {
+            presentInfo.pNext = &presentId;
+        }
+
+        VkResult result;
+        {
+            CpuProfileScope scope(gpuProfiler, "present");
+            result = vkQueuePresentKHR(presentQueue, &presentInfo);
+        }
+        if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+            framePacer.framePresented(frameNumber);
+        }
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
             framebufferResized = false;
             recreateSwapChain();
@@ -1002,17 +1935,66 @@ namespace testengine {
             throw std::runtime_error("Runtime error: failed to present swap chain image");
         }
 
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        cpuFrameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuStart).count());
+    }
+
+    void TestEngine::readFrameTimestamps(uint32_t frame) {
+        if (pendingTimestampFrames[frame] < 0) {
+            return;
+        }
+
+        double gpuTime = gpuProfiler.collect(frame, static_cast<uint64_t>(pendingTimestampFrames[frame]));
+        framePacer.frameCompleted(static_cast<uint64_t>(pendingTimestampFrames[frame]), gpuTime);
+        if (gpuTime >= 0.0) {
+            gpuFrameTimes.push_back(gpuTime);
+
+            if (config.headless) {
+                int64_t frameNumber = pendingTimestampFrames[frame];
+                std::cout << "frame " << frameNumber << ": cpu " << cpuFrameTimes[frameNumber] << " ms, gpu " << gpuTime << " ms\n";
+            }
+        }
+
+        pendingTimestampFrames[frame] = -1;
+    }
+
+    void TestEngine::printFrameTimeSummary() {
+        auto printStats = [](const char* name, std::vector<double> times) {
+            if (times.empty()) {
+                std::cout << name << ": n/a\n";
+                return;
+            }
+
+            std::sort(times.begin(), times.end());
+            double total = 0.0;
+            for (double time : times) {
+                total += time;
+            }
+
+            std::cout << name << " (ms): min " << times.front()
+                      << ", avg " << total / times.size()
+                      << ", p50 " << times[times.size() / 2]
+                      << ", p95 " << times[std::min(times.size() - 1, times.size() * 95 / 100)]
+                      << ", max " << times.back() << '\n';
+        };
+
+        if (fullResolutionTriangles > 0 && frameCounter > 0) {
+            std::cout << "\nTriangles per frame: " << submittedTriangles / frameCounter << " of " << fullResolutionTriangles / frameCounter
+                      << " at full resolution (" << 100.0 * double(submittedTriangles) / double(fullResolutionTriangles) << "%)\n";
+        }
+
+        std::cout << "\nFrame time summary over " << frameCounter << " frames:\n";
+        printStats("cpu", cpuFrameTimes);
+        printStats("gpu", gpuFrameTimes);
     }
 
     void TestEngine::cleanupSwapChain() {
         vkDestroyImageView(device, colorImageView, nullptr);
         vkDestroyImage(device, colorImage, nullptr);
-        vkFreeMemory(device, colorImageMemory, nullptr);
+        gpuAllocator.free(colorImageAllocation);
 
         vkDestroyImageView(device, depthImageView, nullptr);
         vkDestroyImage(device, depthImage, nullptr);
-        vkFreeMemory(device, depthImageMemory, nullptr);
+        gpuAllocator.free(depthImageAllocation);
 
         for (auto framebuffer : swapChainFramebuffers) {
             vkDestroyFramebuffer(device, framebuffer, nullptr);
@@ -1022,7 +2004,14 @@ namespace testengine {
             vkDestroyImageView(device, imageView, nullptr);
         }
 
-        vkDestroySwapchainKHR(device, swapChain, nullptr);
+        if (config.headless) {
+            for (size_t i = 0; i < swapChainImages.size(); i++) {
+                vkDestroyImage(device, swapChainImages[i], nullptr);
+                gpuAllocator.free(offscreenImagesAllocations[i]);
+            }
+        } else {
+            vkDestroySwapchainKHR(device, swapChain, nullptr);
+        }
     }
 
     void TestEngine::recreateSwapChain() {
@@ -1033,14 +2022,46 @@ namespace testengine {
             glfwWaitEvents();
         }
 
-        vkDeviceWaitIdle(device);
-
-        cleanupSwapChain();
+        //nothing is waited for: frames in flight finish on the retired swapchain, whose images, views and
+        //framebuffers are destroyed once every frame submitted so far finished. Everything else a frame in flight
+        //may still use has to be retired on frameScheduler as well rather than after a number of drawFrame() calls
+        VkSwapchainKHR oldSwapChain = swapChain;
+        std::vector<VkImageView> oldImageViews = std::move(swapChainImageViews);
+        std::vector<VkFramebuffer> oldFramebuffers = std::move(swapChainFramebuffers);
 
         createSwapChain();
+        frameScheduler.defer([this, oldSwapChain, oldImageViews, oldFramebuffers]() {
+            for (VkFramebuffer framebuffer : oldFramebuffers) {
+                vkDestroyFramebuffer(device, framebuffer, nullptr);
+            }
+            for (VkImageView imageView : oldImageViews) {
+                vkDestroyImageView(device, imageView, nullptr);
+            }
+            vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+        });
         createImageViews();
-        createColorResources();
-        createDepthResources();
+
+        //attachments are only replaced when the new extent does not fit them or wastes most of them
+        VkExtent2D extent = chooseAttachmentExtent(swapChainExtent);
+        if (extent.width != attachmentExtent.width || extent.height != attachmentExtent.height) {
+            frameScheduler.defer([this, colorImage = colorImage, colorImageView = colorImageView, colorImageAllocation = colorImageAllocation,
+                                  depthImage = depthImage, depthImageView = depthImageView, depthImageAllocation = depthImageAllocation]() mutable {
+                vkDestroyImageView(device, colorImageView, nullptr);
+                vkDestroyImage(device, colorImage, nullptr);
+                gpuAllocator.free(colorImageAllocation);
+
+                vkDestroyImageView(device, depthImageView, nullptr);
+                vkDestroyImage(device, depthImage, nullptr);
+                gpuAllocator.free(depthImageAllocation);
+            });
+
+            std::cout << "Attachments reallocated at " << extent.width << 'x' << extent.height << " for a " << swapChainExtent.width << 'x'
+                      << swapChainExtent.height << " swapchain\n";
+            attachmentExtent = extent;
+            createColorResources();
+            createDepthResources();
+        }
+
         createFramebuffers();
     }
 
@@ -1073,6 +2094,14 @@ namespace testengine {
         return true;
     }
 
+    std::vector<const char*> TestEngine::getRequiredDeviceExtensions() {
+        if (config.headless) {
+            return {};
+        }
+
+        return deviceExtensions;
+    }
+
     bool TestEngine::checkDeviceExtensionSupport(VkPhysicalDevice device) {
         uint32_t extensionCount;
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -1080,7 +2109,8 @@ namespace testengine {
         std::vector<VkExtensionProperties> availableExtensions(extensionCount);
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-        std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+        std::vector<const char*> extensions = getRequiredDeviceExtensions();
+        std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
         for (const auto& extension : availableExtensions) {
             requiredExtensions.erase(extension.extensionName);
         }
@@ -1091,8 +2121,8 @@ namespace testengine {
         QueueFamilyIndices indices = findQueueFamilies(device);
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-        bool swapChainAdequate = false;
-        if (extensionsSupported) {
+        bool swapChainAdequate = config.headless;
+        if (extensionsSupported && !config.headless) {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
         }
@@ -1118,8 +2148,13 @@ namespace testengine {
                 indices.graphicsFamily = i;
             }
 
+            //without a surface nothing is presented, the graphics queue stands in for the present queue
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            if (config.headless) {
+                presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+            } else {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            }
             if (presentSupport) {
                 indices.presentFamily = i;
             }
@@ -1131,6 +2166,24 @@ namespace testengine {
             i++;
         }
 
+        //prefer a transfer-only family (usually a DMA engine), then one without graphics, else share the graphics queue
+        int transferScore = -1;
+        for (uint32_t family = 0; family < queueFamilyCount; family++) {
+            VkQueueFlags flags = queueFamilies[family].queueFlags;
+            if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+                continue;
+            }
+
+            int score = (flags & VK_QUEUE_COMPUTE_BIT) ? 1 : 2;
+            if (score > transferScore) {
+                indices.transferFamily = family;
+                transferScore = score;
+            }
+        }
+        if (!indices.transferFamily.has_value()) {
+            indices.transferFamily = indices.graphicsFamily;
+        }
+
         return indices;
     }
 
@@ -1167,6 +2220,11 @@ namespace testengine {
     }
 
     VkPresentModeKHR TestEngine::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
+        //paced frames aim for one refresh each, MAILBOX would let frames replace each other unseen
+        if (config.framePacing == FRAME_PACING_LOW_LATENCY) {
+            return VK_PRESENT_MODE_FIFO_KHR;
+        }
+
         for (const auto& availablePresentMode : availablePresentModes) {
             if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
                 return availablePresentMode;
@@ -1217,49 +2275,46 @@ namespace testengine {
     VkVertexInputBindingDescription TestEngine::getBindingDescription() {
         VkVertexInputBindingDescription bindingDescription{};
         bindingDescription.binding = 0;
-        bindingDescription.stride = sizeof(Vertex);
+        bindingDescription.stride = config.packedVertices ? sizeof(PackedVertex) : sizeof(Vertex);
         bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
         return bindingDescription;
     }
 
-    std::array<VkVertexInputAttributeDescription, 3> TestEngine::getAttributeDescriptions() {
-        std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-
-        attributeDescriptions[0].binding = 0;
-        attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-        attributeDescriptions[1].binding = 0;
-        attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-        attributeDescriptions[2].binding = 0;
-        attributeDescriptions[2].location = 2;
-        attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-        attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
+    VkVertexInputBindingDescription TestEngine::getInstanceBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 1;
+        bindingDescription.stride = sizeof(InstanceData);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
-        return attributeDescriptions;
+        return bindingDescription;
     }
 
-    uint32_t TestEngine::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-        VkPhysicalDeviceMemoryProperties memProperties;
-        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    std::vector<VkVertexInputAttributeDescription> TestEngine::getAttributeDescriptions() {
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 
-        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-            if (typeFilter & (1 << i) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-                return i;
-            }
+        if (config.packedVertices) {
+            //unorm16 and half float vertex formats are mandatory, the w component of the position is unused
+            attributeDescriptions.push_back({0, 0, VK_FORMAT_R16G16B16A16_UNORM, static_cast<uint32_t>(offsetof(PackedVertex, position))});
+            attributeDescriptions.push_back({2, 0, VK_FORMAT_R16G16_SFLOAT, static_cast<uint32_t>(offsetof(PackedVertex, texCoord))});
+        } else {
+            attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, pos))});
+            attributeDescriptions.push_back({1, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, color))});
+            attributeDescriptions.push_back({2, 0, VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, texCoord))});
         }
 
-        throw std::runtime_error("Runtime error: failed to find suitable memory type.");
-    }
+        //a mat4 attribute takes one location per column
+        for (uint32_t column = 0; column < 4; column++) {
+            attributeDescriptions.push_back({3 + column, 1, VK_FORMAT_R32G32B32A32_SFLOAT,
+                                             static_cast<uint32_t>(offsetof(InstanceData, model) + sizeof(glm::vec4) * column)});
+        }
+        attributeDescriptions.push_back({7, 1, VK_FORMAT_R32_UINT, static_cast<uint32_t>(offsetof(InstanceData, material))});
 
+        return attributeDescriptions;
+    }
 
     void TestEngine::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                                    VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+                                    VkBuffer& buffer, GpuAllocation& allocation, GpuAllocationStrategy strategy) {
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
@@ -1273,30 +2328,13 @@ namespace testengine {
         VkMemoryRequirements memRequirements;
         vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-             throw std::runtime_error("Runtime error: failed to allocate buffer memory.");
-        }
-
-        vkBindBufferMemory(device, buffer, bufferMemory, 0);
-    }
-
-    void TestEngine::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-        VkBufferCopy copyRegion{};
-        copyRegion.size = size;
-        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+        allocation = gpuAllocator.allocate(memRequirements, properties, false, strategy);
 
-        endSingleTimeCommands(commandBuffer);
+        vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
     }
 
     void TestEngine::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling,
-                                VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+                                VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, GpuAllocation& allocation) {
 
         VkImageCreateInfo imageInfo{};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1320,16 +2358,14 @@ namespace testengine {
         VkMemoryRequirements memRequirements;
         vkGetImageMemoryRequirements(device, image, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-            throw std::runtime_error("Runtime error: failed to allocate image memory.");
+        //lazily allocated memory is only offered by tilers, everywhere else the image gets plain memory
+        if ((properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) && !gpuAllocator.hasMemoryType(memRequirements.memoryTypeBits, properties)) {
+            properties &= ~VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
         }
 
-        vkBindImageMemory(device, image, imageMemory, 0);
+        allocation = gpuAllocator.allocate(memRequirements, properties, tiling == VK_IMAGE_TILING_OPTIMAL);
+
+        vkBindImageMemory(device, image, allocation.memory, allocation.offset);
     }
 
     VkImageView TestEngine::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels){
@@ -1352,102 +2388,6 @@ namespace testengine {
         return imageView;
     }
 
-    void TestEngine::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-        VkBufferImageCopy region{};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-
-        region.imageOffset = {0, 0, 0};
-        region.imageExtent = {width, height, 1};
-
-        vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-        endSingleTimeCommands(commandBuffer);
-    }
-
-    VkCommandBuffer TestEngine::beginSingleTimeCommands() {
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = commandPool;
-        allocInfo.commandBufferCount = 1;
-
-        VkCommandBuffer commandBuffer;
-        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-        vkBeginCommandBuffer(commandBuffer, &beginInfo);
-        return commandBuffer;
-    }
-
-    void TestEngine::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-        vkEndCommandBuffer(commandBuffer);
-
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-
-        vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(graphicsQueue);
-
-        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-    }
-
-    void TestEngine::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
-        VkPipelineStageFlags sourceStage;
-        VkPipelineStageFlags destinationStage;
-
-
-
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.oldLayout = oldLayout;
-        barrier.newLayout = newLayout;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-        barrier.image = image;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount =  mipLevels;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-
-        if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        } else {
-            throw std::invalid_argument("Invalid argument: unsupported layout transition.");
-        }
-
-        vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-        endSingleTimeCommands(commandBuffer);
-    }
-
     VkFormat TestEngine::findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
         for (VkFormat format : candidates) {
             VkFormatProperties props;
@@ -1472,81 +2412,6 @@ namespace testengine {
         return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
     }
 
-    void TestEngine::generateMipMaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
-        VkFormatProperties formatProperties;
-        vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
-
-        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-            throw std::runtime_error("Runtime error: texture image format does not support liner blitting");
-        }
-
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.image = image;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-        barrier.subresourceRange.levelCount = 1;
-
-        int32_t mipWidth = texWidth;
-        int32_t mipHeight = texHeight;
-
-        for (uint32_t i = 1; i < mipLevels; i++) {
-            barrier.subresourceRange.baseMipLevel = i -1;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-            VkImageBlit blit{};
-            blit.srcOffsets[0] = {0, 0, 0};
-            blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
-            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.srcSubresource.mipLevel = i - 1;
-            blit.srcSubresource.baseArrayLayer = 0;
-            blit.srcSubresource.layerCount = 1;
-
-            blit.dstOffsets[0] = {0, 0, 0};
-            blit.dstOffsets[1] = {mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1};
-            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.dstSubresource.mipLevel = i;
-            blit.dstSubresource.baseArrayLayer = 0;
-            blit.dstSubresource.layerCount = 1;
-
-            vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                           image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
-
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                                 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-            if (mipWidth > 1) mipWidth /= 2;
-            if (mipHeight > 1) mipHeight /= 2;
-        }
-
-        barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                             0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-        endSingleTimeCommands(commandBuffer);
-    }
-
     VkSampleCountFlagBits TestEngine::getMaxUsableSampleCount() {
         VkPhysicalDeviceProperties physicalDeviceProperties;
         vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
@@ -1561,5 +2426,76 @@ namespace testengine {
 
         return VK_SAMPLE_COUNT_1_BIT;
     }
+
+    VkSampleCountFlagBits TestEngine::chooseSampleCount() {
+        VkSampleCountFlagBits maxSamples = getMaxUsableSampleCount();
+
+        //memory and traffic of the attachments at the extent the swapchain is created with, resizes keep the sample count
+        VkExtent2D extent = config.headless ? VkExtent2D{config.width, config.height}
+                                            : chooseSwapExtent(querySwapChainSupport(physicalDevice).capabilities);
+        double pixels = double(extent.width) * extent.height;
+        double depthBytes = findDepthFormat() == VK_FORMAT_D32_SFLOAT_S8_UINT ? 8.0 : 4.0;
+        double refreshRate = config.refreshRate > 0 ? config.refreshRate : 60.0;
+        auto attachmentBytes = [&](uint32_t samples) {
+            return samples > 1 ? pixels * samples * (4.0 + depthBytes) : pixels * depthBytes;
+        };
+        //every sample is written and read back once for the resolve
+        auto attachmentTraffic = [&](uint32_t samples) {
+            return 2.0 * attachmentBytes(samples) * refreshRate / 1e9;
+        };
+
+        uint32_t samples = 1;
+        uint32_t limit = config.msaaSamples > 0 ? config.msaaSamples : MAX_AUTO_MSAA_SAMPLES;
+        for (uint32_t count = 2; count <= limit && count <= uint32_t(maxSamples); count *= 2) {
+            if (!(capabilities.framebufferSampleCounts & count)) {
+                continue;
+            }
+            //transient attachments of tilers never leave tile memory, they cost neither memory nor bandwidth
+            bool withinBudget = capabilities.lazilyAllocatedMemory ||
+                                (attachmentBytes(count) <= config.attachmentMemoryBudget && attachmentTraffic(count) <= config.attachmentBandwidthBudget);
+            if (config.msaaSamples == 0 && !withinBudget) {
+                break;
+            }
+            samples = count;
+        }
+
+        std::cout << "MSAA: " << samples << "x of " << maxSamples << "x supported, " << attachmentBytes(samples) / (1024.0 * 1024.0) << " MiB and "
+                  << attachmentTraffic(samples) << " GB/s of attachments at " << extent.width << 'x' << extent.height;
+        if (config.msaaSamples > 0 && samples != config.msaaSamples) {
+            std::cout << ", lowered from the " << config.msaaSamples << "x requested\n";
+        } else if (config.msaaSamples > 0) {
+            std::cout << " as requested\n";
+        } else if (capabilities.lazilyAllocatedMemory) {
+            std::cout << " kept in tile memory\n";
+        } else {
+            std::cout << " within " << config.attachmentMemoryBudget / (1024 * 1024) << " MiB and " << config.attachmentBandwidthBudget << " GB/s\n";
+        }
+        return static_cast<VkSampleCountFlagBits>(samples);
+    }
+
+    VkDeviceSize TestEngine::getImageMemorySize(VkExtent2D extent, VkSampleCountFlagBits samples, VkFormat format, VkImageUsageFlags usage) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = {extent.width, extent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = usage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.samples = samples;
+
+        VkImage image;
+        if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create image.");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, image, &memRequirements);
+        vkDestroyImage(device, image, nullptr);
+        return memRequirements.size;
+    }
 }
 
@@ -7,39 +7,118 @@
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
-#include <glm/gtx/hash.hpp>
 
+#include <chrono>
 #include <vector>
 #include <optional>
 #include <array>
 #include <string>
 
+#include "cullingpass.hpp"
+#include "devicecapabilities.hpp"
+#include "framepacer.hpp"
+#include "framescheduler.hpp"
+#include "gpuallocator.hpp"
+#include "gpuprofiler.hpp"
+#include "jobsystem.hpp"
+#include "meshcache.hpp"
+#include "meshletpass.hpp"
+#include "meshlets.hpp"
+#include "meshoptimizer.hpp"
+#include "meshsimplifier.hpp"
+#include "pipelinecache.hpp"
+#include "scene.hpp"
+#include "textureimporter.hpp"
+#include "texturestreamer.hpp"
+#include "uniformring.hpp"
+#include "uploadmanager.hpp"
+#include "vertexpacking.hpp"
+#include "vertex.hpp"
+
 namespace testengine {
 
+    struct EngineConfig {
+        bool headless = false;
+        uint32_t width = 800;
+        uint32_t height = 600;
+        //0 runs until the window is closed (or HEADLESS_DEFAULT_FRAMES when headless)
+        uint32_t frameCount = 0;
+        //frames the CPU may record ahead of the GPU, more trade latency for throughput
+        uint32_t framesInFlight = 2;
+        //MSAA samples, 0 picks the most (up to 8) the attachment budgets allow at the initial size, 1 disables MSAA;
+        //counts the device does not support are lowered to the next one it does
+        uint32_t msaaSamples = 0;
+        //memory the MSAA color and depth attachments may take unless they are lazily allocated
+        VkDeviceSize attachmentMemoryBudget = 256ull * 1024 * 1024;
+        //GB/s writing and resolving the MSAA attachments at the refresh rate may take unless they stay in tile memory
+        float attachmentBandwidthBudget = 20.0f;
+        //low latency delays every frame's input sampling until just enough time for the frame is left before the refresh
+        FramePacing framePacing = FRAME_PACING_THROUGHPUT;
+        //Hz of the display frames are paced to, 0 queries the monitor; headless runs present to a simulated display
+        //at this rate when it is set or frames are paced (60 Hz by default), and render as fast as possible otherwise
+        uint32_t refreshRate = 0;
+        //threads used to import models on a mesh cache miss, 0 uses all hardware threads
+        uint32_t importThreads = 0;
+        //MeshOptimizeFlags applied to imported models before they are cached
+        uint32_t meshOptimizeFlags = MESH_OPTIMIZE_ALL;
+        //12 byte quantized vertices instead of 32 byte float vertices
+        bool packedVertices = true;
+        //BC7 textures where the device supports them instead of RGBA8
+        bool compressedTextures = true;
+        //one update after bind array of all textures indexed by the instance's material, falls back to a single
+        //combined image sampler without descriptor indexing
+        bool bindlessTextures = true;
+        //device memory streamed texture levels may occupy, fine levels are evicted beyond it
+        VkDeviceSize textureBudget = 256ull * 1024 * 1024;
+        //levels of detail generated for imported models, 1 always draws the full resolution mesh
+        uint32_t lodLevels = 4;
+        //a level is drawn once its simplification error projects to at most this many pixels
+        float lodErrorPixels = 1.0f;
+        //copies of the model placed on a grid
+        uint32_t instanceCount = 1;
+        //false issues one draw per instance instead of one instanced draw per mesh, for comparison
+        bool instancing = true;
+        //cull instances and build the draws in a compute pass, falls back to CPU recorded draws if unsupported
+        bool gpuCulling = true;
+        //cull the meshlets of every instance instead of whole instances, draws the full resolution level only
+        bool meshletCulling = false;
+        //threads recording draws into secondary command buffers, 0 uses all hardware threads
+        uint32_t recordThreads = 0;
+        //Chrome trace of the most recent profiled CPU and GPU scopes written on exit, empty writes none
+        std::string profileTracePath;
+        //trace of the CPU hot path scopes of every thread streamed to this file while running, empty records none
+        std::string cpuTracePath;
+    };
+
     class TestEngine {
         public:
 
-            struct Vertex {
-                glm::vec3 pos;
-                glm::vec3 color;
-                glm::vec2 texCoord;
+            using Vertex = testengine::Vertex;
 
-                bool operator==(const Vertex& other) const {
-                    return pos == other.pos && color == other.color && texCoord == other.texCoord;
-                }
-            };
+            explicit TestEngine(const EngineConfig& config = EngineConfig{});
 
             void run();
 
         private:
 
-            const uint32_t WIDTH = 800;
-            const uint32_t HEIGHT = 600;
+            const EngineConfig config;
 
-            const std::string MODEL_PATH = "models/viking_room.obj";
-            const std::string TEXTURE_PATH = "textures/viking_room.obj";
+            const uint32_t HEADLESS_DEFAULT_FRAMES = 300;
+            const uint32_t HEADLESS_IMAGE_COUNT = 3;
 
-            const int MAX_FRAMES_IN_FLIGHT = 2;
+            const std::string MODEL_PATH = "models/viking_room.obj";
+            const std::string MESH_CACHE_DIRECTORY = "cache/meshes";
+            const std::string PIPELINE_CACHE_PATH = "cache/pipelines.bin";
+            const std::string TEXTURE_PATH = "textures/viking_room.png";
+            const std::string TEXTURE_ASSET_PATH = "textures/viking_room.ktx2";
+            const std::string TEXTURE_CACHE_PATH = "cache/textures/viking_room.ktx2";
+            const float INSTANCE_SPACING = 1.5f;
+
+            //uniform blocks one frame may push, the ring holds this much per frame in flight
+            const VkDeviceSize UNIFORM_RING_FRAME_SIZE = 1024 * 1024;
+            const size_t MIN_DRAWS_PER_RECORDING_THREAD = 256;
+            //more samples than this are rarely worth their memory and bandwidth, explicit sample counts may exceed it
+            const uint32_t MAX_AUTO_MSAA_SAMPLES = 8;
 
             const std::vector<const char*> validationLayers = {
                 "VK_LAYER_KHRONOS_validation"
@@ -58,6 +137,8 @@ namespace testengine {
             struct QueueFamilyIndices {
                 std::optional<uint32_t> graphicsFamily;
                 std::optional<uint32_t> presentFamily;
+                //falls back to graphicsFamily when the device has no separate transfer family
+                std::optional<uint32_t> transferFamily;
 
                 bool isComplete() {
                     return graphicsFamily.has_value() && presentFamily.has_value();
@@ -73,12 +154,17 @@ namespace testengine {
             GLFWwindow* window;
             VkInstance instance;
             VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+            DeviceCapabilities capabilities;
             VkDevice device;
+            GpuAllocator gpuAllocator;
+            UploadManager uploadManager;
             VkQueue graphicsQueue;
             VkQueue presentQueue;
+            VkQueue transferQueue;
             VkSurfaceKHR surface;
 
-            VkSwapchainKHR swapChain;
+            //retired into the next swapchain on recreation, so it may still be presenting while that one comes up
+            VkSwapchainKHR swapChain = VK_NULL_HANDLE;
             std::vector<VkImage> swapChainImages;
             VkFormat swapChainImageFormat;
             VkExtent2D swapChainExtent;
@@ -93,52 +179,125 @@ namespace testengine {
             VkDescriptorSetLayout descriptorSetLayout;
             VkPipelineLayout pipelineLayout;
             VkPipeline graphicsPipeline;
+            PipelineCache pipelineCache{PIPELINE_CACHE_PATH};
 
             VkCommandPool commandPool;
             std::vector<VkCommandBuffer> commandBuffers;
 
+            JobSystem jobSystem{config.recordThreads};
+            //indexed by frame * recording thread count + thread
+            std::vector<VkCommandPool> secondaryCommandPools;
+            std::vector<VkCommandBuffer> secondaryCommandBuffers;
+
             std::vector<VkSemaphore> imageAvailableSemaphores;
             std::vector<VkSemaphore> renderFinishedSemaphores;
-            std::vector<VkFence> inFlightFences;
+            FrameScheduler frameScheduler;
+            FramePacer framePacer;
 
+            //slot of the frame being recorded, indexes every per frame resource
             uint32_t currentFrame = 0;
             bool framebufferResized = false;
 
+            //headless render targets stand in for the swapchain images
+            std::vector<GpuAllocation> offscreenImagesAllocations;
+            uint32_t offscreenImageIndex = 0;
+
+            GpuProfiler gpuProfiler;
+            //frame number whose GPU scopes every frame slot still has to collect, -1 if none
+            std::vector<int64_t> pendingTimestampFrames;
+            uint64_t frameCounter = 0;
+            //when run() started, the first frame is reported relative to it; the animation starts at the first frame
+            std::chrono::steady_clock::time_point launchTime;
+            std::vector<double> cpuFrameTimes;
+            std::vector<double> gpuFrameTimes;
+
             struct UniformBufferObject {
                 alignas(16) glm::mat4 model;
                 alignas(16) glm::mat4 view;
                 alignas(16) glm::mat4 projection;
             };
 
+            //uniforms of the frame being recorded, the culling pass derives its frustum from them
+            UniformBufferObject frameUniforms{};
+
+            //final model arrays, either views into the mapped mesh cache or into vertices/indices after an import
+            struct ModelData {
+                const Vertex* vertices = nullptr;
+                uint32_t vertexCount = 0;
+                const uint32_t* indices = nullptr;
+                uint32_t indexCount = 0;
+                const MeshLod* lods = nullptr;
+                uint32_t lodCount = 0;
+                //clusters of the full resolution level
+                const Meshlet* meshlets = nullptr;
+                uint32_t meshletCount = 0;
+            };
+
             std::vector<Vertex> vertices;
             std::vector<uint32_t> indices;
+            std::vector<MeshLod> lods;
+            std::vector<Meshlet> meshlets;
+
+            //the level count changes the cached index buffer, so it is part of the import settings
+            MeshCache meshCache{MESH_CACHE_DIRECTORY, config.meshOptimizeFlags | (config.lodLevels << 16)};
+            ModelData modelData;
 
             VkBuffer vertexBuffer;
-            VkDeviceMemory vertexBufferMemory;
+            GpuAllocation vertexBufferAllocation;
             VkBuffer indexBuffer;
-            VkDeviceMemory indexBufferMemory;
-
-            std::vector<VkBuffer> uniformBuffers;
-            std::vector<VkDeviceMemory> uniformBuffersMemory;
-            std::vector<void*> uniformBuffersMapped;
+            GpuAllocation indexBufferAllocation;
+            //uint16 when the model has fewer than 65535 vertices
+            VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+            VertexQuantization vertexQuantization{};
+
+            Scene scene;
+            std::vector<DrawBatch> drawList;
+            //level of detail of every drawList entry for the frame being recorded
+            std::vector<uint32_t> drawLods;
+            uint64_t submittedTriangles = 0;
+            uint64_t fullResolutionTriangles = 0;
+            VkBuffer instanceBuffer;
+            GpuAllocation instanceBufferAllocation;
+
+            CullingPass cullingPass;
+            bool gpuCullingEnabled = false;
+            MeshletPass meshletPass;
+            bool meshletCullingEnabled = false;
+
+            UniformRing uniformRing;
+            //dynamic offset of the frame uniforms of the frame being recorded
+            uint32_t frameUniformOffset = 0;
 
             VkDescriptorPool descriptorPool;
             std::vector<VkDescriptorSet> descriptorSets;
-
-            VkImage textureImage;
-            VkDeviceMemory textureImageMemory;
-            VkImageView textureImageView;
+            //set 1 of the pipeline layout: the shared sampler and every texture, one set per frame in flight
+            //because streamed views change while the previous frame may still sample the old ones
+            VkDescriptorSetLayout bindlessSetLayout = VK_NULL_HANDLE;
+            std::vector<VkDescriptorSet> bindlessSets;
+            bool bindlessEnabled = false;
+            uint32_t bindlessCapacity = 0;
+
+            TextureStreamer textureStreamer;
+            uint32_t textureId = 0;
+            //streamer generation the texture descriptor of every frame was written at
+            std::vector<uint64_t> textureDescriptorGenerations;
             VkSampler textureSampler;
-            uint32_t mipLevels;
+            VkFormat textureFormat = VK_FORMAT_R8G8B8A8_SRGB;
 
             VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
 
-            VkImage colorImage;
-            VkDeviceMemory colorImageMemory;
-            VkImageView colorImageView;
+            //the color and depth attachments may be larger than swapChainExtent, so resizes within it reuse them
+            VkExtent2D attachmentExtent{0, 0};
+            //attachments grow to multiples of this and by at least half their size to need few reallocations while resizing
+            const uint32_t ATTACHMENT_EXTENT_GRANULARITY = 256;
+
+            //multisampled color, none without MSAA
+            VkImage colorImage = VK_NULL_HANDLE;
+            GpuAllocation colorImageAllocation;
+            VkImageView colorImageView = VK_NULL_HANDLE;
 
             VkImage depthImage;
-            VkDeviceMemory depthImageMemory;
+            GpuAllocation depthImageAllocation;
             VkImageView depthImageView;
 
 
@@ -151,36 +310,59 @@ namespace testengine {
             void createInstance();
             void createSurface();
             void pickPhysicalDevice();
+            void queryDeviceCapabilities();
             void createLogicalDevice();
             void createSwapChain();
+            void createOffscreenTargets();
             void createImageViews();
             void createRenderPass();
             void createDescriptorSetLayout();
             void createGraphicsPipeline();
             void createFramebuffers();
             void createCommandPool();
+            void createUploadManager();
             void createColorResources();
             void createDepthResources();
-            void createTextureImage();
-            void createTextureImageView();
+            void printAttachmentMemory();
+            VkExtent2D chooseAttachmentExtent(VkExtent2D extent);
+            void createTextureStreamer();
             void createTextureSampler();
             void loadModel();
+            void importModel();
+            bool validateCachedLods(const MeshChunk* lodChunk, const MeshChunk* indexChunk);
+            bool validateCachedMeshlets(const MeshChunk* meshletChunk, const MeshChunk* indexChunk);
+            void releaseModelData();
             void createVertexBuffer();
             void createIndexBuffer();
+            void createScene();
+            void createInstanceBuffer();
+            void createCullingPass();
             void createUniformBuffers();
             void createDescriptorPool();
             void createDescriptorSets();
             void createCommandBuffers();
+            void createSecondaryCommandBuffers();
             void createSyncObjects();
+            void createProfiler();
 
             void updateUniformBuffer(uint32_t currentImage);
+            void updateTextureDescriptor(uint32_t frame);
             void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+            void recordSecondaryCommandBuffers(uint32_t imageIndex, uint32_t threadCount);
+            void recordDrawState(VkCommandBuffer commandBuffer);
+            void recordDraws(VkCommandBuffer commandBuffer, size_t first, size_t last);
+            float computeLodScale();
+            void selectDrawLods(float lodScale);
             void drawFrame();
 
+            void readFrameTimestamps(uint32_t frame);
+            void printFrameTimeSummary();
+
             void cleanupSwapChain();
             void recreateSwapChain();
 
             bool checkValidationLayerSupport();
+            std::vector<const char*> getRequiredDeviceExtensions();
             bool checkDeviceExtensionSupport(VkPhysicalDevice device);
             bool isDeviceSuitable(VkPhysicalDevice device);
 
@@ -195,45 +377,29 @@ namespace testengine {
 
             static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
 
-            static VkVertexInputBindingDescription getBindingDescription();
-            std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions();
+            VkVertexInputBindingDescription getBindingDescription();
+            static VkVertexInputBindingDescription getInstanceBindingDescription();
+            std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
 
-            uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-            void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-            void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+            void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, GpuAllocation& allocation,
+                              GpuAllocationStrategy strategy = GPU_ALLOCATION_FREE_LIST);
 
             void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling,
-                             VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+                             VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, GpuAllocation& allocation);
 
             VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
 
-            void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-
-            VkCommandBuffer beginSingleTimeCommands();
-            void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-
-            void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
-
             VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
             VkFormat findDepthFormat();
 
             bool hasStencilComponent(VkFormat format);
 
-            void generateMipMaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
 
             VkSampleCountFlagBits getMaxUsableSampleCount();
+            VkSampleCountFlagBits chooseSampleCount();
+            VkDeviceSize getImageMemorySize(VkExtent2D extent, VkSampleCountFlagBits samples, VkFormat format, VkImageUsageFlags usage);
 
 
     };
 }
-
-namespace std {
-    template<> struct hash<testengine::TestEngine::Vertex> {
-        size_t operator()(testengine::TestEngine::Vertex const& vertex) const {
-            return ((hash<glm::vec3>()(vertex.pos) ^
-                    (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-                    (hash<glm::vec2>()(vertex.texCoord) << 1);
-        }
-    };
-}
\ No newline at end of file
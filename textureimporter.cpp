@@ -0,0 +1,628 @@
+#include "textureimporter.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
+namespace testengine {
+
+    namespace {
+
+        //interpolation weights of 4 bit BC7 indices, in 64ths
+        const int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+        const uint32_t BC7_MODE6 = 1u << 6;
+        //least squares refinements after the principal axis fit, later rounds rarely change an index
+        const int BC7_REFINE_ITERATIONS = 2;
+        const int POWER_ITERATIONS = 8;
+
+        struct Bc7Endpoints {
+            //7 bit values, the full endpoint is value << 1 | pBit
+            uint8_t values[2][4];
+            uint8_t pBits[2];
+            uint8_t indices[16];
+            uint32_t error;
+        };
+
+        float srgbToLinear(uint8_t value) {
+            float c = float(value) / 255.0f;
+            return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+
+        uint8_t linearToSrgb(float value) {
+            float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+            return static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+
+        int interpolate(int e0, int e1, int index) {
+            return ((64 - BC7_WEIGHTS[index]) * e0 + BC7_WEIGHTS[index] * e1 + 32) >> 6;
+        }
+
+        //picks the nearest palette entry for every texel and returns the total squared error
+        uint32_t assignIndices(const uint8_t pixels[64], Bc7Endpoints& endpoints) {
+            int palette[16][4];
+            for (int c = 0; c < 4; c++) {
+                int e0 = endpoints.values[0][c] << 1 | endpoints.pBits[0];
+                int e1 = endpoints.values[1][c] << 1 | endpoints.pBits[1];
+                for (int i = 0; i < 16; i++) {
+                    palette[i][c] = interpolate(e0, e1, i);
+                }
+            }
+
+            uint32_t total = 0;
+            for (int texel = 0; texel < 16; texel++) {
+                const uint8_t* pixel = pixels + texel * 4;
+                uint32_t bestError = UINT32_MAX;
+                for (int i = 0; i < 16; i++) {
+                    uint32_t error = 0;
+                    for (int c = 0; c < 4; c++) {
+                        int difference = palette[i][c] - pixel[c];
+                        error += static_cast<uint32_t>(difference * difference);
+                    }
+                    if (error < bestError) {
+                        bestError = error;
+                        endpoints.indices[texel] = static_cast<uint8_t>(i);
+                    }
+                }
+                total += bestError;
+            }
+            endpoints.error = total;
+            return total;
+        }
+
+        //quantizes two float endpoints with every p-bit combination and keeps the best result in best
+        void tryEndpoints(const uint8_t pixels[64], const float ends[2][4], Bc7Endpoints& best) {
+            for (uint8_t p = 0; p < 4; p++) {
+                Bc7Endpoints candidate;
+                for (int e = 0; e < 2; e++) {
+                    candidate.pBits[e] = (p >> e) & 1;
+                    for (int c = 0; c < 4; c++) {
+                        float value = std::round((ends[e][c] - float(candidate.pBits[e])) * 0.5f);
+                        candidate.values[e][c] = static_cast<uint8_t>(std::clamp(value, 0.0f, 127.0f));
+                    }
+                }
+                if (assignIndices(pixels, candidate) < best.error) {
+                    best = candidate;
+                }
+            }
+        }
+
+        void writeBits(uint8_t block[16], uint32_t& position, uint32_t value, uint32_t count) {
+            for (uint32_t i = 0; i < count; i++, position++) {
+                block[position >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (position & 7));
+            }
+        }
+
+        uint32_t readBits(const uint8_t block[16], uint32_t& position, uint32_t count) {
+            uint32_t value = 0;
+            for (uint32_t i = 0; i < count; i++, position++) {
+                value |= uint32_t((block[position >> 3] >> (position & 7)) & 1) << i;
+            }
+            return value;
+        }
+
+        //copies a 4x4 block, repeating the last row and column past the edges of the level
+        void fetchBlock(const uint8_t* level, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t pixels[64]) {
+            for (uint32_t y = 0; y < 4; y++) {
+                uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+                for (uint32_t x = 0; x < 4; x++) {
+                    uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+                    memcpy(pixels + (y * 4 + x) * 4, level + (size_t(sourceY) * width + sourceX) * 4, 4);
+                }
+            }
+        }
+
+        //16 bit linear values keep the darkest sRGB steps apart, the whole chain is filtered at this precision
+        struct LinearTables {
+            uint16_t fromSrgb[256];
+            uint16_t fromUnorm[256];
+            uint8_t toSrgb[65536];
+            uint8_t toUnorm[65536];
+        };
+
+        const LinearTables& getLinearTables() {
+            static const LinearTables* tables = [] {
+                LinearTables* result = new LinearTables;
+                for (int i = 0; i < 256; i++) {
+                    result->fromSrgb[i] = static_cast<uint16_t>(std::lround(srgbToLinear(static_cast<uint8_t>(i)) * 65535.0f));
+                    result->fromUnorm[i] = static_cast<uint16_t>(i * 257);
+                }
+                for (uint32_t i = 0; i < 65536; i++) {
+                    result->toSrgb[i] = linearToSrgb(float(i) / 65535.0f);
+                    result->toUnorm[i] = static_cast<uint8_t>((i * 255 + 32767) / 65535);
+                }
+                return result;
+            }();
+            return *tables;
+        }
+
+        uint16_t average(uint16_t a, uint16_t b) {
+            return static_cast<uint16_t>((uint32_t(a) + b + 1) >> 1);
+        }
+
+        //halves a level of linear RGBA texels by averaging 2x2 blocks, the rounding matches the SIMD averages so
+        //every path gives the same result; a level one texel wide or high is averaged with itself
+        void downsampleLinear(const uint16_t* in, uint32_t inWidth, uint32_t inHeight, uint16_t* out, uint32_t outWidth, uint32_t outHeight) {
+            for (uint32_t y = 0; y < outHeight; y++) {
+                const uint16_t* row0 = in + size_t(std::min(y * 2, inHeight - 1)) * inWidth * 4;
+                const uint16_t* row1 = in + size_t(std::min(y * 2 + 1, inHeight - 1)) * inWidth * 4;
+                uint16_t* outRow = out + size_t(y) * outWidth * 4;
+
+                uint32_t x = 0;
+                //two output texels from four input texels of both rows, 2x + 3 < inWidth as long as x + 1 < outWidth
+                if (inWidth >= 2) {
+#if defined(__SSE2__)
+                    for (; x + 2 <= outWidth; x += 2) {
+                        __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+                        __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 8));
+                        __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+                        __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 8));
+                        __m128i v0 = _mm_avg_epu16(a0, b0);
+                        __m128i v1 = _mm_avg_epu16(a1, b1);
+                        __m128i result = _mm_avg_epu16(_mm_unpacklo_epi64(v0, v1), _mm_unpackhi_epi64(v0, v1));
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(outRow + x * 4), result);
+                    }
+#elif defined(__ARM_NEON)
+                    for (; x + 2 <= outWidth; x += 2) {
+                        uint16x8_t v0 = vrhaddq_u16(vld1q_u16(row0 + x * 8), vld1q_u16(row1 + x * 8));
+                        uint16x8_t v1 = vrhaddq_u16(vld1q_u16(row0 + x * 8 + 8), vld1q_u16(row1 + x * 8 + 8));
+                        uint16x8_t result = vrhaddq_u16(vcombine_u16(vget_low_u16(v0), vget_low_u16(v1)),
+                                                        vcombine_u16(vget_high_u16(v0), vget_high_u16(v1)));
+                        vst1q_u16(outRow + x * 4, result);
+                    }
+#endif
+                }
+
+                for (; x < outWidth; x++) {
+                    uint32_t x0 = std::min(x * 2, inWidth - 1) * 4;
+                    uint32_t x1 = std::min(x * 2 + 1, inWidth - 1) * 4;
+                    for (uint32_t c = 0; c < 4; c++) {
+                        outRow[x * 4 + c] = average(average(row0[x0 + c], row1[x0 + c]), average(row0[x1 + c], row1[x1 + c]));
+                    }
+                }
+            }
+        }
+
+        std::vector<TextureLevel> mipLevels(uint32_t width, uint32_t height, uint32_t texelBytes) {
+            uint32_t levelCount = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+            std::vector<TextureLevel> levels;
+            uint64_t offset = 0;
+            for (uint32_t i = 0; i < levelCount; i++) {
+                uint32_t levelWidth = std::max(1u, width >> i);
+                uint32_t levelHeight = std::max(1u, height >> i);
+                uint64_t size = uint64_t(levelWidth) * levelHeight * texelBytes;
+                levels.push_back({levelWidth, levelHeight, offset, size});
+                offset += size;
+            }
+            return levels;
+        }
+
+        double millisecondsSince(std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    TextureData buildMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, VkFormat format) {
+        TextureData texture;
+        texture.format = format;
+        texture.width = width;
+        texture.height = height;
+        texture.levels = mipLevels(width, height, 4);
+        texture.data.resize(texture.levels.back().offset + texture.levels.back().size);
+        memcpy(texture.data.data(), pixels, texture.levels[0].size);
+
+        const LinearTables& tables = getLinearTables();
+        bool srgb = format == VK_FORMAT_R8G8B8A8_SRGB;
+        const uint16_t* fromColor = srgb ? tables.fromSrgb : tables.fromUnorm;
+        const uint8_t* toColor = srgb ? tables.toSrgb : tables.toUnorm;
+
+        //two linear levels, the one being read and the one being written
+        size_t texelCount = size_t(width) * height;
+        std::vector<uint16_t> linear(texelCount * 4);
+        std::vector<uint16_t> next(texture.levels.size() > 1 ? size_t(texture.levels[1].width) * texture.levels[1].height * 4 : 0);
+        for (size_t i = 0; i < texelCount * 4; i += 4) {
+            linear[i] = fromColor[pixels[i]];
+            linear[i + 1] = fromColor[pixels[i + 1]];
+            linear[i + 2] = fromColor[pixels[i + 2]];
+            //alpha is linear in both formats
+            linear[i + 3] = tables.fromUnorm[pixels[i + 3]];
+        }
+
+        for (size_t i = 1; i < texture.levels.size(); i++) {
+            const TextureLevel& source = texture.levels[i - 1];
+            const TextureLevel& level = texture.levels[i];
+            downsampleLinear(linear.data(), source.width, source.height, next.data(), level.width, level.height);
+
+            uint8_t* out = texture.data.data() + level.offset;
+            for (size_t t = 0; t < size_t(level.width) * level.height * 4; t += 4) {
+                out[t] = toColor[next[t]];
+                out[t + 1] = toColor[next[t + 1]];
+                out[t + 2] = toColor[next[t + 2]];
+                out[t + 3] = tables.toUnorm[next[t + 3]];
+            }
+            linear.swap(next);
+        }
+
+        return texture;
+    }
+
+    TextureData buildMipChainReference(const uint8_t* pixels, uint32_t width, uint32_t height, VkFormat format) {
+        TextureData texture;
+        texture.format = format;
+        texture.width = width;
+        texture.height = height;
+
+        texture.levels = mipLevels(width, height, 4);
+        texture.data.resize(texture.levels.back().offset + texture.levels.back().size);
+        memcpy(texture.data.data(), pixels, texture.levels[0].size);
+
+        bool srgb = format == VK_FORMAT_R8G8B8A8_SRGB;
+        float toLinear[256];
+        for (int i = 0; i < 256; i++) {
+            toLinear[i] = srgb ? srgbToLinear(static_cast<uint8_t>(i)) : float(i) / 255.0f;
+        }
+
+        for (size_t i = 1; i < texture.levels.size(); i++) {
+            const TextureLevel& source = texture.levels[i - 1];
+            const TextureLevel& level = texture.levels[i];
+            const uint8_t* in = texture.data.data() + source.offset;
+            uint8_t* out = texture.data.data() + level.offset;
+
+            for (uint32_t y = 0; y < level.height; y++) {
+                uint32_t y0 = std::min(y * 2, source.height - 1);
+                uint32_t y1 = std::min(y * 2 + 1, source.height - 1);
+                for (uint32_t x = 0; x < level.width; x++) {
+                    uint32_t x0 = std::min(x * 2, source.width - 1);
+                    uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+                    const uint8_t* quad[4] = {
+                        in + (size_t(y0) * source.width + x0) * 4, in + (size_t(y0) * source.width + x1) * 4,
+                        in + (size_t(y1) * source.width + x0) * 4, in + (size_t(y1) * source.width + x1) * 4
+                    };
+
+                    uint8_t* texel = out + (size_t(y) * level.width + x) * 4;
+                    for (int c = 0; c < 3; c++) {
+                        float sum = toLinear[quad[0][c]] + toLinear[quad[1][c]] + toLinear[quad[2][c]] + toLinear[quad[3][c]];
+                        texel[c] = srgb ? linearToSrgb(sum * 0.25f)
+                                        : static_cast<uint8_t>(std::clamp(sum * 0.25f * 255.0f + 0.5f, 0.0f, 255.0f));
+                    }
+                    //alpha is linear in both formats
+                    texel[3] = static_cast<uint8_t>((quad[0][3] + quad[1][3] + quad[2][3] + quad[3][3] + 2) / 4);
+                }
+            }
+        }
+
+        return texture;
+    }
+
+    void encodeBC7Block(const uint8_t pixels[64], uint8_t block[16]) {
+        float mean[4] = {};
+        for (int texel = 0; texel < 16; texel++) {
+            for (int c = 0; c < 4; c++) {
+                mean[c] += float(pixels[texel * 4 + c]) / 16.0f;
+            }
+        }
+
+        float covariance[4][4] = {};
+        float minimum[4] = {255.0f, 255.0f, 255.0f, 255.0f};
+        float maximum[4] = {};
+        for (int texel = 0; texel < 16; texel++) {
+            float offset[4];
+            for (int c = 0; c < 4; c++) {
+                offset[c] = float(pixels[texel * 4 + c]) - mean[c];
+                minimum[c] = std::min(minimum[c], float(pixels[texel * 4 + c]));
+                maximum[c] = std::max(maximum[c], float(pixels[texel * 4 + c]));
+            }
+            for (int a = 0; a < 4; a++) {
+                for (int b = 0; b < 4; b++) {
+                    covariance[a][b] += offset[a] * offset[b];
+                }
+            }
+        }
+
+        //principal axis by power iteration, starting from the extent of the block
+        float axis[4];
+        for (int c = 0; c < 4; c++) {
+            axis[c] = maximum[c] - minimum[c];
+        }
+        for (int iteration = 0; iteration < POWER_ITERATIONS; iteration++) {
+            float next[4] = {};
+            float length = 0.0f;
+            for (int a = 0; a < 4; a++) {
+                for (int b = 0; b < 4; b++) {
+                    next[a] += covariance[a][b] * axis[b];
+                }
+                length = std::max(length, std::fabs(next[a]));
+            }
+            if (length == 0.0f) {
+                break;
+            }
+            for (int c = 0; c < 4; c++) {
+                axis[c] = next[c] / length;
+            }
+        }
+
+        float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3]);
+        float tMinimum = 0.0f;
+        float tMaximum = 0.0f;
+        if (axisLength > 0.0f) {
+            for (int c = 0; c < 4; c++) {
+                axis[c] /= axisLength;
+            }
+            tMinimum = 1e30f;
+            tMaximum = -1e30f;
+            for (int texel = 0; texel < 16; texel++) {
+                float t = 0.0f;
+                for (int c = 0; c < 4; c++) {
+                    t += (float(pixels[texel * 4 + c]) - mean[c]) * axis[c];
+                }
+                tMinimum = std::min(tMinimum, t);
+                tMaximum = std::max(tMaximum, t);
+            }
+        }
+
+        float ends[2][4];
+        for (int c = 0; c < 4; c++) {
+            ends[0][c] = std::clamp(mean[c] + tMinimum * axis[c], 0.0f, 255.0f);
+            ends[1][c] = std::clamp(mean[c] + tMaximum * axis[c], 0.0f, 255.0f);
+        }
+
+        Bc7Endpoints best;
+        best.error = UINT32_MAX;
+        tryEndpoints(pixels, ends, best);
+
+        //solve for the endpoints that best reproduce the texels with the current indices
+        for (int iteration = 0; iteration < BC7_REFINE_ITERATIONS && best.error > 0; iteration++) {
+            float a = 0.0f, b = 0.0f, c = 0.0f;
+            float x0[4] = {}, x1[4] = {};
+            for (int texel = 0; texel < 16; texel++) {
+                float w = float(BC7_WEIGHTS[best.indices[texel]]) / 64.0f;
+                a += (1.0f - w) * (1.0f - w);
+                b += (1.0f - w) * w;
+                c += w * w;
+                for (int channel = 0; channel < 4; channel++) {
+                    x0[channel] += (1.0f - w) * float(pixels[texel * 4 + channel]);
+                    x1[channel] += w * float(pixels[texel * 4 + channel]);
+                }
+            }
+
+            float determinant = a * c - b * b;
+            if (std::fabs(determinant) < 1e-6f) {
+                break;
+            }
+            for (int channel = 0; channel < 4; channel++) {
+                ends[0][channel] = std::clamp((c * x0[channel] - b * x1[channel]) / determinant, 0.0f, 255.0f);
+                ends[1][channel] = std::clamp((a * x1[channel] - b * x0[channel]) / determinant, 0.0f, 255.0f);
+            }
+
+            uint32_t previous = best.error;
+            tryEndpoints(pixels, ends, best);
+            if (best.error == previous) {
+                break;
+            }
+        }
+
+        //the first index is stored with an implicit leading 0, swap the endpoints if it would need it
+        if (best.indices[0] >= 8) {
+            for (int c = 0; c < 4; c++) {
+                std::swap(best.values[0][c], best.values[1][c]);
+            }
+            std::swap(best.pBits[0], best.pBits[1]);
+            for (uint8_t& index : best.indices) {
+                index = static_cast<uint8_t>(15 - index);
+            }
+        }
+
+        memset(block, 0, 16);
+        uint32_t position = 0;
+        writeBits(block, position, BC7_MODE6, 7);
+        for (int c = 0; c < 4; c++) {
+            writeBits(block, position, best.values[0][c], 7);
+            writeBits(block, position, best.values[1][c], 7);
+        }
+        writeBits(block, position, best.pBits[0], 1);
+        writeBits(block, position, best.pBits[1], 1);
+        writeBits(block, position, best.indices[0], 3);
+        for (int texel = 1; texel < 16; texel++) {
+            writeBits(block, position, best.indices[texel], 4);
+        }
+    }
+
+    bool decodeBC7Block(const uint8_t block[16], uint8_t pixels[64]) {
+        uint32_t position = 0;
+        if (readBits(block, position, 7) != BC7_MODE6) {
+            return false;
+        }
+
+        int values[2][4];
+        for (int c = 0; c < 4; c++) {
+            values[0][c] = static_cast<int>(readBits(block, position, 7));
+            values[1][c] = static_cast<int>(readBits(block, position, 7));
+        }
+        int pBits[2];
+        pBits[0] = static_cast<int>(readBits(block, position, 1));
+        pBits[1] = static_cast<int>(readBits(block, position, 1));
+
+        for (int texel = 0; texel < 16; texel++) {
+            int index = static_cast<int>(readBits(block, position, texel == 0 ? 3 : 4));
+            for (int c = 0; c < 4; c++) {
+                pixels[texel * 4 + c] = static_cast<uint8_t>(interpolate(values[0][c] << 1 | pBits[0], values[1][c] << 1 | pBits[1], index));
+            }
+        }
+        return true;
+    }
+
+    TextureData compressBC7(const TextureData& texture, uint32_t threadCount) {
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        TextureData compressed;
+        compressed.format = texture.format == VK_FORMAT_R8G8B8A8_SRGB ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+        compressed.width = texture.width;
+        compressed.height = texture.height;
+        compressed.source = texture.source;
+
+        uint64_t dataSize = 0;
+        for (const TextureLevel& level : texture.levels) {
+            uint64_t size = uint64_t((level.width + 3) / 4) * ((level.height + 3) / 4) * 16;
+            compressed.levels.push_back({level.width, level.height, dataSize, size});
+            dataSize += size;
+        }
+        compressed.data.resize(dataSize);
+
+        for (size_t i = 0; i < texture.levels.size(); i++) {
+            const TextureLevel& source = texture.levels[i];
+            const uint8_t* in = texture.data.data() + source.offset;
+            uint8_t* out = compressed.data.data() + compressed.levels[i].offset;
+            uint32_t blocksX = (source.width + 3) / 4;
+            uint32_t blocksY = (source.height + 3) / 4;
+
+            //bands of block rows, the small levels run on fewer threads
+            uint32_t bands = std::min(threadCount, blocksY);
+            utils::parallelFor(bands, [&](uint32_t band) {
+                uint8_t pixels[64];
+                for (uint32_t y = blocksY * band / bands; y < blocksY * (band + 1) / bands; y++) {
+                    for (uint32_t x = 0; x < blocksX; x++) {
+                        fetchBlock(in, source.width, source.height, x, y, pixels);
+                        encodeBC7Block(pixels, out + (size_t(y) * blocksX + x) * 16);
+                    }
+                }
+            });
+        }
+
+        return compressed;
+    }
+
+    std::string stampTextureSource(const std::string& path) {
+        std::error_code error;
+        uintmax_t size = std::filesystem::file_size(path, error);
+        if (error) {
+            return std::string();
+        }
+        auto mtime = std::filesystem::last_write_time(path, error);
+        if (error) {
+            return std::string();
+        }
+        return std::to_string(size) + ' ' + std::to_string(mtime.time_since_epoch().count());
+    }
+
+    TextureData importTexture(const std::string& path, VkFormat format, uint32_t threadCount) {
+        int width, height, channels;
+        stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        if (!pixels) {
+            throw std::runtime_error("Runtime error: failed to load texture image " + path + ".");
+        }
+
+        bool srgb = format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC7_SRGB_BLOCK;
+        TextureData texture = buildMipChain(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height),
+                                            srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM);
+        stbi_image_free(pixels);
+        texture.source = stampTextureSource(path);
+
+        if (format == VK_FORMAT_BC7_SRGB_BLOCK || format == VK_FORMAT_BC7_UNORM_BLOCK) {
+            return compressBC7(texture, threadCount);
+        }
+        if (format != texture.format) {
+            throw std::runtime_error("Runtime error: textures cannot be imported to the requested format.");
+        }
+        return texture;
+    }
+
+    void bakeTexture(const std::string& imagePath, const std::string& ktx2Path, VkFormat format, uint32_t threadCount) {
+        auto start = std::chrono::steady_clock::now();
+        TextureData texture = importTexture(imagePath, format, threadCount);
+        double importMs = millisecondsSince(start);
+
+        if (!writeKtx2(ktx2Path, texture)) {
+            throw std::runtime_error("Runtime error: failed to write " + ktx2Path + ".");
+        }
+        std::cout << "Baked " << imagePath << " to " << ktx2Path << ": " << texture.levels.size() << " levels, "
+                  << texture.data.size() << " bytes in " << importMs << " ms\n";
+    }
+
+    void reportTextureCompression(const std::string& path, uint32_t threadCount) {
+        auto start = std::chrono::steady_clock::now();
+        TextureData texture = importTexture(path, VK_FORMAT_R8G8B8A8_SRGB, threadCount);
+        double mipMs = millisecondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        TextureData compressed = compressBC7(texture, threadCount);
+        double encodeMs = millisecondsSince(start);
+
+        std::cout << path << ": " << texture.width << "x" << texture.height << ", " << texture.levels.size() << " levels, mips in "
+                  << mipMs << " ms, BC7 encode in " << encodeMs << " ms\n";
+
+        //the same chain through the scalar float filter, decoding is timed out of both
+        int width, height, channels;
+        stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        if (pixels) {
+            start = std::chrono::steady_clock::now();
+            TextureData simd = buildMipChain(pixels, texture.width, texture.height, texture.format);
+            double simdMs = millisecondsSince(start);
+            start = std::chrono::steady_clock::now();
+            TextureData reference = buildMipChainReference(pixels, texture.width, texture.height, texture.format);
+            double referenceMs = millisecondsSince(start);
+            stbi_image_free(pixels);
+
+            int maxDifference = 0;
+            for (size_t i = 0; i < simd.data.size(); i++) {
+                maxDifference = std::max(maxDifference, std::abs(int(simd.data[i]) - int(reference.data[i])));
+            }
+            std::cout << "mip chain: " << simdMs << " ms, reference " << referenceMs << " ms, max difference "
+                      << maxDifference << '\n';
+        }
+        std::cout << std::setw(11) << "level" << std::setw(12) << "RGBA8" << std::setw(12) << "BC7" << std::setw(12) << "PSNR dB\n";
+
+        std::cout << std::fixed << std::setprecision(2);
+        for (size_t i = 0; i < texture.levels.size(); i++) {
+            const TextureLevel& level = texture.levels[i];
+            const uint8_t* original = texture.data.data() + level.offset;
+            const uint8_t* blocks = compressed.data.data() + compressed.levels[i].offset;
+            uint32_t blocksX = (level.width + 3) / 4;
+
+            //RGB only, the alpha of most sources is constant and would flatter the result
+            double squaredError = 0.0;
+            for (uint32_t by = 0; by < (level.height + 3) / 4; by++) {
+                for (uint32_t bx = 0; bx < blocksX; bx++) {
+                    uint8_t decoded[64];
+                    decodeBC7Block(blocks + (size_t(by) * blocksX + bx) * 16, decoded);
+                    for (uint32_t y = 0; y < 4 && by * 4 + y < level.height; y++) {
+                        for (uint32_t x = 0; x < 4 && bx * 4 + x < level.width; x++) {
+                            const uint8_t* texel = original + (size_t(by * 4 + y) * level.width + bx * 4 + x) * 4;
+                            for (int c = 0; c < 3; c++) {
+                                double difference = double(decoded[(y * 4 + x) * 4 + c]) - double(texel[c]);
+                                squaredError += difference * difference;
+                            }
+                        }
+                    }
+                }
+            }
+            double meanError = squaredError / (double(level.width) * level.height * 3.0);
+            double psnr = meanError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanError) : 99.0;
+
+            std::cout << std::setw(5) << i << std::setw(6) << level.width << std::setw(12) << level.size
+                      << std::setw(12) << compressed.levels[i].size << std::setw(11) << psnr << '\n';
+        }
+
+        std::cout << "total: RGBA8 " << texture.data.size() << " bytes, BC7 " << compressed.data.size() << " bytes ("
+                  << double(texture.data.size()) / double(compressed.data.size()) << "x smaller)\n";
+        std::cout.unsetf(std::ios::fixed);
+        std::cout << std::setprecision(6);
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <string>
+
+#include "ktx2file.hpp"
+
+namespace testengine {
+
+    //RGBA8 texture with the full mip chain of a tightly packed width x height image, every level averages 2x2
+    //texels of the previous one; for sRGB data the average is taken in linear space so mips do not darken.
+    //The chain is filtered as 16 bit linear values with SSE2/NEON and only rounded to 8 bits per stored level.
+    TextureData buildMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, VkFormat format);
+    //scalar float version of buildMipChain that filters every level from the rounded previous one, for comparison
+    TextureData buildMipChainReference(const uint8_t* pixels, uint32_t width, uint32_t height, VkFormat format);
+
+    //BC7 mode 6 (one subset, 7 bit RGBA endpoints with a p-bit each and 4 bit indices) for a 4x4 block of RGBA8
+    //texels in row order. Endpoints are fitted along the principal axis of the block's colors and refined by least
+    //squares; every encoding is deterministic.
+    void encodeBC7Block(const uint8_t pixels[64], uint8_t block[16]);
+    //decodes a block written by encodeBC7Block, false for any mode other than 6
+    bool decodeBC7Block(const uint8_t block[16], uint8_t pixels[64]);
+
+    //encodes every level of an RGBA8 texture, edge blocks repeat the last row/column; blocks are split over threads
+    TextureData compressBC7(const TextureData& texture, uint32_t threadCount);
+
+    //size and modification time of path, stored in imported textures to detect a changed source
+    std::string stampTextureSource(const std::string& path);
+
+    //decodes an image file, builds its mips and encodes them to format (BC7 or RGBA8, sRGB or not)
+    TextureData importTexture(const std::string& path, VkFormat format, uint32_t threadCount);
+
+    //imports imagePath offline and writes it with all of its mips to a KTX2 file the engine loads as is
+    void bakeTexture(const std::string& imagePath, const std::string& ktx2Path, VkFormat format, uint32_t threadCount);
+
+    //imports path as RGBA8 and BC7 and prints size, encode time and PSNR of every level
+    void reportTextureCompression(const std::string& path, uint32_t threadCount);
+}
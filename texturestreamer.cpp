@@ -0,0 +1,381 @@
+#include "texturestreamer.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace testengine {
+
+    namespace {
+
+        const int32_t NO_FEEDBACK = std::numeric_limits<int32_t>::max();
+        //base level recorded for textures drawn with the placeholder, their feedback says nothing about the texture
+        const uint32_t PLACEHOLDER_LEVEL = UINT32_MAX;
+    }
+
+    void TextureStreamer::init(VkDevice device, GpuAllocator* allocator, UploadManager* uploadManager, FrameScheduler* frameScheduler,
+                               VkDeviceSize budget, uint32_t framesInFlight, bool feedback) {
+        this->device = device;
+        this->allocator = allocator;
+        this->uploadManager = uploadManager;
+        this->frameScheduler = frameScheduler;
+        this->budget = budget;
+        this->feedback = feedback;
+
+        frames.resize(framesInFlight);
+        for (FrameResources& frame : frames) {
+            VkBufferCreateInfo bufferInfo{};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = getFeedbackSize();
+            bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            if (vkCreateBuffer(device, &bufferInfo, nullptr, &frame.feedback) != VK_SUCCESS) {
+                throw std::runtime_error("Runtime error: failed to create texture feedback buffer.");
+            }
+
+            VkMemoryRequirements requirements;
+            vkGetBufferMemoryRequirements(device, frame.feedback, &requirements);
+            frame.feedbackAllocation = allocator->allocate(requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, false);
+            vkBindBufferMemory(device, frame.feedback, frame.feedbackAllocation.memory, frame.feedbackAllocation.offset);
+
+            std::fill_n(static_cast<int32_t*>(frame.feedbackAllocation.mapped), MAX_TEXTURES, NO_FEEDBACK);
+        }
+
+        TextureData grey;
+        grey.format = VK_FORMAT_R8G8B8A8_UNORM;
+        grey.width = 1;
+        grey.height = 1;
+        grey.levels.push_back({1, 1, 0, 4});
+        grey.data = {128, 128, 128, 255};
+        createResidentImage(grey, 0, placeholder);
+        uploadManager->uploadImageLevels(placeholder.image, grey);
+
+        loaderThread = std::thread(&TextureStreamer::loaderLoop, this);
+    }
+
+    void TextureStreamer::destroy() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        loadRequested.notify_all();
+        if (loaderThread.joinable()) {
+            loaderThread.join();
+        }
+
+        //the caller waited for the device, nothing is in use anymore
+        for (Texture& texture : textures) {
+            if (texture.hasResident) {
+                destroyResidentImage(texture.resident);
+            }
+            if (texture.pendingBatch != 0) {
+                destroyResidentImage(texture.pending);
+            }
+        }
+        textures.clear();
+        for (RetiredImage& image : retired) {
+            destroyResidentImage(image.image);
+        }
+        retired.clear();
+        destroyResidentImage(placeholder);
+
+        for (FrameResources& frame : frames) {
+            vkDestroyBuffer(device, frame.feedback, nullptr);
+            allocator->free(frame.feedbackAllocation);
+        }
+        frames.clear();
+    }
+
+    uint32_t TextureStreamer::add(std::function<TextureData()> loader) {
+        if (textures.size() >= MAX_TEXTURES) {
+            throw std::runtime_error("Runtime error: too many streamed textures.");
+        }
+
+        uint32_t id = static_cast<uint32_t>(textures.size());
+        textures.emplace_back();
+        //the placeholder view is new to descriptors as well
+        textures.back().viewGeneration = ++generation;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            loadQueue.emplace_back(id, std::move(loader));
+        }
+        loadRequested.notify_one();
+        return id;
+    }
+
+    void TextureStreamer::update(uint32_t frame) {
+        TE_TRACE_SCOPE("TextureStreamer::update");
+
+        //frames that were not submitted, e.g. because the swapchain was out of date, do not count towards retirement
+        uint64_t completed = frameScheduler->getCompletedValue();
+        while (!retired.empty() && retired.front().value <= completed) {
+            residentBytes -= retired.front().image.allocation.size;
+            destroyResidentImage(retired.front().image);
+            retired.pop_front();
+        }
+
+        collectLoads();
+        readFeedback(frame);
+        finishLevelChanges();
+        startLevelChanges();
+
+        FrameResources& resources = frames[frame];
+        resources.baseLevels.resize(textures.size());
+        for (size_t i = 0; i < textures.size(); i++) {
+            resources.baseLevels[i] = textures[i].hasResident ? textures[i].resident.level : PLACEHOLDER_LEVEL;
+        }
+    }
+
+    VkImageView TextureStreamer::getImageView(uint32_t id) const {
+        const Texture& texture = textures[id];
+        return texture.hasResident ? texture.resident.view : placeholder.view;
+    }
+
+    void TextureStreamer::printStats() const {
+        std::cout << "Texture streaming: " << textures.size() << " textures, " << residentBytes << " of " << budget << " budget bytes resident, "
+                  << levelChanges << " level changes, " << uploadedBytes << " bytes uploaded\n";
+        for (size_t i = 0; i < textures.size(); i++) {
+            const Texture& texture = textures[i];
+            if (texture.hasResident) {
+                const TextureLevel& level = texture.data.levels[texture.resident.level];
+                std::cout << "  texture " << i << ": level " << texture.resident.level << " (" << level.width << "x" << level.height
+                          << ") of " << texture.levelCount << " resident, level " << texture.wantedLevel << " wanted\n";
+            } else {
+                std::cout << "  texture " << i << ": not loaded\n";
+            }
+        }
+    }
+
+    void TextureStreamer::loaderLoop() {
+        while (true) {
+            std::pair<uint32_t, std::function<TextureData()>> request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                loadRequested.wait(lock, [this] { return stopping || !loadQueue.empty(); });
+                if (stopping) {
+                    return;
+                }
+                request = std::move(loadQueue.front());
+                loadQueue.pop_front();
+            }
+
+            try {
+                TE_TRACE_SCOPE("TextureStreamer::load");
+                TextureData data = request.second();
+                std::lock_guard<std::mutex> lock(mutex);
+                loadedTextures.push_back({request.first, std::move(data)});
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!loadError) {
+                    loadError = std::current_exception();
+                }
+            }
+        }
+    }
+
+    void TextureStreamer::collectLoads() {
+        std::vector<LoadedTexture> loaded;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (loadError) {
+                std::rethrow_exception(loadError);
+            }
+            loaded.swap(loadedTextures);
+        }
+
+        for (LoadedTexture& result : loaded) {
+            Texture& texture = textures[result.id];
+            texture.data = std::move(result.data);
+            texture.levelCount = static_cast<uint32_t>(texture.data.levels.size());
+            if (texture.levelCount == 0) {
+                throw std::runtime_error("Runtime error: streamed texture without levels.");
+            }
+
+            texture.tailLevel = texture.levelCount - 1;
+            while (texture.tailLevel > 0 && std::max(texture.data.levels[texture.tailLevel - 1].width,
+                                                     texture.data.levels[texture.tailLevel - 1].height) <= MIP_TAIL_SIZE) {
+                texture.tailLevel--;
+            }
+            texture.wantedLevel = feedback ? texture.tailLevel : 0;
+            texture.loaded = true;
+        }
+    }
+
+    void TextureStreamer::readFeedback(uint32_t frame) {
+        FrameResources& resources = frames[frame];
+        int32_t* minLevels = static_cast<int32_t*>(resources.feedbackAllocation.mapped);
+
+        if (feedback) {
+            for (size_t i = 0; i < resources.baseLevels.size(); i++) {
+                Texture& texture = textures[i];
+                if (resources.baseLevels[i] == PLACEHOLDER_LEVEL) {
+                    continue;
+                }
+                //not sampled at all, only the mip tail is needed until it shows up again
+                if (minLevels[i] == NO_FEEDBACK) {
+                    texture.wantedLevel = texture.tailLevel;
+                    continue;
+                }
+                int64_t level = int64_t(resources.baseLevels[i]) + minLevels[i];
+                texture.wantedLevel = static_cast<uint32_t>(std::clamp<int64_t>(level, 0, texture.tailLevel));
+            }
+        }
+
+        std::fill_n(minLevels, MAX_TEXTURES, NO_FEEDBACK);
+    }
+
+    void TextureStreamer::finishLevelChanges() {
+        for (Texture& texture : textures) {
+            if (texture.pendingBatch == 0 || !uploadManager->isComplete(texture.pendingBatch)) {
+                continue;
+            }
+
+            if (texture.hasResident) {
+                //the frame being recorded already samples the new image, only frames submitted so far use the old one
+                retired.push_back({texture.resident, frameScheduler->getSubmittedValue()});
+            }
+            texture.resident = texture.pending;
+            texture.hasResident = true;
+            texture.pending = {};
+            texture.pendingBatch = 0;
+            texture.viewGeneration = ++generation;
+        }
+    }
+
+    void TextureStreamer::startLevelChanges() {
+        VkDeviceSize uploadBytes = 0;
+        bool started = false;
+
+        for (Texture& texture : textures) {
+            if (!texture.loaded || texture.pendingBatch != 0) {
+                continue;
+            }
+
+            //the mip tail goes up at once, then one finer level per update
+            uint32_t level;
+            if (!texture.hasResident) {
+                level = texture.tailLevel;
+            } else if (texture.wantedLevel < texture.resident.level) {
+                level = texture.resident.level - 1;
+            } else {
+                continue;
+            }
+
+            VkDeviceSize size = residentSize(texture, level);
+            if (started && uploadBytes + size > MAX_UPLOAD_BYTES_PER_UPDATE) {
+                break;
+            }
+
+            if (texture.hasResident && residentBytes + size > budget) {
+                //evicts a level of the texture with the most levels it does not need; the refinement waits until
+                //the evicted image was retired and its memory is free again
+                Texture* victim = nullptr;
+                for (Texture& other : textures) {
+                    if (&other == &texture || !other.hasResident || other.pendingBatch != 0 || other.resident.level >= other.wantedLevel) {
+                        continue;
+                    }
+                    if (!victim || other.wantedLevel - other.resident.level > victim->wantedLevel - victim->resident.level) {
+                        victim = &other;
+                    }
+                }
+                if (victim && startLevelChange(*victim, victim->resident.level + 1)) {
+                    uploadBytes += residentSize(*victim, victim->pending.level);
+                    started = true;
+                }
+                continue;
+            }
+
+            if (startLevelChange(texture, level)) {
+                uploadBytes += size;
+                started = true;
+            }
+        }
+
+        if (started) {
+            uint64_t batch = uploadManager->submit();
+            for (Texture& texture : textures) {
+                if (texture.pendingBatch == UINT64_MAX) {
+                    texture.pendingBatch = batch;
+                }
+            }
+        }
+    }
+
+    VkDeviceSize TextureStreamer::residentSize(const Texture& texture, uint32_t level) {
+        const TextureLevel& finest = texture.data.levels[level];
+        const TextureLevel& coarsest = texture.data.levels.back();
+        //levels are packed finest first
+        return coarsest.offset + coarsest.size - finest.offset;
+    }
+
+    bool TextureStreamer::startLevelChange(Texture& texture, uint32_t level) {
+        if (level > texture.tailLevel) {
+            return false;
+        }
+
+        createResidentImage(texture.data, level, texture.pending);
+        uploadManager->uploadImageLevels(texture.pending.image, texture.data, level);
+        //set to the submitted batch by startLevelChanges()
+        texture.pendingBatch = UINT64_MAX;
+
+        residentBytes += texture.pending.allocation.size;
+        uploadedBytes += residentSize(texture, level);
+        levelChanges++;
+        return true;
+    }
+
+    void TextureStreamer::createResidentImage(const TextureData& data, uint32_t level, ResidentImage& image) {
+        const TextureLevel& finest = data.levels[level];
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = finest.width;
+        imageInfo.extent.height = finest.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = static_cast<uint32_t>(data.levels.size()) - level;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = data.format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+
+        if (vkCreateImage(device, &imageInfo, nullptr, &image.image) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create streamed texture image.");
+        }
+
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(device, image.image, &requirements);
+        image.allocation = allocator->allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true);
+        vkBindImageMemory(device, image.image, image.allocation.memory, image.allocation.offset);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = data.format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = imageInfo.mipLevels;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(device, &viewInfo, nullptr, &image.view) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create streamed texture image view.");
+        }
+
+        image.level = level;
+    }
+
+    void TextureStreamer::destroyResidentImage(ResidentImage& image) {
+        vkDestroyImageView(device, image.view, nullptr);
+        vkDestroyImage(device, image.image, nullptr);
+        allocator->free(image.allocation);
+        image = {};
+    }
+}
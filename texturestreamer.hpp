@@ -0,0 +1,147 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "framescheduler.hpp"
+#include "gpuallocator.hpp"
+#include "ktx2file.hpp"
+#include "uploadmanager.hpp"
+
+namespace testengine {
+
+    //Streams textures in over several frames so that startup never waits for image data. add() returns at once
+    //and the texture shows a 1x1 placeholder until a background thread loaded it; then its mip tail goes up
+    //first and finer levels follow one per update, each as a new image holding only the resident levels, which is
+    //swapped in once its upload finished. Levels finer than the one the fragment shader last sampled are not
+    //loaded, and fine levels of textures that need them least are evicted to stay inside the memory budget.
+    //Feedback comes from a per frame storage buffer in which the fragment shader keeps the finest level it wanted.
+    class TextureStreamer {
+        public:
+            TextureStreamer() = default;
+            TextureStreamer(const TextureStreamer&) = delete;
+            TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+            static constexpr uint32_t MAX_TEXTURES = 4096;
+            //levels no larger than this are uploaded as soon as a texture is loaded and never evicted
+            static constexpr uint32_t MIP_TAIL_SIZE = 64;
+
+            //without feedback every texture is streamed up to level 0 as far as the budget allows; replaced images are
+            //freed once frameScheduler reached every frame submitted before they were replaced
+            void init(VkDevice device, GpuAllocator* allocator, UploadManager* uploadManager, FrameScheduler* frameScheduler,
+                      VkDeviceSize budget, uint32_t framesInFlight, bool feedback);
+            void destroy();
+
+            //loader runs on the streaming thread and returns every level of the texture, exceptions are rethrown by update()
+            uint32_t add(std::function<TextureData()> loader);
+
+            //call once the previous use of frame finished on the GPU and before recording it: reads back the levels
+            //wanted in that frame, frees replaced images no frame uses anymore, swaps in finished uploads and starts
+            //the next level changes
+            void update(uint32_t frame);
+
+            //valid until the next update(), placeholder until the texture is loaded
+            VkImageView getImageView(uint32_t id) const;
+            //changes whenever an image view changed, descriptors written at another generation are stale
+            uint64_t getGeneration() const { return generation; }
+            //generation at which the view of texture id last changed
+            uint64_t getViewGeneration(uint32_t id) const { return textures[id].viewGeneration; }
+            uint32_t getTextureCount() const { return static_cast<uint32_t>(textures.size()); }
+            //one int32_t per texture, cleared to INT32_MAX by update()
+            VkBuffer getFeedbackBuffer(uint32_t frame) const { return frames[frame].feedback; }
+            VkDeviceSize getFeedbackSize() const { return sizeof(int32_t) * MAX_TEXTURES; }
+
+            VkDeviceSize getResidentBytes() const { return residentBytes; }
+            void printStats() const;
+
+        private:
+            //upper bound for level changes started per update, one change is always allowed
+            static constexpr VkDeviceSize MAX_UPLOAD_BYTES_PER_UPDATE = 8ull * 1024 * 1024;
+
+            struct ResidentImage {
+                VkImage image = VK_NULL_HANDLE;
+                GpuAllocation allocation;
+                VkImageView view = VK_NULL_HANDLE;
+                //finest texture level in the image, its level 0
+                uint32_t level = 0;
+            };
+
+            struct Texture {
+                //every level in host memory once loaded, evicted levels are uploaded again from here
+                TextureData data;
+                bool loaded = false;
+                uint32_t levelCount = 0;
+                uint32_t tailLevel = 0;
+
+                ResidentImage resident;
+                bool hasResident = false;
+                ResidentImage pending;
+                uint64_t pendingBatch = 0;
+
+                //finest level the feedback asked for
+                uint32_t wantedLevel = 0;
+                uint64_t viewGeneration = 0;
+            };
+
+            struct FrameResources {
+                VkBuffer feedback = VK_NULL_HANDLE;
+                GpuAllocation feedbackAllocation;
+                //resident level of every texture when the frame was recorded, the shader reports relative to it
+                std::vector<uint32_t> baseLevels;
+            };
+
+            struct RetiredImage {
+                ResidentImage image;
+                //scheduler value of the last frame that may still sample the image
+                uint64_t value;
+            };
+
+            struct LoadedTexture {
+                uint32_t id;
+                TextureData data;
+            };
+
+            VkDevice device = VK_NULL_HANDLE;
+            GpuAllocator* allocator = nullptr;
+            UploadManager* uploadManager = nullptr;
+            FrameScheduler* frameScheduler = nullptr;
+            VkDeviceSize budget = 0;
+            bool feedback = false;
+
+            std::vector<Texture> textures;
+            std::vector<FrameResources> frames;
+            std::deque<RetiredImage> retired;
+            ResidentImage placeholder;
+
+            uint64_t generation = 1;
+            VkDeviceSize residentBytes = 0;
+            uint64_t uploadedBytes = 0;
+            uint32_t levelChanges = 0;
+
+            std::thread loaderThread;
+            std::mutex mutex;
+            std::condition_variable loadRequested;
+            std::deque<std::pair<uint32_t, std::function<TextureData()>>> loadQueue;
+            std::vector<LoadedTexture> loadedTextures;
+            std::exception_ptr loadError;
+            bool stopping = false;
+
+            void loaderLoop();
+            void collectLoads();
+            void readFeedback(uint32_t frame);
+            void finishLevelChanges();
+            void startLevelChanges();
+
+            static VkDeviceSize residentSize(const Texture& texture, uint32_t level);
+            bool startLevelChange(Texture& texture, uint32_t level);
+            void createResidentImage(const TextureData& data, uint32_t level, ResidentImage& image);
+            void destroyResidentImage(ResidentImage& image);
+    };
+}
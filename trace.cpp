@@ -0,0 +1,283 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace testengine {
+
+    std::atomic<bool> traceActive{false};
+
+    namespace {
+
+        //events per thread, a power of two; 384 KiB per thread that ever recorded a scope
+        const uint64_t RING_SIZE = 1 << 14;
+        const std::chrono::milliseconds FLUSH_INTERVAL(10);
+        //time stamp counter ticks are measured against the steady clock for at least this long before the trace starts
+        const std::chrono::milliseconds CALIBRATION_TIME(2);
+        //scopes opened per iteration of the benchmark, inside each other
+        const uint64_t BENCH_DEPTH = 4;
+
+        struct TraceEventRecord {
+            const char* name;
+            uint64_t start;
+            uint64_t end;
+        };
+
+        //written only by its thread at head, read only by the writer thread at tail
+        struct ThreadRing {
+            uint32_t threadIndex = 0;
+            alignas(64) std::atomic<uint64_t> head{0};
+            alignas(64) std::atomic<uint64_t> tail{0};
+            std::atomic<uint64_t> dropped{0};
+            TraceEventRecord events[RING_SIZE];
+        };
+
+        struct Tracer {
+            //guards rings and the file, taken by the writer and the first event of every thread
+            std::mutex mutex;
+            //never freed, threads keep a pointer to their ring for their whole lifetime
+            std::vector<std::unique_ptr<ThreadRing>> rings;
+            size_t namedRings = 0;
+
+            std::thread writer;
+            std::condition_variable wakeWriter;
+            bool stopping = false;
+
+            std::string path;
+            std::ofstream file;
+            uint64_t writtenEvents = 0;
+
+            uint64_t startTicks = 0;
+            std::chrono::steady_clock::time_point startTime;
+            double ticksPerMicrosecond = 1000.0;
+
+            //a trace still running at exit, e.g. because an exception skipped stopTrace(), is finished here: a
+            //joinable writer would call std::terminate
+            ~Tracer() {
+                traceActive.store(false);
+                finish();
+            }
+
+            //joins the writer, which drains the rings once more, and closes the file
+            void finish() {
+                if (writer.joinable()) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        stopping = true;
+                    }
+                    wakeWriter.notify_one();
+                    writer.join();
+                }
+                if (file.is_open()) {
+                    file << "\n]}\n";
+                    file.close();
+                }
+            }
+        };
+
+        Tracer& getTracer() {
+            static Tracer tracer;
+            return tracer;
+        }
+
+        thread_local ThreadRing* threadRing = nullptr;
+
+        ThreadRing* registerThread() {
+            Tracer& tracer = getTracer();
+            std::lock_guard<std::mutex> lock(tracer.mutex);
+            tracer.rings.push_back(std::make_unique<ThreadRing>());
+            tracer.rings.back()->threadIndex = static_cast<uint32_t>(tracer.rings.size() - 1);
+            threadRing = tracer.rings.back().get();
+            return threadRing;
+        }
+
+        void calibrate(Tracer& tracer) {
+#if defined(__x86_64__) || defined(__i386__)
+            double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - tracer.startTime).count();
+            if (elapsed > 0.0) {
+                tracer.ticksPerMicrosecond = static_cast<double>(traceTimestamp() - tracer.startTicks) / elapsed;
+            }
+#else
+            (void) tracer;
+#endif
+        }
+
+        double toMicroseconds(const Tracer& tracer, uint64_t ticks) {
+            return ticks > tracer.startTicks ? static_cast<double>(ticks - tracer.startTicks) / tracer.ticksPerMicrosecond : 0.0;
+        }
+
+        //called with the mutex held
+        void drainRings(Tracer& tracer) {
+            calibrate(tracer);
+
+            for (; tracer.namedRings < tracer.rings.size(); tracer.namedRings++) {
+                tracer.file << (tracer.writtenEvents++ > 0 ? ",\n" : "") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+                            << tracer.namedRings << ",\"args\":{\"name\":\"thread " << tracer.namedRings << "\"}}";
+            }
+
+            for (const std::unique_ptr<ThreadRing>& ring : tracer.rings) {
+                uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+                uint64_t head = ring->head.load(std::memory_order_acquire);
+                for (; tail < head; tail++) {
+                    const TraceEventRecord& event = ring->events[tail & (RING_SIZE - 1)];
+                    double start = toMicroseconds(tracer, event.start);
+                    double end = toMicroseconds(tracer, event.end);
+                    tracer.file << (tracer.writtenEvents++ > 0 ? ",\n" : "") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+                                << ring->threadIndex << ",\"ts\":" << start << ",\"dur\":" << (end > start ? end - start : 0.0) << '}';
+                }
+                ring->tail.store(head, std::memory_order_release);
+            }
+        }
+
+        void writerLoop() {
+            Tracer& tracer = getTracer();
+            std::unique_lock<std::mutex> lock(tracer.mutex);
+            while (true) {
+                tracer.wakeWriter.wait_for(lock, FLUSH_INTERVAL, [&tracer] { return tracer.stopping; });
+                drainRings(tracer);
+                if (tracer.stopping) {
+                    return;
+                }
+            }
+        }
+    }
+
+    void startTrace(const std::string& path) {
+        Tracer& tracer = getTracer();
+        if (traceActive.load()) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(tracer.mutex);
+            tracer.file.open(path, std::ios::trunc);
+            if (!tracer.file) {
+                throw std::runtime_error("Runtime error: failed to open " + path + " for writing.");
+            }
+            tracer.file << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+            tracer.path = path;
+            tracer.writtenEvents = 0;
+            tracer.namedRings = 0;
+            tracer.stopping = false;
+
+            //scopes that ended after the previous trace stopped are not part of this one
+            for (const std::unique_ptr<ThreadRing>& ring : tracer.rings) {
+                ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_release);
+                ring->dropped.store(0, std::memory_order_relaxed);
+            }
+
+            tracer.startTime = std::chrono::steady_clock::now();
+            tracer.startTicks = traceTimestamp();
+        }
+
+#if defined(__x86_64__) || defined(__i386__)
+        std::this_thread::sleep_for(CALIBRATION_TIME);
+        calibrate(tracer);
+#endif
+
+        tracer.writer = std::thread(writerLoop);
+        traceActive.store(true);
+    }
+
+    void stopTrace() {
+        Tracer& tracer = getTracer();
+        if (!traceActive.exchange(false)) {
+            return;
+        }
+
+        tracer.finish();
+
+        uint64_t dropped = 0;
+        for (const std::unique_ptr<ThreadRing>& ring : tracer.rings) {
+            dropped += ring->dropped.load(std::memory_order_relaxed);
+        }
+
+        std::cout << "CPU trace with " << tracer.writtenEvents - tracer.namedRings << " events from " << tracer.namedRings << " threads written to "
+                  << tracer.path << " (" << dropped << " dropped)\n";
+    }
+
+    namespace {
+
+        //returns the median ns per scope over batches that fit into half a ring; while a trace runs, the ring is
+        //drained between batches so that no event is dropped, dropping is cheaper than recording. The median keeps
+        //batches the writer thread preempted, e.g. on a single core, from skewing the result
+        double timeNestedScopes(uint64_t scopes) {
+            const uint64_t batch = RING_SIZE / 2 / BENCH_DEPTH;
+            uint64_t iterations = std::max<uint64_t>(scopes / BENCH_DEPTH, 1);
+            std::vector<double> batchTimes;
+
+            for (uint64_t done = 0; done < iterations;) {
+                uint64_t count = std::min(batch, iterations - done);
+                auto start = std::chrono::steady_clock::now();
+                for (uint64_t i = 0; i < count; i++) {
+                    TE_TRACE_SCOPE("bench 0");
+                    {
+                        TE_TRACE_SCOPE("bench 1");
+                        {
+                            TE_TRACE_SCOPE("bench 2");
+                            {
+                                TE_TRACE_SCOPE("bench 3");
+                            }
+                        }
+                    }
+                }
+                batchTimes.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                                     static_cast<double>(count * BENCH_DEPTH));
+                done += count;
+
+                while (traceActive.load() && threadRing != nullptr &&
+                       threadRing->tail.load(std::memory_order_acquire) < threadRing->head.load(std::memory_order_relaxed)) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+
+            std::nth_element(batchTimes.begin(), batchTimes.begin() + batchTimes.size() / 2, batchTimes.end());
+            return batchTimes[batchTimes.size() / 2];
+        }
+    }
+
+    void benchmarkTraceScopes(const std::string& path, uint64_t scopes) {
+#if !TE_TRACE_ENABLED
+        std::cout << "TE_TRACE_ENABLED is 0, every TE_TRACE_SCOPE is compiled out\n";
+#endif
+        //the first pass of each mode warms up the caches and, while tracing, the ring of this thread
+        timeNestedScopes(scopes);
+        std::cout << "TE_TRACE_SCOPE without a trace: " << timeNestedScopes(scopes) << " ns per scope\n";
+
+        startTrace(path);
+        timeNestedScopes(scopes);
+        double traced = timeNestedScopes(scopes);
+        stopTrace();
+        std::cout << "TE_TRACE_SCOPE while tracing: " << traced << " ns per scope\n";
+
+        //a traced scope reads the timestamp twice, which bounds its cost from below
+        const uint64_t timestamps = 1000000;
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < timestamps; i++) {
+            traceTimestamp();
+        }
+        double timestampTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / timestamps;
+        std::cout << "traceTimestamp(): " << timestampTime << " ns\n";
+    }
+
+    void recordTraceEvent(const char* name, uint64_t start, uint64_t end) {
+        ThreadRing* ring = threadRing != nullptr ? threadRing : registerThread();
+
+        uint64_t head = ring->head.load(std::memory_order_relaxed);
+        if (head - ring->tail.load(std::memory_order_acquire) >= RING_SIZE) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        ring->events[head & (RING_SIZE - 1)] = {name, start, end};
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+//0 compiles every TE_TRACE_SCOPE out, otherwise scopes cost one relaxed load while no trace is running
+#ifndef TE_TRACE_ENABLED
+    #define TE_TRACE_ENABLED 1
+#endif
+
+namespace testengine {
+
+    //Hot path CPU tracing: every thread writes fixed size events into its own single producer ring, which a
+    //background thread drains into a file in the Chrome trace event format. Recording never locks or allocates
+    //after the first event of a thread; events are dropped and counted when a ring is full.
+
+    //starts recording the scopes of every thread into path, no-op if a trace is already running
+    void startTrace(const std::string& path);
+    //stops recording, writes the events still in the rings and closes the file; a trace still running at exit is
+    //finished the same way, without the summary
+    void stopTrace();
+
+    //prints the cost of a TE_TRACE_SCOPE without a trace running and while one is written into path, measured over
+    //scopes scopes nested a few deep, and the cost of the timestamp it reads twice
+    void benchmarkTraceScopes(const std::string& path, uint64_t scopes);
+
+    extern std::atomic<bool> traceActive;
+
+    //time stamp counter where available, converted to microseconds by the writer thread
+    inline uint64_t traceTimestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    //name has to outlive the trace, string literals do
+    void recordTraceEvent(const char* name, uint64_t start, uint64_t end);
+
+    class TraceScope {
+        public:
+            explicit TraceScope(const char* name) {
+                if (traceActive.load(std::memory_order_relaxed)) {
+                    this->name = name;
+                    start = traceTimestamp();
+                }
+            }
+            ~TraceScope() {
+                if (name != nullptr) {
+                    recordTraceEvent(name, start, traceTimestamp());
+                }
+            }
+
+            TraceScope(const TraceScope&) = delete;
+            TraceScope& operator=(const TraceScope&) = delete;
+
+        private:
+            const char* name = nullptr;
+            uint64_t start = 0;
+    };
+}
+
+#if TE_TRACE_ENABLED
+    #define TE_TRACE_CONCAT_INNER(a, b) a##b
+    #define TE_TRACE_CONCAT(a, b) TE_TRACE_CONCAT_INNER(a, b)
+    //traces the rest of the enclosing block
+    #define TE_TRACE_SCOPE(name) ::testengine::TraceScope TE_TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+    #define TE_TRACE_SCOPE(name) ((void)0)
+#endif
@@ -0,0 +1,62 @@
+#include "uniformring.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace testengine {
+
+    namespace {
+
+        VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+            return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+        }
+    }
+
+    void UniformRing::init(VkDevice device, GpuAllocator* allocator, VkDeviceSize frameCapacity, VkDeviceSize alignment, uint32_t framesInFlight) {
+        this->device = device;
+        this->allocator = allocator;
+        this->alignment = std::max<VkDeviceSize>(alignment, 1);
+        this->frameCapacity = alignUp(frameCapacity, this->alignment);
+
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = this->frameCapacity * framesInFlight;
+        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create uniform ring.");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+        allocation = allocator->allocate(memRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, false);
+        vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+    }
+
+    void UniformRing::destroy() {
+        vkDestroyBuffer(device, buffer, nullptr);
+        allocator->free(allocation);
+        buffer = VK_NULL_HANDLE;
+        frameStart = 0;
+        head = 0;
+    }
+
+    void UniformRing::beginFrame(uint32_t frame) {
+        peakUsed = std::max(peakUsed, head.load() - frameStart);
+        frameStart = frameCapacity * frame;
+        head = frameStart;
+    }
+
+    uint32_t UniformRing::push(const void* data, VkDeviceSize size) {
+        VkDeviceSize offset = head.fetch_add(alignUp(size, alignment));
+        if (offset + size > frameStart + frameCapacity) {
+            throw std::runtime_error("Runtime error: uniform ring frame capacity exceeded.");
+        }
+
+        memcpy(static_cast<uint8_t*>(allocation.mapped) + offset, data, static_cast<size_t>(size));
+        return static_cast<uint32_t>(offset);
+    }
+}
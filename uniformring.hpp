@@ -0,0 +1,49 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <atomic>
+#include <cstdint>
+
+#include "gpuallocator.hpp"
+
+namespace testengine {
+
+    //One persistently mapped uniform buffer split into a region per frame in flight. Every uniform block of a
+    //frame is copied to the head of its region and bound through a dynamic offset, so a block costs a memcpy
+    //and an offset instead of a buffer and descriptor set of its own. The region of a frame is reused as a
+    //whole by beginFrame() once the previous submission of that frame finished on the GPU.
+    class UniformRing {
+        public:
+            UniformRing() = default;
+            UniformRing(const UniformRing&) = delete;
+            UniformRing& operator=(const UniformRing&) = delete;
+
+            //alignment is minUniformBufferOffsetAlignment, every block starts on a multiple of it
+            void init(VkDevice device, GpuAllocator* allocator, VkDeviceSize frameCapacity, VkDeviceSize alignment, uint32_t framesInFlight);
+            void destroy();
+
+            void beginFrame(uint32_t frame);
+
+            //copies size bytes into the current frame and returns their dynamic offset, may be called from any thread
+            uint32_t push(const void* data, VkDeviceSize size);
+            template<typename T>
+            uint32_t push(const T& block) { return push(&block, sizeof(T)); }
+
+            VkBuffer getBuffer() const { return buffer; }
+            VkDeviceSize getFrameCapacity() const { return frameCapacity; }
+            //most bytes any frame used, alignment padding included
+            VkDeviceSize getPeakUsed() const { return peakUsed; }
+
+        private:
+            VkDevice device = VK_NULL_HANDLE;
+            GpuAllocator* allocator = nullptr;
+            VkBuffer buffer = VK_NULL_HANDLE;
+            GpuAllocation allocation;
+            VkDeviceSize frameCapacity = 0;
+            VkDeviceSize alignment = 1;
+
+            VkDeviceSize frameStart = 0;
+            std::atomic<VkDeviceSize> head{0};
+            VkDeviceSize peakUsed = 0;
+    };
+}
@@ -0,0 +1,344 @@
+#include "uploadmanager.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace testengine {
+
+    void UploadManager::init(VkDevice device, GpuAllocator* allocator, uint32_t graphicsFamily, VkQueue graphicsQueue,
+                             uint32_t transferFamily, VkQueue transferQueue, VkDeviceSize stagingSize) {
+        this->device = device;
+        this->graphicsFamily = graphicsFamily;
+        this->graphicsQueue = graphicsQueue;
+        this->transferFamily = transferFamily;
+        this->transferQueue = transferQueue;
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = graphicsFamily;
+
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &graphicsPool) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create upload command pool.");
+        }
+
+        if (hasDedicatedTransferQueue()) {
+            poolInfo.queueFamilyIndex = transferFamily;
+            if (vkCreateCommandPool(device, &poolInfo, nullptr, &transferPool) != VK_SUCCESS) {
+                throw std::runtime_error("Runtime error: failed to create upload command pool.");
+            }
+        }
+
+        stagingRing.init(device, allocator, stagingSize);
+    }
+
+    void UploadManager::destroy() {
+        if (isRecording) {
+            //recorded but never submitted, nothing on the GPU references it
+            vkEndCommandBuffer(recording.graphicsCommands);
+            if (hasDedicatedTransferQueue()) {
+                vkEndCommandBuffer(recording.transferCommands);
+            }
+            releaseBatch(recording);
+            isRecording = false;
+        }
+
+        while (!inFlight.empty()) {
+            vkWaitForFences(device, 1, &inFlight.front().fence, VK_TRUE, UINT64_MAX);
+            releaseBatch(inFlight.front());
+            inFlight.pop_front();
+        }
+
+        stagingRing.destroy();
+
+        vkDestroyCommandPool(device, graphicsPool, nullptr);
+        if (transferPool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(device, transferPool, nullptr);
+        }
+    }
+
+    void UploadManager::uploadBuffer(VkBuffer buffer, const void* data, VkDeviceSize size,
+                                     VkAccessFlags dstAccess, VkPipelineStageFlags dstStage) {
+        VkDeviceSize copied = 0;
+        while (copied < size) {
+            VkDeviceSize offset;
+            VkDeviceSize chunkSize = reserveStaging(size - copied, 1, offset);
+            memcpy(stagingRing.getMapped() + offset, static_cast<const uint8_t*>(data) + copied, static_cast<size_t>(chunkSize));
+
+            VkBufferCopy copyRegion{};
+            copyRegion.srcOffset = offset;
+            copyRegion.dstOffset = copied;
+            copyRegion.size = chunkSize;
+            vkCmdCopyBuffer(recording.transferCommands, stagingRing.getBuffer(), buffer, 1, &copyRegion);
+
+            copied += chunkSize;
+        }
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+
+        if (hasDedicatedTransferQueue()) {
+            //release on the transfer queue, the matching acquire on the graphics queue makes the data visible
+            barrier.srcQueueFamilyIndex = transferFamily;
+            barrier.dstQueueFamilyIndex = graphicsFamily;
+            barrier.dstAccessMask = 0;
+            vkCmdPipelineBarrier(recording.transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = dstAccess;
+            vkCmdPipelineBarrier(recording.graphicsCommands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage,
+                                 0, 0, nullptr, 1, &barrier, 0, nullptr);
+        } else {
+            vkCmdPipelineBarrier(recording.graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage,
+                                 0, 0, nullptr, 1, &barrier, 0, nullptr);
+        }
+    }
+
+    uint64_t UploadManager::submit() {
+        TE_TRACE_SCOPE("UploadManager::submit");
+        if (!isRecording) {
+            return 0;
+        }
+
+        Batch batch = recording;
+        isRecording = false;
+        recording = {};
+
+        if (vkEndCommandBuffer(batch.graphicsCommands) != VK_SUCCESS ||
+            (hasDedicatedTransferQueue() && vkEndCommandBuffer(batch.transferCommands) != VK_SUCCESS)) {
+            throw std::runtime_error("Runtime error: failed to record upload command buffer.");
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(device, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to create upload fence.");
+        }
+
+        VkSubmitInfo graphicsSubmit{};
+        graphicsSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        graphicsSubmit.commandBufferCount = 1;
+        graphicsSubmit.pCommandBuffers = &batch.graphicsCommands;
+
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        if (hasDedicatedTransferQueue()) {
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &batch.transferComplete) != VK_SUCCESS) {
+                throw std::runtime_error("Runtime error: failed to create upload semaphore.");
+            }
+
+            VkSubmitInfo transferSubmit{};
+            transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            transferSubmit.commandBufferCount = 1;
+            transferSubmit.pCommandBuffers = &batch.transferCommands;
+            transferSubmit.signalSemaphoreCount = 1;
+            transferSubmit.pSignalSemaphores = &batch.transferComplete;
+
+            if (vkQueueSubmit(transferQueue, 1, &transferSubmit, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("Runtime error: failed to submit uploads.");
+            }
+
+            graphicsSubmit.waitSemaphoreCount = 1;
+            graphicsSubmit.pWaitSemaphores = &batch.transferComplete;
+            graphicsSubmit.pWaitDstStageMask = &waitStage;
+        }
+
+        //later graphics submissions are ordered after this one, so rendering needs no host side wait
+        if (vkQueueSubmit(graphicsQueue, 1, &graphicsSubmit, batch.fence) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to submit uploads.");
+        }
+
+        stagingRing.close(batch.id);
+        inFlight.push_back(std::move(batch));
+        return inFlight.back().id;
+    }
+
+    void UploadManager::collect() {
+        //batches end on the graphics queue, so they finish in submission order
+        while (!inFlight.empty() && vkGetFenceStatus(device, inFlight.front().fence) == VK_SUCCESS) {
+            completedBatchId = inFlight.front().id;
+            releaseBatch(inFlight.front());
+            inFlight.pop_front();
+        }
+    }
+
+    bool UploadManager::isComplete(uint64_t batchId) {
+        collect();
+        return batchId <= completedBatchId;
+    }
+
+    void UploadManager::wait(uint64_t batchId) {
+        while (!inFlight.empty() && inFlight.front().id <= batchId) {
+            vkWaitForFences(device, 1, &inFlight.front().fence, VK_TRUE, UINT64_MAX);
+            completedBatchId = inFlight.front().id;
+            releaseBatch(inFlight.front());
+            inFlight.pop_front();
+        }
+    }
+
+    void UploadManager::beginBatch() {
+        if (isRecording) {
+            return;
+        }
+
+        recording.id = nextBatchId++;
+        recording.graphicsCommands = allocateCommandBuffer(graphicsPool);
+        recording.transferCommands = hasDedicatedTransferQueue() ? allocateCommandBuffer(transferPool) : recording.graphicsCommands;
+        isRecording = true;
+    }
+
+    VkCommandBuffer UploadManager::allocateCommandBuffer(VkCommandPool pool) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = pool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Runtime error: failed to allocate upload command buffer.");
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        return commandBuffer;
+    }
+
+    VkDeviceSize UploadManager::reserveStaging(VkDeviceSize size, VkDeviceSize granularity, VkDeviceSize& offset) {
+        VkDeviceSize minimum = std::min(size, std::max(granularity, MIN_CHUNK_SIZE / granularity * granularity));
+        if (minimum > stagingRing.getCapacity()) {
+            throw std::runtime_error("Runtime error: upload row does not fit into the staging ring.");
+        }
+
+        //the oldest batch frees the oldest part of the ring, if the batch being recorded holds it, submit it first
+        while (stagingRing.largestFree(STAGING_ALIGNMENT) < minimum) {
+            if (inFlight.empty()) {
+                submit();
+            }
+            wait(inFlight.front().id);
+        }
+
+        VkDeviceSize chunkSize = std::min(size, stagingRing.largestFree(STAGING_ALIGNMENT) / granularity * granularity);
+        stagingRing.reserve(chunkSize, STAGING_ALIGNMENT, offset);
+
+        beginBatch();
+        return chunkSize;
+    }
+
+    void UploadManager::releaseBatch(Batch& batch) {
+        stagingRing.release(batch.id);
+
+        vkFreeCommandBuffers(device, graphicsPool, 1, &batch.graphicsCommands);
+        if (hasDedicatedTransferQueue()) {
+            vkFreeCommandBuffers(device, transferPool, 1, &batch.transferCommands);
+        }
+
+        if (batch.transferComplete != VK_NULL_HANDLE) {
+            vkDestroySemaphore(device, batch.transferComplete, nullptr);
+        }
+        if (batch.fence != VK_NULL_HANDLE) {
+            vkDestroyFence(device, batch.fence, nullptr);
+        }
+        batch = {};
+    }
+
+    void UploadManager::uploadImageLevels(VkImage image, const TextureData& texture, uint32_t firstLevel) {
+        uint32_t blockWidth, blockHeight, blockBytes;
+        if (!getFormatBlock(texture.format, blockWidth, blockHeight, blockBytes)) {
+            throw std::runtime_error("Runtime error: unsupported texture format for upload.");
+        }
+        uint32_t levelCount = static_cast<uint32_t>(texture.levels.size()) - firstLevel;
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = levelCount;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        bool firstCopy = true;
+        for (uint32_t level = 0; level < levelCount; level++) {
+            const TextureLevel& levelData = texture.levels[firstLevel + level];
+            const uint8_t* data = texture.data.data() + levelData.offset;
+
+            //levels are split into bands of whole block rows, data is tightly packed
+            uint32_t blockRows = (levelData.height + blockHeight - 1) / blockHeight;
+            VkDeviceSize rowSize = levelData.size / blockRows;
+            uint32_t row = 0;
+            while (row < blockRows) {
+                VkDeviceSize offset;
+                VkDeviceSize chunkSize = reserveStaging((blockRows - row) * rowSize, rowSize, offset);
+                uint32_t rows = static_cast<uint32_t>(chunkSize / rowSize);
+                memcpy(stagingRing.getMapped() + offset, data + row * rowSize, static_cast<size_t>(chunkSize));
+
+                if (firstCopy) {
+                    vkCmdPipelineBarrier(recording.transferCommands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+                    firstCopy = false;
+                }
+
+                VkBufferImageCopy region{};
+                region.bufferOffset = offset;
+                region.bufferRowLength = 0;
+                region.bufferImageHeight = 0;
+                region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.mipLevel = level;
+                region.imageSubresource.baseArrayLayer = 0;
+                region.imageSubresource.layerCount = 1;
+                //the last band may end in a partial block row, the extent stops at the edge of the level
+                uint32_t y = row * blockHeight;
+                region.imageOffset = {0, static_cast<int32_t>(y), 0};
+                region.imageExtent = {levelData.width, std::min(rows * blockHeight, levelData.height - y), 1};
+
+                vkCmdCopyBufferToImage(recording.transferCommands, stagingRing.getBuffer(), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+                row += rows;
+            }
+        }
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        if (hasDedicatedTransferQueue()) {
+            //the layout change is part of the ownership transfer, release and acquire describe the same transition
+            barrier.srcQueueFamilyIndex = transferFamily;
+            barrier.dstQueueFamilyIndex = graphicsFamily;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            vkCmdPipelineBarrier(recording.transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(recording.graphicsCommands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        } else {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(recording.graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+    }
+}
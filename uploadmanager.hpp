@@ -0,0 +1,88 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <deque>
+
+#include "gpuallocator.hpp"
+#include "ktx2file.hpp"
+#include "stagingring.hpp"
+
+namespace testengine {
+
+    //Batches buffer and image uploads into one command buffer per submit instead of a blocking single time
+    //command buffer per copy. Copies run on a dedicated transfer queue family when the device has one; queue
+    //family ownership is then released on the transfer queue and acquired on the graphics queue, which also
+    //records the work transfer queues cannot do (waits of shader stages on the uploaded data).
+    //Staging data goes through one persistently mapped ring; uploads larger than the free part of the ring are
+    //split into chunks, submitting and waiting for older batches whenever the ring runs full.
+    //Each submitted batch signals a fence, its staging range and command buffers are recycled once it passed.
+    class UploadManager {
+        public:
+            UploadManager() = default;
+            UploadManager(const UploadManager&) = delete;
+            UploadManager& operator=(const UploadManager&) = delete;
+
+            static constexpr VkDeviceSize DEFAULT_STAGING_SIZE = 32ull * 1024 * 1024;
+
+            void init(VkDevice device, GpuAllocator* allocator, uint32_t graphicsFamily, VkQueue graphicsQueue,
+                      uint32_t transferFamily, VkQueue transferQueue, VkDeviceSize stagingSize = DEFAULT_STAGING_SIZE);
+            void destroy();
+
+            //data is copied into staging memory immediately, the caller may free it on return
+            //dstAccess/dstStage describe the first use of the buffer after the upload
+            void uploadBuffer(VkBuffer buffer, const void* data, VkDeviceSize size,
+                              VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+
+            //uploads the levels of a texture with precomputed mips from firstLevel on, block compressed formats included,
+            //with one barrier before and one after all copies; texture level firstLevel becomes level 0 of the image,
+            //which has to have exactly the remaining levels. Leaves the image in SHADER_READ_ONLY_OPTIMAL
+            void uploadImageLevels(VkImage image, const TextureData& texture, uint32_t firstLevel = 0);
+
+            //submits everything recorded since the last submit, returns the id of the batch (0 if nothing was recorded)
+            uint64_t submit();
+            //recycles finished batches, never blocks
+            void collect();
+            bool isComplete(uint64_t batchId);
+            void wait(uint64_t batchId);
+
+            bool hasDedicatedTransferQueue() const { return transferFamily != graphicsFamily; }
+
+        private:
+            //multiple of every texel size, bufferOffset of image copies has to be aligned to it
+            static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+            //smaller free ranges are not worth a copy command, older batches are waited for instead
+            static constexpr VkDeviceSize MIN_CHUNK_SIZE = 256 * 1024;
+
+            struct Batch {
+                uint64_t id = 0;
+                //the same command buffer when there is no dedicated transfer queue
+                VkCommandBuffer transferCommands = VK_NULL_HANDLE;
+                VkCommandBuffer graphicsCommands = VK_NULL_HANDLE;
+                VkSemaphore transferComplete = VK_NULL_HANDLE;
+                VkFence fence = VK_NULL_HANDLE;
+            };
+
+            VkDevice device = VK_NULL_HANDLE;
+
+            uint32_t graphicsFamily = 0;
+            uint32_t transferFamily = 0;
+            VkQueue graphicsQueue = VK_NULL_HANDLE;
+            VkQueue transferQueue = VK_NULL_HANDLE;
+            VkCommandPool graphicsPool = VK_NULL_HANDLE;
+            VkCommandPool transferPool = VK_NULL_HANDLE;
+
+            StagingRing stagingRing;
+
+            Batch recording;
+            bool isRecording = false;
+            std::deque<Batch> inFlight;
+            uint64_t nextBatchId = 1;
+            uint64_t completedBatchId = 0;
+
+            void beginBatch();
+            VkCommandBuffer allocateCommandBuffer(VkCommandPool pool);
+            VkDeviceSize reserveStaging(VkDeviceSize size, VkDeviceSize granularity, VkDeviceSize& offset);
+            void releaseBatch(Batch& batch);
+    };
+}
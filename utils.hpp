@@ -1,10 +1,21 @@
+#pragma once
 #include <fstream>
 #include <vector>
 #include <stdexcept>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <exception>
+#include <thread>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace utils {
 
-    std::vector<char> readFile(const std::string& filename) {
+    inline std::vector<char> readFile(const std::string& filename) {
         std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
         if (!file.is_open()){
@@ -20,4 +31,98 @@ namespace utils {
 
         return buffer;
     }
-}
\ No newline at end of file
+
+    //64-bit FNV-1a, pass the previous result as hash to continue hashing across several buffers
+    inline uint64_t fnv1a64(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    //runs function(0..count-1) on count threads, the calling thread takes index 0
+    //the first exception thrown by any task is rethrown after all threads joined
+    template<typename Function>
+    void parallelFor(uint32_t count, Function function) {
+        std::vector<std::exception_ptr> errors(count);
+        auto task = [&](uint32_t index) {
+            try {
+                function(index);
+            } catch (...) {
+                errors[index] = std::current_exception();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(count - 1);
+        for (uint32_t i = 1; i < count; i++) {
+            threads.emplace_back(task, i);
+        }
+        task(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        for (const auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    //read-only memory mapping of a whole file, unmapped on close() or destruction
+    class MappedFile {
+        public:
+            MappedFile() = default;
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            ~MappedFile() {
+                close();
+            }
+
+            bool open(const std::string& filename) {
+                close();
+
+                int fd = ::open(filename.c_str(), O_RDONLY);
+                if (fd < 0) {
+                    return false;
+                }
+
+                struct stat fileStat{};
+                if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+                    ::close(fd);
+                    return false;
+                }
+
+                void* mapping = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                ::close(fd);
+
+                if (mapping == MAP_FAILED) {
+                    return false;
+                }
+
+                mappedData = static_cast<const uint8_t*>(mapping);
+                mappedSize = static_cast<size_t>(fileStat.st_size);
+                return true;
+            }
+
+            void close() {
+                if (mappedData != nullptr) {
+                    munmap(const_cast<uint8_t*>(mappedData), mappedSize);
+                    mappedData = nullptr;
+                    mappedSize = 0;
+                }
+            }
+
+            bool isOpen() const { return mappedData != nullptr; }
+            const uint8_t* data() const { return mappedData; }
+            size_t size() const { return mappedSize; }
+
+        private:
+            const uint8_t* mappedData = nullptr;
+            size_t mappedSize = 0;
+    };
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+//every translation unit that sees Vertex has to agree on the glm configuration, otherwise its layout differs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+namespace testengine {
+
+    struct Vertex {
+        glm::vec3 pos;
+        glm::vec3 color;
+        glm::vec2 texCoord;
+
+        bool operator==(const Vertex& other) const {
+            return pos == other.pos && color == other.color && texCoord == other.texCoord;
+        }
+    };
+}
+
+namespace std {
+    //hashes the raw float bits with a multiplicative mix, the old XOR-shift combination of the glm
+    //hashes collided heavily for vertices that only differ in one component
+    template<> struct hash<testengine::Vertex> {
+        size_t operator()(testengine::Vertex const& vertex) const {
+            uint32_t bits[8];
+            memcpy(&bits[0], &vertex.pos, sizeof(float) * 3);
+            memcpy(&bits[3], &vertex.color, sizeof(float) * 3);
+            memcpy(&bits[6], &vertex.texCoord, sizeof(float) * 2);
+
+            uint64_t hash = 0x9E3779B97F4A7C15ULL;
+            for (uint32_t value : bits) {
+                //-0.0f compares equal to 0.0f, so it has to hash equal too
+                if (value == 0x80000000u) {
+                    value = 0;
+                }
+                hash = (hash ^ value) * 0xBF58476D1CE4E5B9ULL;
+                hash ^= hash >> 31;
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+}
@@ -0,0 +1,93 @@
+#include "vertexpacking.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace testengine {
+
+    VertexQuantization computeVertexQuantization(const Vertex* vertices, uint32_t vertexCount) {
+        VertexQuantization quantization{glm::vec4(0.0f), glm::vec4(0.0f)};
+        if (vertexCount == 0) {
+            return quantization;
+        }
+
+        glm::vec3 minimum = vertices[0].pos;
+        glm::vec3 maximum = vertices[0].pos;
+        for (uint32_t i = 1; i < vertexCount; i++) {
+            minimum = glm::min(minimum, vertices[i].pos);
+            maximum = glm::max(maximum, vertices[i].pos);
+        }
+
+        quantization.offset = glm::vec4(minimum, 0.0f);
+        quantization.scale = glm::vec4(maximum - minimum, 0.0f);
+        return quantization;
+    }
+
+    void packVertices(const Vertex* vertices, uint32_t vertexCount, const VertexQuantization& quantization, std::vector<PackedVertex>& packed) {
+        packed.resize(vertexCount);
+
+        //flat axes have a scale of 0 and quantize to 0
+        float inverseScale[3];
+        for (int axis = 0; axis < 3; axis++) {
+            inverseScale[axis] = quantization.scale[axis] > 0.0f ? 65535.0f / quantization.scale[axis] : 0.0f;
+        }
+
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            const Vertex& vertex = vertices[i];
+            PackedVertex& out = packed[i];
+
+            for (int axis = 0; axis < 3; axis++) {
+                float normalized = (vertex.pos[axis] - quantization.offset[axis]) * inverseScale[axis];
+                out.position[axis] = static_cast<uint16_t>(std::clamp(std::lround(normalized), 0L, 65535L));
+            }
+            out.position[3] = 0;
+            out.texCoord[0] = floatToHalf(vertex.texCoord.x);
+            out.texCoord[1] = floatToHalf(vertex.texCoord.y);
+        }
+    }
+
+    uint16_t floatToHalf(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+
+        uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+        uint32_t magnitude = bits & 0x7FFFFFFF;
+
+        //infinity and NaN, NaNs stay quiet NaNs
+        if (magnitude >= 0x7F800000) {
+            return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x0200 : 0);
+        }
+        //65520 and above round to infinity
+        if (magnitude >= 0x477FF000) {
+            return sign | 0x7C00;
+        }
+
+        //below the smallest normal half, 2^-14
+        if (magnitude < 0x38800000) {
+            //below half the smallest subnormal, 2^-25
+            if (magnitude < 0x33000000) {
+                return sign;
+            }
+            uint32_t exponent = magnitude >> 23;
+            uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+            uint32_t shift = 126 - exponent;
+
+            uint32_t half = mantissa >> shift;
+            uint32_t remainder = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if (remainder > halfway || (remainder == halfway && (half & 1))) {
+                half++;
+            }
+            return sign | static_cast<uint16_t>(half);
+        }
+
+        //rebias the exponent from 127 to 15 and drop 13 mantissa bits, a carry correctly bumps the exponent
+        uint32_t half = (magnitude - 0x38000000) >> 13;
+        uint32_t remainder = magnitude & 0x1FFF;
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+            half++;
+        }
+        return sign | static_cast<uint16_t>(half);
+    }
+}
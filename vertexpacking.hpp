@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "vertex.hpp"
+
+namespace testengine {
+
+    //12 byte vertex: positions as unorm16 relative to the mesh bounds (w unused), texture coordinates as
+    //half floats so tiled coordinates outside [0, 1] survive; the constant vertex color is not stored
+    struct PackedVertex {
+        uint16_t position[4];
+        uint16_t texCoord[2];
+    };
+
+    //position = offset + unorm * scale, laid out as the vertex shader's push constants
+    struct VertexQuantization {
+        glm::vec4 offset;
+        glm::vec4 scale;
+    };
+
+    VertexQuantization computeVertexQuantization(const Vertex* vertices, uint32_t vertexCount);
+    void packVertices(const Vertex* vertices, uint32_t vertexCount, const VertexQuantization& quantization, std::vector<PackedVertex>& packed);
+
+    //round to nearest even, overflows become infinity
+    uint16_t floatToHalf(float value);
+}